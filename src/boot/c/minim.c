@@ -15,6 +15,8 @@
 static int opt_load_library = 1;    // load bootstrap library
 static int interactive = 0;         // REPL
 static int quiet = 0;               // No header
+static int dump_ir = 0;             // Print compiler IR
+static int stats = 0;               // Print compiler statistics on exit
 
 static void unknown_flag_exn(const char *flag) {
     fprintf(stderr, "unknown flag: %s\n", flag);
@@ -37,6 +39,12 @@ static int handle_flags(int argc, char **argv) {
                 opt_load_library = 0;
             } else if (strcmp(argv[i], "--quiet") == 0) {
                 quiet = 1;
+            } else if (strcmp(argv[i], "--dump-ir") == 0) {
+                dump_ir = 1;
+            } else if (strcmp(argv[i], "--no-inline") == 0) {
+                jit_inline = 0;
+            } else if (strcmp(argv[i], "--stats") == 0) {
+                stats = 1;
             } else {
                 unknown_flag_exn(argv[i]);
             }
@@ -52,6 +60,10 @@ static int handle_flags(int argc, char **argv) {
     return i;
 }
 
+static void print_stats() {
+    jit_print_stats(stderr);
+}
+
 static void load_library() {
     char *old_cwd = get_current_dir();
     set_current_dir(BOOT_DIR);
@@ -70,6 +82,7 @@ int main(int argc, char **argv) {
 
     GC_init(((void*) &stack_top));
     minim_boot_init();
+    if (stats) atexit(print_stats);
 
     // load the prelude
     tc = current_tc();
@@ -78,6 +91,9 @@ int main(int argc, char **argv) {
     if (opt_load_library)
         load_library();
 
+    // only user code is dumped
+    jit_dump_ir = dump_ir;
+
     for (i = argc - 1; i >= argi; --i)
         tc_command_line(tc) = Mcons(Mstring(argv[i]), tc_command_line(tc));
 
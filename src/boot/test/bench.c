@@ -0,0 +1,137 @@
+/*
+    Benchmark of the compiler and runtime.
+
+    Loads the bootstrap library, then times compiling every
+    top-level form of the library again (without evaluating it)
+    and running a few microbenchmarks.
+*/
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <time.h>
+
+#include "../build/config.h"
+#include "../boot.h"
+
+#define ITERATIONS      5
+#define APPLY_CALLS     "1000000"
+
+static double now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static mobj read_forms(const char *fname) {
+    mobj forms, expr;
+    FILE *f;
+
+    f = fopen(fname, "r");
+    if (f == NULL) {
+        fprintf(stderr, "could not open %s\n", fname);
+        exit(1);
+    }
+
+    forms = minim_null;
+    while ((expr = read_object(f)) != NULL) {
+        check_expr(expr);
+        forms = Mcons(expr, forms);
+    }
+
+    fclose(f);
+    return list_reverse(forms);
+}
+
+static mobj read_string(const char *s) {
+    mobj expr;
+    FILE *f;
+
+    f = tmpfile();
+    fputs(s, f);
+    rewind(f);
+    expr = read_object(f);
+    fclose(f);
+    return expr;
+}
+
+// Times evaluating `(f <args> ...)` `APPLY_CALLS` times in a loop.
+static void bench_loop(mobj tc, const char *name, const char *call) {
+    char buffer[512];
+    mobj expr;
+    double start, best;
+
+    snprintf(
+        buffer, sizeof(buffer),
+        "(letrec-values ([(loop) (lambda (n) "
+        "  (if ($fx2= n 0) 0 (begin %s (loop ($fx2- n 1)))))]) "
+        "  (loop " APPLY_CALLS "))",
+        call
+    );
+
+    expr = read_string(buffer);
+    best = 0.0;
+    for (size_t i = 0; i < ITERATIONS; ++i) {
+        double elapsed;
+
+        start = now_ms();
+        tc_env(tc) = NULL;
+        eval_expr(tc, expr);
+        elapsed = now_ms() - start;
+        if (i == 0 || elapsed < best)
+            best = elapsed;
+    }
+
+    printf("%-22s %8.2f (best)\n", name, best);
+}
+
+int main() {
+    volatile int stack_top;
+    mobj tc, forms;
+    double start, load, best, total;
+    size_t n;
+
+    GC_init(((void*) &stack_top));
+    minim_boot_init();
+
+    // load the prelude and library
+    start = now_ms();
+    tc = current_tc();
+    load_prelude(tc);
+    set_current_dir(BOOT_DIR);
+    load_file(tc, "boot.min");
+    load = now_ms() - start;
+
+    // compile the library again
+    forms = read_forms("boot.min");
+    n = list_length(forms);
+    best = total = 0.0;
+    for (size_t i = 0; i < ITERATIONS; ++i) {
+        double elapsed;
+
+        start = now_ms();
+        for (mobj it = forms; !minim_nullp(it); it = minim_cdr(it))
+            compile_expr(minim_car(it));
+        elapsed = now_ms() - start;
+
+        total += elapsed;
+        if (i == 0 || elapsed < best)
+            best = elapsed;
+    }
+
+    printf("load library (ms)      %8.2f\n", load);
+    printf("compile %zu forms (ms)  %8.2f (best), %8.2f (mean)\n", n, best, total / ITERATIONS);
+
+    // spreading arguments with `apply`
+    printf("%s calls (ms)\n", APPLY_CALLS);
+    bench_loop(tc, "  apply, 1 arg", "(apply car '((1 . 2)))");
+    bench_loop(tc, "  apply, 3 args", "(apply (lambda (a b c) a) '(1 2 3))");
+    bench_loop(tc, "  apply, 1+3 args", "(apply (lambda (a b c d) a) 0 '(1 2 3))");
+    bench_loop(tc, "  apply, 10 args", "(apply (lambda (a b c d e f g h i j) a) '(1 2 3 4 5 6 7 8 9 10))");
+
+    // building rest arguments
+    bench_loop(tc, "  rest, 2 args", "(list 1 2)");
+    bench_loop(tc, "  rest, 8 args", "(list 1 2 3 4 5 6 7 8)");
+
+    GC_finalize();
+    return 0;
+}
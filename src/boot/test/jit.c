@@ -180,6 +180,17 @@ int test_rest() {
     check_equal("((lambda (x y . zs) (cons zs (cons y x))) 1 2 3)", "((3) 2 . 1)");
     check_equal("((lambda (x y . zs) (cons zs (cons y x))) 1 2 3 4)", "((3 4) 2 . 1)");
 
+    check_equal("((lambda (x . ys) x) 1 2 3)", "1");
+    check_equal("((lambda xs ($cdr ($cdr xs))) 1 2 3)", "(3)");
+
+    // rest lists longer than a single chunk
+    check_equal(
+        "(letrec-values ([(iota) (lambda (n acc) (if ($fx2= n 0) acc (iota ($fx2- n 1) (cons n acc))))])"
+        "  (let-values ([(xs) (iota 150 '())])"
+        "    ($equal? (apply (lambda ys ys) xs) xs)))",
+        "#t"
+    );
+
     return passed;
 }
 
@@ -226,6 +237,9 @@ int test_apply() {
     check_equal("(apply (lambda xs xs) 1 2 '(3))", "(1 2 3)");
     check_equal("(apply (lambda xs xs) 1 2 '(3 4))", "(1 2 3 4)");
 
+    check_equal("(apply (lambda xs xs) '(1 2 3 4 5 6))", "(1 2 3 4 5 6)");
+    check_equal("(apply (lambda xs xs) 1 2 '(3 4 5 6))", "(1 2 3 4 5 6)");
+
     check_equal("(apply apply (cons cons '((1 2))))", "(1 . 2)");
 
     return passed;
@@ -282,6 +296,238 @@ int test_call_with_values() {
     check_equal("(call-with-values (lambda () 1) (lambda (x) (begin 2 x)))", "1");
     check_equal("(cons 1 (call-with-values (lambda () 2) (lambda (x) x)))", "(1 . 2)");
 
+    check_equal("(call-with-values (lambda () (values 1 2 3 4 5 6 7 8 9 10 11 12)) (lambda xs xs))", "(1 2 3 4 5 6 7 8 9 10 11 12)");
+    check_equal("(call-with-values (lambda () (values 1 2 3)) (lambda xs xs))", "(1 2 3)");
+
+    return passed;
+}
+
+int test_setb() {
+    passed = 1;
+
+    check_equal("((lambda (x) (set! x 2) x) 1)", "2");
+    check_equal("((lambda (x) (let-values ([(f) (lambda () x)]) (set! x 2) (f))) 1)", "2");
+    check_equal("((lambda (x) (let-values ([(f) (lambda () (set! x 2))]) (f) x)) 1)", "2");
+    check_equal("((lambda (x) (let-values ([(f) (lambda () x)]) (f))) 1)", "1");
+    check_equal("((lambda (x . ys) (set! ys x) ys) 1 2)", "1");
+    check_equal("(let-values ([(x y) (values 1 2)]) (set! y x) (cons x y))", "(1 . 1)");
+    check_equal("(let-values ([(x) 1]) ((lambda (x) (set! x 2) x) 3))", "2");
+    check_equal("(let-values ([(x) 1]) ((lambda (x) (set! x 2)) 3) x)", "1");
+    check_equal(
+        "(letrec-values ([(even?) (lambda (n) (if (null? n) #t (odd? ($cdr n))))]"
+                        "[(odd?) (lambda (n) (if (null? n) #f (even? ($cdr n))))])"
+           "(even? '(1 2 3 4)))",
+        "#t"
+    );
+
+    return passed;
+}
+
+int test_stack_locals() {
+    passed = 1;
+
+    check_equal("((lambda (x y) (cons (cons x y) (cons y x))) 1 2)", "((1 . 2) 2 . 1)");
+    check_equal("((lambda (x) (let-values ([(y) (cons x x)]) (cons y x))) 1)", "((1 . 1) . 1)");
+    check_equal("((lambda (x . ys) (cons ys x)) 1 2 3)", "((2 3) . 1)");
+    check_equal("(let-values ([(x y) (values 1 2)] [(z) 3]) (cons x (cons y z)))", "(1 2 . 3)");
+    check_equal("((lambda (x) (let-values ([(y z) (values x 2)]) ((lambda () (cons y z))))) 1)", "(1 . 2)");
+    check_equal("((lambda (x y) (let-values ([(f) (lambda () y)]) (cons x (f)))) 1 2)", "(1 . 2)");
+    check_equal(
+        "(letrec-values ([(len) (lambda (n) (if (null? n) 0 ($fx2+ 1 (len ($cdr n)))))])"
+           "(len '(1 2 3 4)))",
+        "4"
+    );
+
+    return passed;
+}
+
+int test_inline_prims() {
+    size_t misses;
+
+    passed = 1;
+
+    check_equal("($fx2+ ($car '(1 2)) ($fx2- 5 3))", "3");
+    check_equal("((lambda (x) (if ($fx2< x 2) (cons x '()) (pair? x))) 1)", "(1)");
+    check_equal("((lambda (v) (cons ($vector-ref v 1) (null? v))) #(1 2 3))", "(2 . #f)");
+    check_equal("(cons (pair? '(1)) (pair? 'a))", "(#t . #f)");
+    check_equal("((lambda (cons) (cons 1 2)) (lambda (x y) y))", "2");
+    check_equal(
+        "(let-values ([(cons) cons])"
+          "(set! cons (lambda (x y) x))"
+          "((lambda () (cons 1 ($fx2+ 1 (cons 2 3))))))",
+        "1"
+    );
+
+    // the argument is evaluated once
+    check_equal("(let-values ([(n) 0]) (pair? (begin (set! n ($fx2+ n 1)) n)) n)", "1");
+
+    // the primitive is applied directly unless the operator is redefined
+    misses = prim_guard_misses;
+    check_equal("(cons (pair? '(1)) (not ($car '(#f))))", "(#t . #t)");
+    if (prim_guard_misses != misses) {
+        log_failed_case("guard misses", "0", "> 0");
+        passed = 0;
+    }
+
+    check_equal("(define-values (saved-not) not)", "#<void>");
+    check_equal("(define-values (negate) (lambda (x) (not x)))", "#<void>");
+    check_equal("(define-values (not) (lambda (x) 'redefined))", "#<void>");
+    check_equal("(negate #f)", "redefined");
+    check_equal("(define-values (not) saved-not)", "#<void>");
+    check_equal("(negate #f)", "#t");
+    if (prim_guard_misses != misses + 1) {
+        log_failed_case("guard misses", "1", "other");
+        passed = 0;
+    }
+
+    // the operator is evaluated after the arguments
+    check_equal("(not (begin (set! not (lambda (x) 'late)) #f))", "late");
+    check_equal("(define-values (not) saved-not)", "#<void>");
+    check_equal("(not #f)", "#t");
+
+    return passed;
+}
+
+int test_self_calls() {
+    passed = 1;
+
+    check_equal(
+        "(letrec-values ([(loop) (lambda (i acc) (if ($fx2= i 0) acc (loop ($fx2- i 1) (cons i acc))))])"
+          "(loop 3 '()))",
+        "(1 2 3)"
+    );
+    check_equal(
+        "(letrec-values ([(f) (case-lambda [(l) (f l 0)] [(l a) (if (null? l) a (f ($cdr l) ($fx2+ a 1)))])])"
+          "(f '(1 2 3)))",
+        "3"
+    );
+    check_equal(
+        "(letrec-values ([(f) (lambda (n . r) (if ($fx2= n 0) r (f ($fx2- n 1) n)))]) (f 2))",
+        "(1)"
+    );
+    check_equal(
+        "(letrec-values ([(f) (lambda (n) (if ($fx2= n 0) 0 ($fx2+ 1 (f ($fx2- n 1)))))]) (f 5))",
+        "5"
+    );
+    check_equal(
+        "(letrec-values ([(f) (lambda (n) (if ($fx2= n 0) 'done ((lambda (f) (f n)) (lambda (x) x))))]) (f 1))",
+        "1"
+    );
+    check_equal(
+        "(letrec-values ([(f) (lambda (n) (if ($fx2= n 0) 'done (f ($fx2- n 1))))])"
+          "(let-values ([(g) f]) (set! f (lambda (n) 'other)) (g 2)))",
+        "other"
+    );
+
+    return passed;
+}
+
+int test_loops() {
+    passed = 1;
+
+    check_equal(
+        "(letrec-values ([(loop) (lambda (n a b) (if ($fx2= n 0) (cons a b) (loop ($fx2- n 1) b a)))])"
+          "(loop 3 1 2))",
+        "(2 . 1)"
+    );
+    check_equal(
+        "(let-values ([(i) 3])"
+          "(letrec-values ([(loop) (lambda (i acc) (if ($fx2= i 0) acc (loop ($fx2- i 1) (cons i acc))))])"
+            "(loop i '())))",
+        "(1 2 3)"
+    );
+    check_equal(
+        "(cons 'a (letrec-values ([(loop) (lambda (i acc) (if ($fx2= i 0) acc (loop ($fx2- i 1) (cons i acc))))])"
+          "(loop 3 '())))",
+        "(a 1 2 3)"
+    );
+    check_equal(
+        "(letrec-values ([(loop) (lambda (i fs) (if ($fx2= i 0) fs (loop ($fx2- i 1) (cons (lambda () i) fs))))])"
+          "(let-values ([(fs) (loop 2 '())]) (cons (($car fs)) (($car ($cdr fs))))))",
+        "(1 . 2)"
+    );
+    check_equal(
+        "(letrec-values ([(loop) (lambda (i fs)"
+            "(if ($fx2= i 0) fs (let-values ([(j) i]) (set! i ($fx2+ j 10)) (loop ($fx2- j 1) (cons (lambda () i) fs)))))])"
+          "(let-values ([(fs) (loop 2 '())]) (cons (($car fs)) (($car ($cdr fs))))))",
+        "(11 . 12)"
+    );
+    check_equal(
+        "(letrec-values ([(outer) (lambda (i acc)"
+            "(if ($fx2= i 0) acc"
+              "(letrec-values ([(inner) (lambda (j acc)"
+                  "(if ($fx2= j 0) (outer ($fx2- i 1) acc) (inner ($fx2- j 1) (cons (cons i j) acc))))])"
+                "(inner 2 acc))))])"
+          "(outer 2 '()))",
+        "((1 . 1) (1 . 2) (2 . 1) (2 . 2))"
+    );
+    check_equal(
+        "(letrec-values ([(loop) (lambda (n) (if ($fx2= n 0) loop (loop ($fx2- n 1))))]) (procedure? (loop 2)))",
+        "#t"
+    );
+
+    return passed;
+}
+
+int test_simplify() {
+    passed = 1;
+
+    check_equal("(if '#f 1 ($fx2+ 2 3))", "5");
+    check_equal("(let-values ([(x) 1] [(y) 2]) (begin x 'a ($fx2- y x)))", "1");
+    check_equal("(let-values ([(x) 1]) (let-values ([(x) 2] [(y) x]) y))", "1");
+    check_equal("(let-values ([(x) 1]) (set! x 2) x)", "2");
+    check_equal("(let-values ([($fx2+) cons]) ($fx2+ 1 2))", "(1 . 2)");
+    check_equal("(define-values (overflow-if) (lambda (b) (if b ($fx2+ 4611686018427387903 1) 0)))", "#<void>");
+    check_equal("(overflow-if #f)", "0");
+
+    // folded primitives are not folded once redefined
+    check_equal("(define-values (saved-fx2*) $fx2*)", "#<void>");
+    check_equal("(define-values ($fx2*) (lambda (x y) 'redefined))", "#<void>");
+    check_equal("($fx2* 2 3)", "redefined");
+    check_equal("(define-values (fold-mul) (lambda () ($fx2* 2 3)))", "#<void>");
+    check_equal("(fold-mul)", "redefined");
+    check_equal("(define-values ($fx2*) saved-fx2*)", "#<void>");
+    check_equal("($fx2* 2 3)", "6");
+    check_equal("(let-values ([(f) (lambda (x) (cons x x))] [(y) 3]) (f (f y)))", "((3 . 3) 3 . 3)");
+    check_equal("(let-values ([(y) 1]) (let-values ([(f) (lambda () y)]) (let-values ([(y) 2]) (f))))", "1");
+
+    return passed;
+}
+
+int test_inline_procs() {
+    size_t count;
+
+    passed = 1;
+
+    check_equal("(define-values (sq) (lambda (x) ($fx2* x x)))", "#<void>");
+    check_equal("(sq 3)", "9");
+    check_equal("(define-values (sq2) (lambda (x) (sq (sq x))))", "#<void>");
+    check_equal("(sq2 2)", "16");
+    check_equal("(define-values (sq) (lambda (x) (cons x x)))", "#<void>");
+    check_equal("(sq2 2)", "((2 . 2) 2 . 2)");
+
+    // assigned variables of the inlined body are not propagated
+    check_equal("(define-values (bump) (lambda (x) (set! x ($fx2+ x 1)) x))", "#<void>");
+    check_equal("(bump 5)", "6");
+    check_equal(
+        "(define-values (make-counter)"
+          "(lambda () (let-values ([(n) 0]) (lambda () (set! n ($fx2+ n 1)) n))))",
+        "#<void>"
+    );
+    check_equal(
+        "(let-values ([(c) (make-counter)]) (let-values ([(a) (c)] [(b) (c)]) (cons a (cons b (c)))))",
+        "(1 2 . 3)"
+    );
+
+    // redefining a procedure forgets the old one
+    count = minim_hashtable_count(inline_procs);
+    for (int i = 0; i < 10; i++)
+        check_equal("(define-values (redefined) (lambda (x) (cons x x)))", "#<void>");
+    if (minim_hashtable_count(inline_procs) != count + 1) {
+        log_failed_case("inlinable procedures", "one more", "other");
+        passed = 0;
+    }
+
     return passed;
 }
 
@@ -303,6 +549,13 @@ int main(int argc, char **argv) {
     log_test("apply", test_apply);
     log_test("let-values", test_let_values);
     log_test("call-with-values", test_call_with_values);
+    log_test("set!", test_setb);
+    log_test("stack locals", test_stack_locals);
+    log_test("inline prims", test_inline_prims);
+    log_test("self calls", test_self_calls);
+    log_test("loops", test_loops);
+    log_test("simplify", test_simplify);
+    log_test("inline procs", test_inline_procs);
 
     GC_finalize();
     return return_code;
@@ -5,6 +5,11 @@
     Tests for the primitive library
 */
 
+#define _POSIX_C_SOURCE 200809L
+
+#include <sys/wait.h>
+#include <unistd.h>
+
 #include "../boot.h"
 
 int return_code, passed;
@@ -96,6 +101,37 @@ void check_equal(const char *input, const char *expect) {
     fclose(istream);
 }
 
+// evaluates `input` in a child process, expecting an error
+void check_error(const char *input) {
+    FILE *istream;
+    mobj tc;
+    pid_t pid;
+    int status;
+
+    fflush(stdout);
+    pid = fork();
+    if (pid == 0) {
+        freopen("/dev/null", "w", stderr);
+        istream = tmpfile();
+        tc = current_tc();
+        load(istream, input);
+        tc_tenv(tc) = make_base_env();
+        tc_env(tc) = NULL;
+        eval_expr(tc, read_object(istream));
+        exit(0);
+    }
+
+    // a crash is not an error raised by the runtime
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status)) {
+        log_failed_case(input, "error", "crash");
+        passed = 0;
+    } else if (WEXITSTATUS(status) == 0) {
+        log_failed_case(input, "error", "no error");
+        passed = 0;
+    }
+}
+
 #define log_test(name, t) {             \
     if (t() == 1) {                     \
         printf("[ \033[32mPASS\033[0m ] %s\n", name);  \
@@ -149,6 +185,8 @@ int test_eq() {
 
     check_true ("(eq? 1 1)");
     check_false("(eq? 1 2)");
+    check_true ("(eq? -1 -1)");
+    check_true ("(eq? (+ 1000000 1) 1000001)");
 
     check_true ("(eq? #\\a #\\a)");
     check_false("(eq? #\\a #\\b)");
@@ -351,6 +389,7 @@ int test_vector() {
     check_equal("(vector)", "#()");
     check_equal("(vector 1)", "#(1)");
     check_equal("(vector 1 2 3)", "#(1 2 3)");
+    check_equal("(vector 1 2 3 4 5 6 7 8)", "#(1 2 3 4 5 6 7 8)");
 
     check_equal("(vector-length #())", "0");
     check_equal("(vector-length #(1))", "1");
@@ -378,6 +417,10 @@ int test_integer() {
     check_equal("(+ 1)", "1");
     check_equal("(+ 1 2)", "3");
     check_equal("(+ 1 2 3)", "6");
+    check_equal("(+ 1 2 3 4 5 6 7 8)", "36");
+    check_equal("(apply + '(1 2 3))", "6");
+    check_error("(+ 1 'a)");
+    check_error("(+ 1 2 \"3\")");
     check_equal("(add1 1)", "2");
 
     check_equal("(- 1)", "-1");
@@ -390,9 +433,30 @@ int test_integer() {
     check_equal("(* 1 2)", "2");
     check_equal("(* 1 2 3)", "6");
 
+    check_equal("4611686018427387903", "4611686018427387903");
+    check_equal("-4611686018427387904", "-4611686018427387904");
+    check_equal("#x-4000000000000000", "-4611686018427387904");
+    check_equal("(* -2147483648 2147483648)", "-4611686018427387904");
+    check_error("4611686018427387904");
+    check_error("-4611686018427387905");
+    check_error("#x4000000000000000");
+    check_error("(+ 4611686018427387903 1)");
+    check_error("(- -4611686018427387904 1)");
+    check_error("(- -4611686018427387904)");
+    check_error("(* 4611686018427387903 2)");
+    check_error("(* 2147483648 2147483648)");
+
     check_equal("(/ 1 1)", "1");
     check_equal("(/ 6 3)", "2");
     check_equal("(/ 7 3)", "2");
+    check_equal("(/ 2)", "0");
+    check_equal("(/ 100 5 2)", "10");
+    check_equal("(- 10 1 2 3)", "4");
+    check_equal("(* 1 2 3 4 5 6 7)", "5040");
+    check_error("(/ 1 0)");
+    check_error("(/ 1 2 0)");
+    check_error("(- 1 'a)");
+    check_error("(* 'a 1)");
 
     check_equal("(remainder 3 2)",    "1");
     check_equal("(remainder -3 2)",  "-1");
@@ -423,6 +487,15 @@ int test_integer() {
     check_false("(< 1 1)");
     check_true ("(< 0 1)");
 
+    check_true ("(= 1)");
+    check_true ("(= 1 1 1)");
+    check_false("(= 1 1 2)");
+    check_true ("(< 1 2 3 4)");
+    check_false("(< 1 3 2 4)");
+    check_true ("(>= 3 3 2 1)");
+    check_error("(< 1 'a)");
+    check_error("(< 2 1 'a)");
+
     return passed;
 }
 
@@ -456,6 +529,9 @@ int test_string() {
     check_equal("(string-append \"foo\")", "\"foo\"");
     check_equal("(string-append \"foo\" \"bar\")", "\"foobar\"");
     check_equal("(string-append \"foo\" \"bar\" \"baz\")", "\"foobarbaz\"");
+    check_equal("(string-append \"a\" \"b\" \"\" \"c\" \"d\" \"e\" \"f\" \"g\")", "\"abcdefg\"");
+    check_error("(string-append 'a)");
+    check_error("(string-append \"a\" \"b\" 1)");
 
     check_equal("(format \"abc\")", "\"abc\"");
     check_equal("(format \"~a\" 1)", "\"1\"");
@@ -567,6 +643,7 @@ int test_let() {
     check_equal("(letrec-values ([(x) 1] [(y) 2]) (list x y))", "(1 2)");
     check_equal("(letrec-values ([() (values)] [(x) 1] [(y z) (values 2 3)]) (list x y z))", "(1 2 3)");
     check_equal("(letrec-values ([(f g) (values (lambda () (g 1)) (lambda (x) 1))]) (f))", "1");
+    check_equal("(letrec-values ([(f) (lambda (n) (if (= n 0) 0 (+ 1 (f (- n 1)))))]) (f 10000))", "10000");
 
     check_equal("(let-values () 1)", "1");
     check_equal("(let-values ([() (values)]) 1)", "1");
@@ -917,6 +994,24 @@ int test_port() {
     return passed;
 }
 
+int test_eval() {
+    passed = 1;
+
+    check_equal("(eval '(car '(1 2)))", "1");
+    check_equal("(eval '(car '(1 2)) (make-base-environment))", "1");
+    check_equal("(begin "
+                  "(define-values (x) 1) "
+                  "(eval '(define-values (x) 2) (make-base-environment)) "
+                  "x)",
+                "1");
+    check_equal("(let-values ([(e) (make-base-environment)]) "
+                  "(eval '(define-values (x) 3) e) "
+                  "(eval '(begin (set! x ($fx2+ x 1)) x) e))",
+                "4");
+
+    return passed;
+}
+
 void run_tests() {
     log_test("syntax", test_syntax);
     log_test("if", test_if);
@@ -939,6 +1034,7 @@ void run_tests() {
     log_test("port", test_port);
 
     log_test("apply", test_apply);
+    log_test("eval", test_eval);
 }
 
 int main(int argc, char **argv) {
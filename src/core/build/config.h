@@ -0,0 +1,2 @@
+#define MINIM_X86_64 1
+#define PRELUDE_PATH "/root/repo/src/core/s/prelude.min"
@@ -5,8 +5,8 @@
 #include "../minim.h"
 
 mobj Mbox(mobj x) {
-    mobj o = GC_alloc(minim_box_size);
-    minim_type(o) = MINIM_OBJ_BOX;
+    mobj o = GC_alloc_tagged(minim_box_size);
+    minim_heap_type(o) = MINIM_OBJ_BOX;
     minim_unbox(o) = x;
     return o;
 }
@@ -33,5 +33,6 @@ mobj unbox_proc(mobj x) {
 mobj box_set_proc(mobj x, mobj v) {
     // (-> box any void)
     minim_unbox(x) = v;
+    minim_write_barrier(x, v);
     return minim_void;
 }
@@ -4,13 +4,6 @@
 
 #include "../minim.h"
 
-mobj Mchar(mchar c) {
-    mobj o = GC_alloc_atomic(sizeof(minim_char_size));
-    minim_type(o) = MINIM_OBJ_CHAR;
-    minim_char(o) = c;
-    return o;
-}
-
 //
 //  Primitives
 //
@@ -19,8 +19,8 @@ mobj Mtop_env(size_t size_hint) {
     alloc_ptr = start_size_ptr;
     for (; *alloc_ptr < 4 * size_hint; ++alloc_ptr);
     
-    env = GC_alloc(minim_top_env_size);
-    minim_type(env) = MINIM_OBJ_TOPENV;
+    env = GC_alloc_tagged(minim_top_env_size);
+    minim_heap_type(env) = MINIM_OBJ_TOPENV;
     minim_top_env_alloc_ptr(env) = alloc_ptr;
     minim_top_env_buckets(env) = Mvector(minim_top_env_alloc(env), minim_null);
     minim_top_env_count(env) = 0;
@@ -58,8 +58,8 @@ mobj top_env_copy(mobj env, int mutablep) {
     }
 
     // create the environment object
-    env2 = GC_alloc(minim_top_env_size);
-    minim_type(env2) = MINIM_OBJ_TOPENV;
+    env2 = GC_alloc_tagged(minim_top_env_size);
+    minim_heap_type(env2) = MINIM_OBJ_TOPENV;
     minim_top_env_alloc_ptr(env2) = minim_top_env_alloc_ptr(env);
     minim_top_env_buckets(env2) = nb;
     minim_top_env_count(env2) = minim_top_env_count(env);
@@ -69,30 +69,31 @@ mobj top_env_copy(mobj env, int mutablep) {
 // The binding, if any, for each symbol in syms is copied into
 // a new environment.
 mobj top_env_copy2(mobj env, mobj syms, int mutablep) {
-    mobj env2, b, cell;
+    mobj env2, nb, b, cell;
     size_t *alloc_ptr, i, max_size;
 
     max_size = list_length(syms);
     alloc_ptr = start_size_ptr;
     for (; *alloc_ptr < 4 * max_size; ++alloc_ptr);
 
-    env2 = GC_alloc(minim_top_env_size);
-    minim_type(env2) = MINIM_OBJ_TOPENV;
+    env2 = GC_alloc_tagged(minim_top_env_size);
+    nb = Mvector(*alloc_ptr, minim_null);
+    minim_heap_type(env2) = MINIM_OBJ_TOPENV;
     minim_top_env_alloc_ptr(env2) = alloc_ptr;
-    minim_top_env_buckets(env2) = Mvector(minim_top_env_alloc(env2), minim_null);
+    minim_top_env_buckets(env2) = nb;
     minim_top_env_count(env2) = 0;
 
     for (; !minim_nullp(syms); syms = minim_cdr(syms)) {
         cell = top_env_find(env, minim_car(syms));
         if (!minim_falsep(cell)) {
             i = minim_fixnum(minim_cadr(cell)) % minim_top_env_alloc(env2);
-            b = minim_top_env_bucket(env2, i);
+            b = minim_vector_ref(nb, i);
             cell = Mcons(
                 Mcons(minim_caar(cell), minim_cdar(cell)),
                 Mcons(minim_cadr(cell), mutablep ? minim_true : minim_false)
             );
 
-            minim_top_env_bucket(env2, i) = Mcons(cell, b);
+            minim_vector_ref(nb, i) = Mcons(cell, b);
             minim_top_env_count(env2) += 1;
         }
     }    
@@ -120,6 +121,7 @@ static void top_env_resize(mobj env) {
 
     minim_top_env_alloc_ptr(env) = alloc_ptr;
     minim_top_env_buckets(env) = nb;
+    minim_write_barrier(env, nb);
 }
 
 mobj top_env_insert(mobj env, mobj k, mobj v) {
@@ -134,7 +136,9 @@ mobj top_env_insert(mobj env, mobj k, mobj v) {
 
     b = minim_top_env_bucket(env, i);
     cell = Mcons(Mcons(k, v), Mcons(Mfixnum(h), minim_true));
-    minim_top_env_bucket(env, i) = Mcons(cell, b);
+    b = Mcons(cell, b);
+    minim_top_env_bucket(env, i) = b;
+    minim_write_barrier(minim_top_env_buckets(env), b);
     minim_top_env_count(env) += 1;
     return cell;
 }
@@ -175,7 +179,7 @@ static mobj top_env_symbols(mobj env) {
 
 mobj Menv(size_t size) {
     mobj env = GC_alloc(minim_env_size(size));
-    minim_type(env) = MINIM_OBJ_ENV;
+    minim_heap_type(env) = MINIM_OBJ_ENV;
     return env;
 }
 
@@ -247,6 +251,7 @@ mobj environment_variable_set(mobj env, mobj k, mobj v) {
     } else {
         // TODO: error if cell is immutable
         minim_cdar(cell) = v;
+        minim_write_barrier(minim_car(cell), v);
     }
 
     return minim_void;
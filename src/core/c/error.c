@@ -2,11 +2,21 @@
 
 #include "../minim.h"
 
-NORETURN static void do_error2(const char *name, const char *msg, mobj args) {
+// the runtime is executing only if an entry frame has
+// been pushed on the stack (see `eval_istream`)
+static int runtime_activep(mobj tc) {
+    return tc_sfp(tc) != tc_stack_base(tc) || !minim_nullp(tc_stack_link(tc));
+}
+
+// The C error handler is called with the kind of error, `#f` for
+// a generic error or `argument` for a bad argument, and then `who`,
+// `msg`, and `args` as for `error` (see `minim_argument_error`).
+NORETURN static void do_error2(mobj kind, const char *name, const char *msg, mobj args) {
     mobj tc = current_tc();
-    if (minim_nullp(tc_ccont(tc)) || minim_falsep(tc_c_error_handler(tc))) {
+    if (!runtime_activep(tc) || minim_falsep(tc_c_error_handler(tc))) {
         // exception cannot be handled by runtime
-        if (name) fprintf(stderr, "Error in %s: %s", name, msg);
+        if (!minim_falsep(kind)) fprintf(stderr, "Error in %s: expected %s", name, msg);
+        else if (name) fprintf(stderr, "Error in %s: %s", name, msg);
         else fprintf(stderr, "Error: %s", msg);
         for (; !minim_nullp(args); args = minim_cdr(args)) {
             fputs("\n ", stderr);
@@ -18,12 +28,13 @@ NORETURN static void do_error2(const char *name, const char *msg, mobj args) {
     }
     
     // call back into the Scheme runtime
-    reserve_stack(tc, 3);
-    tc_ac(tc) = 3;
+    reserve_stack(tc, 4);
+    tc_ac(tc) = 4;
     tc_cp(tc) = tc_c_error_handler(tc);
-    set_arg(tc, 0, (name ? Mstring(name) : minim_false));
-    set_arg(tc, 1, Mstring(msg));
-    set_arg(tc, 2, args);
+    set_arg(tc, 0, kind);
+    set_arg(tc, 1, (name ? Mstring(name) : minim_false));
+    set_arg(tc, 2, Mstring(msg));
+    set_arg(tc, 3, args);
     
     longjmp(*tc_reentry(tc), 1);
 }
@@ -33,19 +44,24 @@ NORETURN static void do_error2(const char *name, const char *msg, mobj args) {
 //
 
 void minim_error(const char *name, const char *msg) {
-    do_error2(name, msg, minim_null);
+    do_error2(minim_false, name, msg, minim_null);
 }
 
 void minim_error1(const char *name, const char *msg, mobj x) {
-    do_error2(name, msg, Mlist1(x));
+    do_error2(minim_false, name, msg, Mlist1(x));
 }
 
 void minim_error2(const char *name, const char *msg, mobj x, mobj y) {
-    do_error2(name, msg, Mlist2(x, y));
+    do_error2(minim_false, name, msg, Mlist2(x, y));
 }
 
 void minim_error3(const char *name, const char *msg, mobj x, mobj y, mobj z) {
-    do_error2(name, msg, Mlist3(x, y, z));
+    do_error2(minim_false, name, msg, Mlist3(x, y, z));
+}
+
+// reported by the runtime through `raise-argument-error`
+void minim_argument_error(const char *name, const char *expect, mobj x) {
+    do_error2(intern("argument"), name, expect, Mlist1(x));
 }
 
 //
@@ -8,6 +8,7 @@
     if (minim_closurep(o)) { \
         if (minim_falsep(minim_closure_name(o))) { \
             minim_closure_name(o) = name; \
+            minim_write_barrier(o, name); \
         } \
     } \
 }
@@ -69,15 +70,20 @@ void result_arity_exn(const char *name, short expected, short actual) {
 //  Evaluation
 //
 
-#define stack_frame_size(th, addt)  ((1 + tc_ac(th) + (addt)) * ptr_size)
+#define stack_frame_size(th, addt)  ((frame_header_size + tc_ac(th) + (addt)) * ptr_size)
 #define stack_cushion               (8 * ptr_size)
+#define apply_fast_args             3
+#define rest_chunk_size             64      // pairs (a small GC object)
 
 static int stack_overflowp(mobj tc, size_t size) {
     return (uintptr_t) ptr_add(tc_sfp(tc), size) >= (uintptr_t) tc_esp(tc);
 }
 
+// Moves the current frame to a new stack segment. Since the frame
+// header would no longer be adjacent to the caller's frame, its
+// return point is saved in the record of the previous segment.
 static void grow_stack(mobj tc, size_t size) {
-    mobj srecord;
+    mobj srecord, *fp;
     void *stack;
     size_t req, actual;
 
@@ -86,7 +92,21 @@ static void grow_stack(mobj tc, size_t size) {
     actual = (req > stack_size) ? req : stack_size;
 
     // allocate stack record for previous segment
-    srecord = Mcached_stack(tc_stack_base(tc), tc_stack_link(tc), tc_stack_size(tc), tc_ccont(tc));
+    // (if the frame is the only one in its segment, the segment is dropped)
+    fp = tc_sfp(tc);
+    if (fp == tc_stack_base(tc) && !minim_nullp(tc_stack_link(tc))) {
+        srecord = tc_stack_link(tc);
+    } else {
+        // the segment is no longer rescanned as part of the roots, so
+        // frames pushed since the last collection must be remembered
+        GC_write_barrier(tc_stack_base(tc));
+        srecord = Mcached_stack(
+            tc_stack_base(tc),
+            tc_stack_link(tc),
+            tc_stack_size(tc),
+            Mcontinuation(fp)
+        );
+    }
 
     // allocate new stack segment
     stack = GC_alloc(actual);
@@ -94,11 +114,16 @@ static void grow_stack(mobj tc, size_t size) {
     tc_stack_link(tc) = srecord;
     tc_stack_size(tc) = actual;
     tc_sfp(tc) = tc_stack_base(tc);
-    tc_esp(tc) = tc_sfp(tc) + tc_stack_size(tc) - stack_slop;
+    tc_esp(tc) = ptr_add(tc_sfp(tc), tc_stack_size(tc) - stack_slop);
+
+    // move arguments of the current frame (and its locals)
+    memcpy(tc_frame(tc), frame_args(fp), tc_ac(tc) * sizeof(mobj));
+    if (tc_lfp(tc) == frame_args(fp))
+        tc_lfp(tc) = tc_frame(tc);
 }
 
 void reserve_stack(mobj tc, size_t argc) {
-    size_t req = (1 + argc) * ptr_size;
+    size_t req = (frame_header_size + argc) * ptr_size;
     if (stack_overflowp(tc, req))
         grow_stack(tc, req);
 }
@@ -115,6 +140,49 @@ static void maybe_grow_stack(mobj tc, size_t argc) {
     reserve_stack(tc, tc_ac(tc) + argc);
 }
 
+// Reserves the first `n` slots of the current frame for the locals
+// of the procedure, discarding any other arguments.
+static void reserve_frame(mobj tc, size_t n) {
+    reserve_stack(tc, n);
+    tc_ac(tc) = n;
+    tc_lfp(tc) = tc_frame(tc);
+}
+
+// Moves the arguments pushed after the locals of the procedure
+// to the start of the frame for a tail call.
+static void shift_frame(mobj tc, size_t base) {
+    if (base > 0) {
+        tc_ac(tc) -= base;
+        memmove(tc_frame(tc), &tc_frame_ref(tc, base), tc_ac(tc) * sizeof(mobj));
+    }
+}
+
+// Locals are written through `tc_lfp` which points into an older
+// stack segment if the stack grew during a call that is still in
+// progress. Unlike the current segment, those are not rescanned
+// by the collector.
+static void stack_write_barrier(mobj tc, mobj *lfp) {
+    mobj srecord, *base;
+
+    base = tc_stack_base(tc);
+    if (lfp >= base && lfp < (mobj *) ptr_add(base, tc_stack_size(tc)))
+        return;
+
+    srecord = tc_stack_link(tc);
+    for (; !minim_nullp(srecord); srecord = cache_stack_prev(srecord)) {
+        base = cache_stack_base(srecord);
+        if (lfp >= base && lfp < (mobj *) ptr_add(base, cache_stack_len(srecord))) {
+            GC_write_barrier(base);
+            return;
+        }
+    }
+}
+
+static void stack_local_set(mobj tc, size_t idx, mobj val) {
+    tc_lfp(tc)[idx] = val;
+    stack_write_barrier(tc, tc_lfp(tc));
+}
+
 static void push_arg(mobj tc, mobj x) {
     tc_frame_ref(tc, tc_ac(tc)) = x;
     tc_ac(tc) += 1;
@@ -127,17 +195,19 @@ static mobj pop_arg(mobj tc) {
 }
 
 static void push_frame(mobj tc, mobj pc) {
-    mobj cc;
-    size_t size;
-
-    // get current continuation and frame size
-    cc = tc_ccont(tc);
-    size = 1 + tc_ac(tc);
-
-    // update current continuation, frame pointer, and argument count
-    tc_ccont(tc) = Mcontinuation(cc, pc, tc_env(tc), tc);
-    tc_sfp(tc) = ptr_add(tc_sfp(tc), size * ptr_size);
-    tc_ra(tc) = pc;
+    mobj *fp;
+
+    // new frame begins after the arguments of the current frame
+    fp = &tc_frame_ref(tc, tc_ac(tc));
+    frame_ra(fp) = pc;
+    frame_env(fp) = tc_env(tc);
+    frame_cp(fp) = tc_cp(tc);
+    frame_ac(fp) = tc_ac(tc);
+    frame_prev(fp) = tc_sfp(tc);
+    frame_lfp(fp) = tc_lfp(tc);
+
+    // update frame pointer, procedure, and argument count
+    tc_sfp(tc) = fp;
     tc_cp(tc) = minim_void;
     tc_ac(tc) = 0;
 }
@@ -164,6 +234,11 @@ static mobj do_ccall(mobj tc, mobj (*prim)()) {
     }
 }
 
+// Variadic primitives take the arguments of the frame directly.
+static mobj do_ccallv(mobj tc, mobj (*prim)(size_t, mobj*)) {
+    return prim(tc_ac(tc), tc_frame(tc));
+}
+
 static mobj do_rest(mobj tc, size_t idx) {
     size_t ac = tc_ac(tc);
     if (idx > ac) {
@@ -179,12 +254,28 @@ static mobj do_rest(mobj tc, size_t idx) {
         // empty
         return minim_null;
     } else {
-        mobj hd, tl;
+        mobj hd, tl, chunk, cell;
+        size_t n;
+
+        // pairs are allocated in chunks, each a single object:
+        // the GC treats a pointer to any pair as one to its chunk
+        hd = tl = NULL;
+        for (; idx < ac; idx += n) {
+            n = ac - idx;
+            if (n > rest_chunk_size)
+                n = rest_chunk_size;
+
+            chunk = GC_alloc(n * minim_cons_size);
+            for (size_t i = 0; i < n; i++) {
+                cell = ptr_add(chunk, i * minim_cons_size);
+                minim_heap_type(cell) = MINIM_OBJ_PAIR;
+                minim_car(cell) = tc_frame_ref(tc, idx + i);
+                minim_cdr(cell) = ptr_add(cell, minim_cons_size);
+            }
 
-        hd = tl = Mcons(tc_frame_ref(tc, idx), NULL);
-        for (idx += 1; idx < ac; idx++) {
-            minim_cdr(tl) = Mcons(tc_frame_ref(tc, idx), NULL);
-            tl = minim_cdr(tl);
+            if (tl == NULL) hd = chunk;
+            else minim_cdr(tl) = chunk;
+            tl = ptr_add(chunk, (n - 1) * minim_cons_size);
         }
 
         minim_cdr(tl) = minim_null;
@@ -192,55 +283,71 @@ static mobj do_rest(mobj tc, size_t idx) {
     }
 }
 
+// Applies the first argument to the remaining arguments, spreading
+// the last one which must be a list. The list is checked while its
+// elements are pushed, so it is only traversed once.
 static void do_apply(mobj tc) {
-    mobj *sfp, rest;
-    size_t i, ac, req;
+    mobj rest, it;
+    size_t ac;
 
     // thread parameters
-    sfp = tc_sfp(tc);
     ac = tc_ac(tc);
 
     // the first argument becomes the current procedure
     tc_cp(tc) = tc_frame_ref(tc, 0);
     if (!minim_procp(tc_cp(tc))) {
-        bad_type_exn("apply", "list?", tc_cp(tc));
+        bad_type_exn("apply", "procedure?", tc_cp(tc));
     }
 
-    // save rest argument (needs to be a list)
+    // pop the rest argument and shift the others by 1
+    // (since `apply` itself is consumed)
     rest = tc_frame_ref(tc, ac - 1);
-    if (!minim_listp(rest)) {
-        bad_type_exn("apply", "list?", rest);
+    tc_ac(tc) = ac - 2;
+    if (ac > 2)
+        memmove(tc_frame(tc), &tc_frame_ref(tc, 1), (ac - 2) * sizeof(mobj));
+
+    // short lists fit in space reserved up front
+    maybe_grow_stack(tc, apply_fast_args);
+    it = rest;
+    for (size_t i = 0; i < apply_fast_args && minim_consp(it); i++) {
+        push_arg(tc, minim_car(it));
+        it = minim_cdr(it);
     }
 
-    // shift arguments by 1 (since `apply` itself is consumed)
-    tc_ac(tc) -= 2;
-    for (i = 0; i < ac - 2; i++)
-        tc_frame_ref(tc, i) = tc_frame_ref(tc, i + 1);
-
-    // check if we have room for the application
-    req = stack_frame_size(tc, list_length(rest));
-    if (stack_overflowp(tc, req)) {
-        grow_stack(tc, req);
-        for (i = 0; i < ac; i++)
-            tc_frame_ref(tc, i) = sfp[i + 1]; 
+    // otherwise, check for room before each push
+    // (doubling the frame so that long lists are copied a few times)
+    for (; minim_consp(it); it = minim_cdr(it)) {
+        if (stack_overflowp(tc, stack_frame_size(tc, 1)))
+            grow_stack(tc, stack_frame_size(tc, tc_ac(tc) + 1));
+        push_arg(tc, minim_car(it));
     }
 
-    // push rest argument to stack
-    for (; !minim_nullp(rest); rest = minim_cdr(rest))
-        push_arg(tc, minim_car(rest));
+    // rest argument must be a list
+    if (!minim_nullp(it)) {
+        bad_type_exn("apply", "list?", rest);
+    }
 }
 
-static mobj do_values(mobj tc) {
-    tc_vc(tc) = tc_ac(tc);
-    if (tc_ac(tc) == 0) {
-        tc_values(tc) = NULL;
+// Values are the arguments pushed after index `base`.
+// Multiple values are copied into the values buffer of the thread,
+// which is only valid until the next `(values ...)`.
+static mobj do_values(mobj tc, size_t base) {
+    tc_vc(tc) = tc_ac(tc) - base;
+    if (tc_vc(tc) == 0) {
         return minim_values;
-    } else if (tc_ac(tc) == 1) {
-        tc_values(tc) = NULL;
-        return tc_frame_ref(tc, 0);
+    } else if (tc_vc(tc) == 1) {
+        return tc_frame_ref(tc, base);
     } else {
-        tc_values(tc) = GC_alloc(tc_vc(tc) * sizeof(mobj));
-        memcpy(tc_values(tc), tc_frame(tc), tc_vc(tc) * sizeof(mobj));
+        if (tc_vc(tc) > tc_values_size(tc)) {
+            // the buffer is a root (see `Mthread_context`)
+            size_t size = 2 * tc_values_size(tc);
+            if (size < tc_vc(tc))
+                size = tc_vc(tc);
+            tc_values(tc) = GC_realloc_root(tc_values(tc), size * sizeof(mobj));
+            tc_values_size(tc) = size;
+        }
+
+        memcpy(tc_values(tc), &tc_frame_ref(tc, base), tc_vc(tc) * sizeof(mobj));
         return minim_values;
     }
 }
@@ -265,11 +372,24 @@ static mobj force_single_value(mobj tc, mobj x) {
     return x;
 }
 
-static void tl_env_bind_values(mobj tc, mobj valc, mobj ids, mobj val) {
+// Calls `proc` with the last `argc` arguments of the current frame
+// by moving them into a new frame that returns to `pc`. Used when
+// an inlined primitive has been redefined.
+static void push_call_frame(mobj tc, mobj proc, size_t argc, mobj *pc) {
+    mobj *args;
+
+    reserve_stack(tc, tc_ac(tc) + frame_header_size);
+    tc_ac(tc) -= argc;
+    args = &tc_frame_ref(tc, tc_ac(tc));
+    memmove(args + frame_header_size, args, argc * sizeof(mobj));
+    push_frame(tc, (mobj) pc);
+    tc_ac(tc) = argc;
+    tc_cp(tc) = force_single_value(tc, proc);
+}
+
+static void tl_env_bind_values(mobj tc, size_t count, mobj ids, mobj val) {
     mobj cell;
-    size_t count;
-    
-    count = minim_fixnum(valc);
+
     if (minim_valuesp(val)) {
         // multi-valued result
         if (tc_vc(tc) != count) {
@@ -281,7 +401,9 @@ static void tl_env_bind_values(mobj tc, mobj valc, mobj ids, mobj val) {
             SET_NAME_IF_CLOSURE(minim_car(ids), val);
             cell = top_env_find(tc_tenv(tc), minim_car(ids));
             if (!minim_falsep(cell)) {
+                jit_unregister_inline(minim_cdar(cell), val);
                 minim_cdar(cell) = val;
+                minim_write_barrier(minim_car(cell), val);
             } else {
                 top_env_insert(tc_tenv(tc), minim_car(ids), val);
             }
@@ -297,63 +419,91 @@ static void tl_env_bind_values(mobj tc, mobj valc, mobj ids, mobj val) {
         SET_NAME_IF_CLOSURE(minim_car(ids), val);
         cell = top_env_find(tc_tenv(tc), minim_car(ids));
         if (!minim_falsep(cell)) {
+            jit_unregister_inline(minim_cdar(cell), val);
             minim_cdar(cell) = val;
+            minim_write_barrier(minim_car(cell), val);
         } else {
             top_env_insert(tc_tenv(tc), minim_car(ids), val);
         }
     }
 }
 
-static mobj tl_env_lookup_value(mobj tc, mobj id) {
-    mobj cell = top_env_find(tc_tenv(tc), id);
+// Each top-level reference caches the `(<id> . <value>)` cell it found
+// along with the environment it was found in. Cells are never removed
+// from an environment, so the cache stays valid until the reference
+// runs in another environment, e.g., a copy made by `top_env_copy`.
+static mobj tl_env_find_cached(mobj tc, mobj id, mobj cache) {
+    mobj cell;
+
+    if (minim_car(cache) == tc_tenv(tc))
+        return minim_cdr(cache);
+
+    cell = top_env_find(tc_tenv(tc), id);
     if (!minim_falsep(cell)) {
         cell = minim_car(cell); // extract (<id> . <value>) cell
-        if (minim_cdr(cell) == minim_unbound) {
-            minim_error1(NULL, "cannot use before initialization", id);
-        }
-        return minim_cdr(cell);
-    } else {
-        minim_error1(NULL, "cannot use before initialization", id);
+        minim_car(cache) = tc_tenv(tc);
+        minim_cdr(cache) = cell;
+        GC_write_barrier(cache);
     }
+
+    return cell;
+}
+
+static mobj tl_env_lookup_value(mobj tc, mobj id, mobj cache) {
+    mobj cell = tl_env_find_cached(tc, id, cache);
+    if (minim_falsep(cell) || minim_cdr(cell) == minim_unbound)
+        minim_error1(NULL, "cannot use before initialization", id);
+    return minim_cdr(cell);
 }
 
-static mobj tl_env_lookup_cell(mobj tc, mobj id) {
-    mobj cell = top_env_find(tc_tenv(tc), id);
+static mobj tl_env_lookup_cell(mobj tc, mobj id, mobj cache) {
+    mobj cell = tl_env_find_cached(tc, id, cache);
     if (minim_falsep(cell)) {
-        cell = top_env_insert(tc_tenv(tc), id, minim_unbound);
+        top_env_insert(tc_tenv(tc), id, minim_unbound);
+        cell = tl_env_find_cached(tc, id, cache);
     }
 
-    return minim_car(cell);
+    return cell;
 }
 
-static void tl_env_rebind(mobj tc, mobj id, mobj val) {
-    mobj cell = top_env_find(tc_tenv(tc), id);
-    minim_cdar(cell) = val;
+static void tl_env_rebind(mobj tc, mobj id, mobj cache, mobj val) {
+    mobj cell = tl_env_find_cached(tc, id, cache);
+    minim_cdr(cell) = val;
+    minim_write_barrier(cell, val);
 }
 
-static void env_bind_cell(mobj tc, mobj cell, mobj idx) {
-    minim_env_ref(tc_env(tc), minim_fixnum(idx)) = cell;
+static void env_bind_cell(mobj tc, mobj cell, size_t idx) {
+    minim_env_ref(tc_env(tc), idx) = cell;
+    minim_write_barrier(tc_env(tc), cell);
 }
 
-static void env_rebind(mobj tc, mobj idx, mobj val) {
-    minim_cdr(minim_env_ref(tc_env(tc), minim_fixnum(idx))) = val;
+static void env_rebind(mobj tc, size_t idx, mobj val) {
+    mobj cell = minim_env_ref(tc_env(tc), idx);
+    minim_cdr(cell) = val;
+    minim_write_barrier(cell, val);
 }
 
-static void env_bind_values(mobj tc, mobj idx, mobj valc, mobj ids, mobj val) {
-    size_t count, bidx;
-    
-    count = minim_fixnum(valc);
+static void env_local_set(mobj tc, size_t idx, mobj val) {
+    minim_env_ref(tc_env(tc), idx) = val;
+    minim_write_barrier(tc_env(tc), val);
+}
+
+// Values are stored directly in the environment:
+// the compiler moves mutated variables into cells afterwards.
+static void env_bind_values(mobj tc, size_t idx, size_t count, mobj ids, mobj val) {
+    size_t bidx;
+
     if (minim_valuesp(val)) {
         // multi-valued result
         if (tc_vc(tc) != count) {
             result_arity_exn(NULL, count, tc_vc(tc));
         }
 
-        bidx = minim_fixnum(idx);
+        bidx = idx;
         for (size_t i = 0; i < count; i++) {
             mobj val = tc_values(tc)[i];
             SET_NAME_IF_CLOSURE(minim_car(ids), val);
-            minim_env_ref(tc_env(tc), bidx) = Mcons(minim_car(ids), val);
+            env_local_set(tc, bidx, val);
             ids = minim_cdr(ids);
             bidx += 1;
         }
@@ -364,12 +514,40 @@ static void env_bind_values(mobj tc, mobj idx, mobj valc, mobj ids, mobj val) {
         }
 
         SET_NAME_IF_CLOSURE(minim_car(ids), val);
-        minim_env_ref(tc_env(tc), minim_fixnum(idx)) = Mcons(minim_car(ids), val);
+        env_local_set(tc, idx, val);
     }
 }
 
-static mobj env_lookup_value(mobj tc, mobj idx) {
-    mobj cell = minim_env_ref(tc_env(tc), minim_fixnum(idx));
+static void stack_bind_values(mobj tc, size_t idx, size_t count, mobj ids, mobj val) {
+    mobj *lfp = tc_lfp(tc);
+
+    if (minim_valuesp(val)) {
+        // multi-valued result
+        if (tc_vc(tc) != count) {
+            result_arity_exn(NULL, count, tc_vc(tc));
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            mobj val = tc_values(tc)[i];
+            SET_NAME_IF_CLOSURE(minim_car(ids), val);
+            lfp[idx + i] = val;
+            ids = minim_cdr(ids);
+        }
+    } else {
+        // single-valued result
+        if (count != 1) {
+            result_arity_exn(NULL, count, 1);
+        }
+
+        SET_NAME_IF_CLOSURE(minim_car(ids), val);
+        lfp[idx] = val;
+    }
+
+    stack_write_barrier(tc, lfp);
+}
+
+static mobj env_lookup_value(mobj tc, size_t idx) {
+    mobj cell = minim_env_ref(tc_env(tc), idx);
     if (minim_cdr(cell) == minim_unbound) {
         minim_error1(
             NULL,
@@ -381,18 +559,31 @@ static mobj env_lookup_value(mobj tc, mobj idx) {
     return minim_cdr(cell);
 }
 
-static mobj env_lookup_cell(mobj tc, mobj idx) {
-    return minim_env_ref(tc_env(tc), minim_fixnum(idx));
+static mobj env_lookup_cell(mobj tc, size_t idx) {
+    return minim_env_ref(tc_env(tc), idx);
+}
+
+// Captured variables of a closure are stored in its environment.
+static mobj make_closure(mobj tc, mobj code, size_t count) {
+    return Mclosure((count > 0) ? Menv(count) : tc_env(tc), code);
+}
+
+static void closure_set(mobj proc, size_t idx, mobj val) {
+    minim_env_ref(minim_closure_env(proc), idx) = val;
+    minim_write_barrier(minim_closure_env(proc), val);
 }
 
-static void env_load_closure(mobj tc, mobj proc) {
-    for (size_t i = 0; i < minim_closure_count(proc); i++) {
-        minim_env_ref(tc_env(tc), i) = minim_closure_ref(proc, i);
+static void env_load_closure(mobj tc, mobj proc, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        minim_env_ref(tc_env(tc), i) = minim_env_ref(minim_closure_env(proc), i);
     }
+
+    if (count > 0)
+        GC_write_barrier(tc_env(tc));
 }
 
-static mobj load_reg(mobj tc, mobj *tregs, mobj ins, mobj idx) {
-    switch (minim_fixnum(idx)) {
+static mobj load_reg(mobj tc, mobj *tregs, size_t idx) {
+    switch (idx) {
         case 0:
             return tregs[0];
         case 1:
@@ -404,12 +595,12 @@ static mobj load_reg(mobj tc, mobj *tregs, mobj ins, mobj idx) {
         case 4:
             return (mobj) tc_ac(tc);
         default:
-            minim_error1(NULL, "invalid register", ins);
+            minim_error1(NULL, "invalid register", Mfixnum(idx));
     }
 }
 
-static void store_reg(mobj tc, mobj *tregs, mobj ins, mobj idx, mobj val) {
-    switch (minim_fixnum(idx)) {
+static void store_reg(mobj tc, mobj *tregs, size_t idx, mobj val) {
+    switch (idx) {
         case 0:
             tregs[0] = val;
             break;
@@ -426,7 +617,334 @@ static void store_reg(mobj tc, mobj *tregs, mobj ins, mobj idx, mobj val) {
             tc_ac(tc) = (mfixnum) val;
             break;
         default:
-            minim_error1(NULL, "invalid register", ins);
+            minim_error1(NULL, "invalid register", Mfixnum(idx));
+    }
+}
+
+// instruction operands
+#define operand(i)      (istream[1 + (i)])
+#define ioperand(i)     ((mfixnum) operand(i))
+
+//
+//  Native code support
+//
+//  Native code performs most instructions by calling into
+//  these procedures with the thread context, the temporary
+//  registers, and the address of the instruction.
+//
+
+static void native_lookup(mobj tc, mobj *tregs, mobj *istream) {
+    tregs[0] = env_lookup_value(tc, ioperand(0));
+}
+
+static void native_lookup_cell(mobj tc, mobj *tregs, mobj *istream) {
+    tregs[0] = env_lookup_cell(tc, ioperand(0));
+}
+
+static void native_local_set(mobj tc, mobj *tregs, mobj *istream) {
+    env_local_set(tc, ioperand(0), tregs[0]);
+    tregs[0] = minim_void;
+}
+
+static void native_tl_lookup(mobj tc, mobj *tregs, mobj *istream) {
+    tregs[0] = tl_env_lookup_value(tc, operand(0), operand(1));
+}
+
+static void native_tl_lookup_cell(mobj tc, mobj *tregs, mobj *istream) {
+    tregs[0] = tl_env_lookup_cell(tc, operand(0), operand(1));
+}
+
+static void native_set_proc(mobj tc, mobj *tregs, mobj *istream) {
+    tc_cp(tc) = force_single_value(tc, tregs[0]);
+}
+
+static void native_push(mobj tc, mobj *tregs, mobj *istream) {
+    tregs[0] = force_single_value(tc, tregs[0]);
+    push_arg(tc, tregs[0]);
+}
+
+static void native_pop(mobj tc, mobj *tregs, mobj *istream) {
+    tregs[0] = pop_arg(tc);
+}
+
+static void native_closure_ref(mobj tc, mobj *tregs, mobj *istream) {
+    mobj v0 = load_reg(tc, tregs, ioperand(0));
+    tregs[0] = minim_env_ref(minim_closure_env(v0), ioperand(1));
+}
+
+static void native_closure_set(mobj tc, mobj *tregs, mobj *istream) {
+    mobj v0 = load_reg(tc, tregs, ioperand(0));
+    mobj v1 = load_reg(tc, tregs, ioperand(2));
+    closure_set(v0, ioperand(1), v1);
+}
+
+static void native_closure_bind(mobj tc, mobj *tregs, mobj *istream) {
+    env_load_closure(tc, tc_cp(tc), ioperand(0));
+}
+
+static void native_ccall(mobj tc, mobj *tregs, mobj *istream) {
+    tregs[0] = do_ccall(tc, (void*) operand(0));
+}
+
+static void native_ccallv(mobj tc, mobj *tregs, mobj *istream) {
+    tregs[0] = do_ccallv(tc, (void*) operand(0));
+}
+
+static void native_bind(mobj tc, mobj *tregs, mobj *istream) {
+    env_bind_cell(tc, Mcons(operand(1), tregs[0]), ioperand(0));
+    tregs[0] = minim_void;
+}
+
+static void native_bind_cell(mobj tc, mobj *tregs, mobj *istream) {
+    env_bind_cell(tc, tregs[0], ioperand(0));
+    tregs[0] = minim_void;
+}
+
+static void native_bind_values(mobj tc, mobj *tregs, mobj *istream) {
+    env_bind_values(tc, ioperand(0), ioperand(1), operand(2), tregs[0]);
+    tregs[0] = minim_void;
+}
+
+static void native_tl_bind_values(mobj tc, mobj *tregs, mobj *istream) {
+    tl_env_bind_values(tc, ioperand(0), operand(1), tregs[0]);
+    tregs[0] = minim_void;
+}
+
+static void native_rebind(mobj tc, mobj *tregs, mobj *istream) {
+    env_rebind(tc, ioperand(0), tregs[0]);
+    tregs[0] = minim_void;
+}
+
+static void native_tl_rebind(mobj tc, mobj *tregs, mobj *istream) {
+    tl_env_rebind(tc, operand(0), operand(1), tregs[0]);
+}
+
+static void native_push_env(mobj tc, mobj *tregs, mobj *istream) {
+    tc_env(tc) = Menv(ioperand(0));
+}
+
+static void native_save_cc(mobj tc, mobj *tregs, mobj *istream) {
+    push_frame(tc, (mobj) (istream + ioperand(0)));
+}
+
+static void native_get_tenv(mobj tc, mobj *tregs, mobj *istream) {
+    store_reg(tc, tregs, ioperand(0), tc_tenv(tc));
+}
+
+static void native_set_tenv(mobj tc, mobj *tregs, mobj *istream) {
+    tc_tenv(tc) = load_reg(tc, tregs, ioperand(0));
+}
+
+static void native_do_eval(mobj tc, mobj *tregs, mobj *istream) {
+    tregs[0] = Mclosure(Menv(0), compile_expr(tregs[0]));
+}
+
+static void native_do_rest(mobj tc, mobj *tregs, mobj *istream) {
+    tregs[0] = do_rest(tc, ioperand(0));
+}
+
+static void native_do_values(mobj tc, mobj *tregs, mobj *istream) {
+    tregs[0] = do_values(tc, ioperand(0));
+}
+
+static void native_do_with_values(mobj tc, mobj *tregs, mobj *istream) {
+    values_to_args(tc, tregs[0]);
+}
+
+static void native_make_closure(mobj tc, mobj *tregs, mobj *istream) {
+    tregs[0] = make_closure(tc, operand(0), ioperand(1));
+}
+
+static void native_check_stack(mobj tc, mobj *tregs, mobj *istream) {
+    maybe_grow_stack(tc, ioperand(0));
+}
+
+static void native_reserve_frame(mobj tc, mobj *tregs, mobj *istream) {
+    reserve_frame(tc, ioperand(0));
+}
+
+static void native_shift_frame(mobj tc, mobj *tregs, mobj *istream) {
+    shift_frame(tc, ioperand(0));
+}
+
+static void native_stack_set(mobj tc, mobj *tregs, mobj *istream) {
+    stack_local_set(tc, ioperand(0), tregs[0]);
+    tregs[0] = minim_void;
+}
+
+static void native_stack_bind_values(mobj tc, mobj *tregs, mobj *istream) {
+    stack_bind_values(tc, ioperand(0), ioperand(1), operand(2), tregs[0]);
+    tregs[0] = minim_void;
+}
+
+// inlined primitives (the operator is checked by native code)
+
+static void native_prim_cons(mobj tc, mobj *tregs, mobj *istream) {
+    mobj y = pop_arg(tc);
+    tregs[0] = Mcons(pop_arg(tc), y);
+}
+
+static void native_prim_car(mobj tc, mobj *tregs, mobj *istream) {
+    tregs[0] = minim_car(pop_arg(tc));
+}
+
+static void native_prim_cdr(mobj tc, mobj *tregs, mobj *istream) {
+    tregs[0] = minim_cdr(pop_arg(tc));
+}
+
+static void native_prim_eq(mobj tc, mobj *tregs, mobj *istream) {
+    mobj y = pop_arg(tc);
+    tregs[0] = minim_eqp(pop_arg(tc), y) ? minim_true : minim_false;
+}
+
+static void native_prim_nullp(mobj tc, mobj *tregs, mobj *istream) {
+    tregs[0] = minim_nullp(pop_arg(tc)) ? minim_true : minim_false;
+}
+
+static void native_prim_pairp(mobj tc, mobj *tregs, mobj *istream) {
+    mobj x = pop_arg(tc);
+    tregs[0] = minim_consp(x) ? minim_true : minim_false;
+}
+
+static void native_prim_not(mobj tc, mobj *tregs, mobj *istream) {
+    tregs[0] = minim_falsep(pop_arg(tc)) ? minim_true : minim_false;
+}
+
+static void native_prim_fixnump(mobj tc, mobj *tregs, mobj *istream) {
+    tregs[0] = minim_fixnump(pop_arg(tc)) ? minim_true : minim_false;
+}
+
+static void native_prim_fx_add(mobj tc, mobj *tregs, mobj *istream) {
+    mobj y = pop_arg(tc);
+    tregs[0] = fx2_add(pop_arg(tc), y);
+}
+
+static void native_prim_fx_sub(mobj tc, mobj *tregs, mobj *istream) {
+    mobj y = pop_arg(tc);
+    tregs[0] = fx2_sub(pop_arg(tc), y);
+}
+
+static void native_prim_fx_eq(mobj tc, mobj *tregs, mobj *istream) {
+    mfixnum y = minim_fixnum(pop_arg(tc));
+    tregs[0] = (minim_fixnum(pop_arg(tc)) == y) ? minim_true : minim_false;
+}
+
+static void native_prim_fx_lt(mobj tc, mobj *tregs, mobj *istream) {
+    mfixnum y = minim_fixnum(pop_arg(tc));
+    tregs[0] = (minim_fixnum(pop_arg(tc)) < y) ? minim_true : minim_false;
+}
+
+static void native_prim_fx_gt(mobj tc, mobj *tregs, mobj *istream) {
+    mfixnum y = minim_fixnum(pop_arg(tc));
+    tregs[0] = (minim_fixnum(pop_arg(tc)) > y) ? minim_true : minim_false;
+}
+
+static void native_prim_vector_ref(mobj tc, mobj *tregs, mobj *istream) {
+    mfixnum i = minim_fixnum(pop_arg(tc));
+    tregs[0] = minim_vector_ref(pop_arg(tc), i);
+}
+
+// Returns the procedure that native code should call to perform
+// an instruction or `NULL` if the instruction is either emitted
+// inline or must be performed by the interpreter.
+void *native_helper(opcode_type op) {
+    switch (op) {
+    case OP_LOOKUP:
+        return native_lookup;
+    case OP_LOOKUP_CELL:
+        return native_lookup_cell;
+    case OP_LOCAL_SET:
+        return native_local_set;
+    case OP_TL_LOOKUP:
+        return native_tl_lookup;
+    case OP_TL_LOOKUP_CELL:
+        return native_tl_lookup_cell;
+    case OP_SET_PROC:
+        return native_set_proc;
+    case OP_PUSH:
+        return native_push;
+    case OP_POP:
+        return native_pop;
+    case OP_CLOSURE_REF:
+        return native_closure_ref;
+    case OP_CLOSURE_SET:
+        return native_closure_set;
+    case OP_CLOSURE_BIND:
+        return native_closure_bind;
+    case OP_CCALL:
+        return native_ccall;
+    case OP_CCALLV:
+        return native_ccallv;
+    case OP_BIND:
+        return native_bind;
+    case OP_BIND_CELL:
+        return native_bind_cell;
+    case OP_BIND_VALUES:
+        return native_bind_values;
+    case OP_TL_BIND_VALUES:
+        return native_tl_bind_values;
+    case OP_REBIND:
+        return native_rebind;
+    case OP_TL_REBIND:
+        return native_tl_rebind;
+    case OP_PUSH_ENV:
+        return native_push_env;
+    case OP_SAVE_CC:
+        return native_save_cc;
+    case OP_GET_TENV:
+        return native_get_tenv;
+    case OP_SET_TENV:
+        return native_set_tenv;
+    case OP_DO_EVAL:
+        return native_do_eval;
+    case OP_DO_REST:
+        return native_do_rest;
+    case OP_DO_VALUES:
+        return native_do_values;
+    case OP_DO_WITH_VALUES:
+        return native_do_with_values;
+    case OP_MAKE_CLOSURE:
+        return native_make_closure;
+    case OP_CHECK_STACK:
+        return native_check_stack;
+    case OP_RESERVE_FRAME:
+        return native_reserve_frame;
+    case OP_SHIFT_FRAME:
+        return native_shift_frame;
+    case OP_STACK_SET:
+        return native_stack_set;
+    case OP_STACK_BIND_VALUES:
+        return native_stack_bind_values;
+    case OP_PRIM_CONS:
+        return native_prim_cons;
+    case OP_PRIM_CAR:
+        return native_prim_car;
+    case OP_PRIM_CDR:
+        return native_prim_cdr;
+    case OP_PRIM_EQ:
+        return native_prim_eq;
+    case OP_PRIM_NULLP:
+        return native_prim_nullp;
+    case OP_PRIM_PAIRP:
+        return native_prim_pairp;
+    case OP_PRIM_NOT:
+        return native_prim_not;
+    case OP_PRIM_FIXNUMP:
+        return native_prim_fixnump;
+    case OP_PRIM_FX_ADD:
+        return native_prim_fx_add;
+    case OP_PRIM_FX_SUB:
+        return native_prim_fx_sub;
+    case OP_PRIM_FX_EQ:
+        return native_prim_fx_eq;
+    case OP_PRIM_FX_LT:
+        return native_prim_fx_lt;
+    case OP_PRIM_FX_GT:
+        return native_prim_fx_gt;
+    case OP_PRIM_VECTOR_REF:
+        return native_prim_vector_ref;
+    default:
+        return NULL;
     }
 }
 
@@ -434,10 +952,23 @@ static void store_reg(mobj tc, mobj *tregs, mobj ins, mobj idx, mobj val) {
 //  Evaluator
 //
 
+// instruction dispatch
+#define dispatch()      goto *labels[(uintptr_t) *istream]
+#define next(n)         { istream += 1 + (n); dispatch(); }
+
+// inlined primitives call the operator instead
+// if it is not the expected primitive
+#define prim_guard(argc) {                                      \
+    if (tregs[0] != operand(0)) {                               \
+        prim_guard_misses += 1;                                 \
+        push_call_frame(tc, tregs[0], argc, istream + 2);       \
+        goto application;                                       \
+    }                                                           \
+}
+
 static mobj eval_istream(mobj tc, mobj *istream) {
-    mobj ins, ty;   // instruction stream, instruction type
-    mobj cc;        // current continuation
-    mobj penv;      // run-time environment upon entry
+    mobj cc;                    // cached return point
+    jmp_buf reentry, *preentry; // reentry point upon error
 
     // caller saved registers:
     //  %r0 [%res] - result
@@ -449,199 +980,487 @@ static mobj eval_istream(mobj tc, mobj *istream) {
 
     // temporary (non-register) locations
     mobj v0, v1;
+
+    // instruction handlers (indexed by opcode)
+    static void *labels[opcode_count] = {
+        [OP_END] = &&do_end,
+        [OP_ENTRY] = &&do_entry,
+        [OP_LITERAL] = &&do_literal,
+        [OP_LOOKUP] = &&do_lookup,
+        [OP_LOOKUP_CELL] = &&do_lookup_cell,
+        [OP_LOCAL_REF] = &&do_local_ref,
+        [OP_LOCAL_SET] = &&do_local_set,
+        [OP_TL_LOOKUP] = &&do_tl_lookup,
+        [OP_TL_LOOKUP_CELL] = &&do_tl_lookup_cell,
+        [OP_SET_PROC] = &&do_set_proc,
+        [OP_PUSH] = &&do_push,
+        [OP_POP] = &&do_pop,
+        [OP_MOV] = &&do_mov,
+        [OP_CLOSURE_REF] = &&do_closure_ref,
+        [OP_CLOSURE_SET] = &&do_closure_set,
+        [OP_CLOSURE_BIND] = &&do_closure_bind,
+        [OP_APPLY] = &&application,
+        [OP_RET] = &&restore_frame,
+        [OP_CCALL] = &&do_ccall,
+        [OP_CCALLV] = &&do_ccallv,
+        [OP_BIND] = &&do_bind,
+        [OP_BIND_CELL] = &&do_bind_cell,
+        [OP_BIND_VALUES] = &&do_bind_values,
+        [OP_TL_BIND_VALUES] = &&do_tl_bind_values,
+        [OP_REBIND] = &&do_rebind,
+        [OP_TL_REBIND] = &&do_tl_rebind,
+        [OP_PUSH_ENV] = &&do_push_env,
+        [OP_SAVE_CC] = &&do_save_cc,
+        [OP_GET_ARG] = &&do_get_arg,
+        [OP_SET_ARG] = &&do_set_arg,
+        [OP_GET_TENV] = &&do_get_tenv,
+        [OP_SET_TENV] = &&do_set_tenv,
+        [OP_DO_APPLY] = &&do_do_apply,
+        [OP_DO_ARITY_ERROR] = &&do_do_arity_error,
+        [OP_DO_EVAL] = &&do_do_eval,
+        [OP_DO_RAISE] = &&do_raise,
+        [OP_DO_REST] = &&do_do_rest,
+        [OP_DO_VALUES] = &&do_do_values,
+        [OP_DO_WITH_VALUES] = &&do_do_with_values,
+        [OP_CLEAR_FRAME] = &&do_clear_frame,
+        [OP_BRANCHA] = &&do_brancha,
+        [OP_BRANCHF] = &&do_branchf,
+        [OP_BRANCHGT] = &&do_branchgt,
+        [OP_BRANCHLT] = &&do_branchlt,
+        [OP_BRANCHNE] = &&do_branchne,
+        [OP_MAKE_CLOSURE] = &&do_make_closure,
+        [OP_CHECK_STACK] = &&do_check_stack,
+        [OP_RESERVE_FRAME] = &&do_reserve_frame,
+        [OP_SHIFT_FRAME] = &&do_shift_frame,
+        [OP_STACK_REF] = &&do_stack_ref,
+        [OP_STACK_SET] = &&do_stack_set,
+        [OP_STACK_BIND_VALUES] = &&do_stack_bind_values,
+        [OP_PRIM_CONS] = &&do_prim_cons,
+        [OP_PRIM_CAR] = &&do_prim_car,
+        [OP_PRIM_CDR] = &&do_prim_cdr,
+        [OP_PRIM_EQ] = &&do_prim_eq,
+        [OP_PRIM_NULLP] = &&do_prim_nullp,
+        [OP_PRIM_PAIRP] = &&do_prim_pairp,
+        [OP_PRIM_NOT] = &&do_prim_not,
+        [OP_PRIM_FIXNUMP] = &&do_prim_fixnump,
+        [OP_PRIM_FX_ADD] = &&do_prim_fx_add,
+        [OP_PRIM_FX_SUB] = &&do_prim_fx_sub,
+        [OP_PRIM_FX_EQ] = &&do_prim_fx_eq,
+        [OP_PRIM_FX_LT] = &&do_prim_fx_lt,
+        [OP_PRIM_FX_GT] = &&do_prim_fx_gt,
+        [OP_PRIM_VECTOR_REF] = &&do_prim_vector_ref,
+    };
     
-    // setup interpreter
+    // setup interpreter: the entry frame returns to the caller
     tc = current_tc();
-    tc_ra(tc) = NULL;
-    tc_cp(tc) = minim_void;
-    tc_ac(tc) = 0;
+    maybe_grow_stack(tc, frame_header_size);
+    push_frame(tc, NULL);
 
     // need to stash for when we exit this function
-    penv = tc_env(tc);
+    preentry = tc_reentry(tc);
+    tc_reentry(tc) = &reentry;
 
     // possibly handle long jump back into the procedure
-    if (setjmp(*tc_reentry(tc)) != 0) {
+    if (setjmp(reentry) != 0) {
         // long jumped from somewhere mysterious
         // valid long jumps require an immediate function application
         goto application;
     }
 
-// instruction processor
-loop:
-    ins = *istream;
-    if (!minim_consp(ins)) {
-        minim_error1(NULL, "executing non-bytecode", ins);
-    }
-
-    ty = minim_car(ins);
-    if (ty == literal_symbol) {
-        // literal
-        tregs[0] = minim_cadr(ins);
-    } else if (ty == lookup_symbol) {
-        // lookup
-        tregs[0] = env_lookup_value(tc, minim_cadr(ins));
-    } else if (ty == lookup_cell_symbol) {
-        // lookup-cell
-        tregs[0] = env_lookup_cell(tc, minim_cadr(ins));
-    } else if (ty == tl_lookup_symbol) {
-        // top-level lookup
-        tregs[0] = tl_env_lookup_value(tc, minim_cadr(ins));
-    } else if (ty == tl_lookup_cell_symbol) {
-        // top-level lookup
-        tregs[0] = tl_env_lookup_cell(tc, minim_cadr(ins));
-    } else if (ty == set_proc_symbol) {
-        // set-proc
-        tc_cp(tc) = force_single_value(tc, tregs[0]);
-    } else if (ty == push_symbol) {
-        // push
-        tregs[0] = force_single_value(tc, tregs[0]);
-        push_arg(tc, tregs[0]);
-    } else if (ty == pop_symbol) {
-        // pop
-        tregs[0] = pop_arg(tc);
-    } else if (ty == mov_symbol) {
-        // move
-        v0 = load_reg(tc, tregs, ins, minim_car(minim_cddr(ins)));
-        store_reg(tc, tregs, ins, minim_cadr(ins), v0);
-    } else if (ty == closure_ref_symbol) {
-        // closure-ref
-        v0 = load_reg(tc, tregs, ins, minim_cadr(ins));
-        tregs[0] = minim_closure_ref(v0, minim_fixnum(minim_car(minim_cddr(ins))));
-    } else if (ty == closure_set_symbol) {
-        // closure-set!
-        v0 = load_reg(tc, tregs, ins, minim_cadr(ins));
-        v1 = load_reg(tc, tregs, ins, minim_cadr(minim_cddr(ins)));
-        minim_closure_ref(v0, minim_fixnum(minim_car(minim_cddr(ins)))) = v1;
-    } else if (ty == closure_bind_symbol) {
-        // closure-bind!
-        env_load_closure(tc, tc_cp(tc));
-    } else if (ty == apply_symbol) {
-        // apply
-application:
-        if (minim_closurep(tc_cp(tc))) {
-            goto call_closure;
-        } else {
-            goto not_procedure;
-        }
-    } else if (ty == ret_symbol) {
-        // ret
-        goto restore_frame;
-    } else if (ty == ccall_symbol) {
-        // ccall
-        tregs[0] = do_ccall(tc, (void*) minim_fixnum(minim_cadr(ins)));
-    } else if (ty == bind_symbol) {
-        // bind
-        env_bind_cell(tc, Mcons(minim_car(minim_cddr(ins)), tregs[0]), minim_cadr(ins));
-        tregs[0] = minim_void;
-    } else if (ty == bind_cell_symbol) {
-        // bind-cell
-        env_bind_cell(tc, tregs[0], minim_cadr(ins));
-        tregs[0] = minim_void;
-    } else if (ty == bind_values_symbol) {
-        // bind-values
-        env_bind_values(tc, minim_cadr(ins), minim_car(minim_cddr(ins)), minim_cadr(minim_cddr(ins)), tregs[0]);
-        tregs[0] = minim_void;
-    } else if (ty == tl_bind_values_symbol) {
-        // tl-bind-values
-        tl_env_bind_values(tc, minim_cadr(ins), minim_car(minim_cddr(ins)), tregs[0]);
-        tregs[0] = minim_void;
-    } else if (ty == rebind_symbol) {
-        // rebind
-        env_rebind(tc, minim_cadr(ins), tregs[0]);
-        tregs[0] = minim_void;
-    } else if (ty == tl_rebind_symbol) {
-        // tl-rebind
-        tl_env_rebind(tc, minim_cadr(ins), tregs[0]);
-    } else if (ty == push_env_symbol) {
-        // push-env
-        tc_env(tc) = Menv(minim_fixnum(minim_cadr(ins)));
-    } else if (ty == save_cc_symbol) {
-        // save-cc
-        push_frame(tc, (mobj) minim_fixnum(minim_cadr(ins)));
-    } else if (ty == get_arg_symbol) {
-        // (get-arg <reg> <stack index>)
-        v0 = tc_frame_ref(tc, minim_fixnum(minim_car(minim_cddr(ins))));
-        store_reg(tc, tregs, ins, minim_cadr(ins), v0);
-    } else if (ty == set_arg_symbol) {
-        // set-arg
-        tc_frame_ref(tc, minim_fixnum(minim_cadr(ins))) = tregs[0];
-    } else if (ty == get_tenv_symbol) {
-        // (get-tenv <dst reg>)
-        store_reg(tc, tregs, ins, minim_cadr(ins), tc_tenv(tc));
-    } else if (ty == set_tenv_symbol) {
-        // (set-tenv <src reg>)
-        tc_tenv(tc) = load_reg(tc, tregs, ins, minim_cadr(ins));
-    } else if (ty == do_apply_symbol) {
-        // do-apply
-        do_apply(tc);
-        goto application;
-    } else if (ty == do_arity_error_symbol) {
-        // do-apply
-        arity_mismatch_exn(tc_cp(tc), tc_ac(tc));
-    } else if (ty == do_eval_symbol) {
-        // do-eval
-        tregs[0] = Mclosure(Menv(0), compile_expr(tregs[0]), 0);
-    } else if (ty == do_raise_symbol) {
-        // do-raise
-        goto do_raise;
-    } else if (ty == do_rest_symbol) {
-        // do-rest
-        tregs[0] = do_rest(tc, minim_fixnum(minim_cadr(ins)));
-    } else if (ty == do_values_symbol) {
-        // do-values
-        tregs[0] = do_values(tc);
-    } else if (ty == do_with_values_symbol) {
-        // do-with-values
-        values_to_args(tc, tregs[0]);
-    } else if (ty == clear_frame_symbol) {
-        // clear frame
-        tc_cp(tc) = NULL;
-        tc_ac(tc) = 0;
-    } else if (ty == brancha_symbol) {
-        // brancha (jump always)
-        istream = (mobj*) minim_fixnum(minim_cadr(ins));
-        goto loop;
-    } else if (ty == branchf_symbol) {
-        // branchf (jump if #f)
-        if (tregs[0] == minim_false) {
-            istream = (mobj*) minim_fixnum(minim_cadr(ins));
-            goto loop;
-        }
-    } else if (ty == branchgt_symbol) {
-        // branchgt (jump if greater than)
-        if (((mfixnum) tregs[0]) > minim_fixnum(minim_cadr(ins))) {
-            istream = (mobj*) minim_fixnum(minim_car(minim_cddr(ins)));
-            goto loop;
+    // start executing
+    dispatch();
+
+do_entry:
+    // entry point for native code (compiled once the code is hot)
+    if (operand(0) == NULL) {
+        v0 = ptr_add(istream - ioperand(1), -minim_code_header_size * ptr_size);
+        if (minim_code_calls(v0) < native_threshold) {
+            minim_code_calls(v0) += 1;
+            if (minim_code_calls(v0) == native_threshold)
+                write_native(v0);
         }
-    } else if (ty == branchlt_symbol) {
-        // branchlt (jump if less than)
-        if (((mfixnum) tregs[0]) < minim_fixnum(minim_cadr(ins))) {
-            istream = (mobj*) minim_fixnum(minim_car(minim_cddr(ins)));
-            goto loop;
-        }
-    } else if (ty == branchne_symbol) {
-        // branchne (jump if not equal)
-        if (((mfixnum) tregs[0]) != minim_fixnum(minim_cadr(ins))) {
-            istream = (mobj*) minim_fixnum(minim_car(minim_cddr(ins)));
-            goto loop;
+
+        if (operand(0) == NULL)
+            next(2);
+    }
+
+    istream = ((native_proc) operand(0))(tc, tregs);
+    dispatch();
+
+do_literal:
+    // literal
+    tregs[0] = operand(0);
+    next(1);
+
+do_lookup:
+    // lookup
+    tregs[0] = env_lookup_value(tc, ioperand(0));
+    next(1);
+
+do_lookup_cell:
+    // lookup-cell
+    tregs[0] = env_lookup_cell(tc, ioperand(0));
+    next(1);
+
+do_local_ref:
+    // local-ref
+    tregs[0] = minim_env_ref(tc_env(tc), ioperand(0));
+    next(1);
+
+do_local_set:
+    // local-set!
+    env_local_set(tc, ioperand(0), tregs[0]);
+    tregs[0] = minim_void;
+    next(1);
+
+do_tl_lookup:
+    // top-level lookup (fast path if the cached cell is bound)
+    v0 = operand(1);
+    if (minim_car(v0) == tc_tenv(tc)) {
+        v1 = minim_cdr(minim_cdr(v0));
+        if (v1 != minim_unbound) {
+            tregs[0] = v1;
+            next(2);
         }
-    } else if (ty == make_closure_symbol) {
-        // make-closure
-        tregs[0] = Mclosure(tc_env(tc), minim_cadr(ins), minim_fixnum(minim_car(minim_cddr(ins))));
-    } else if (ty == check_stack_symbol) {
-        // check stack
-        maybe_grow_stack(tc, minim_fixnum(minim_cadr(ins)));
+    }
+
+    tregs[0] = tl_env_lookup_value(tc, operand(0), v0);
+    next(2);
+
+do_tl_lookup_cell:
+    // top-level lookup
+    tregs[0] = tl_env_lookup_cell(tc, operand(0), operand(1));
+    next(2);
+
+do_set_proc:
+    // set-proc
+    tc_cp(tc) = force_single_value(tc, tregs[0]);
+    next(0);
+
+do_push:
+    // push
+    tregs[0] = force_single_value(tc, tregs[0]);
+    push_arg(tc, tregs[0]);
+    next(0);
+
+do_pop:
+    // pop
+    tregs[0] = pop_arg(tc);
+    next(0);
+
+do_mov:
+    // move
+    v0 = load_reg(tc, tregs, ioperand(1));
+    store_reg(tc, tregs, ioperand(0), v0);
+    next(2);
+
+do_closure_ref:
+    // closure-ref
+    v0 = load_reg(tc, tregs, ioperand(0));
+    tregs[0] = minim_env_ref(minim_closure_env(v0), ioperand(1));
+    next(2);
+
+do_closure_set:
+    // closure-set!
+    v0 = load_reg(tc, tregs, ioperand(0));
+    v1 = load_reg(tc, tregs, ioperand(2));
+    closure_set(v0, ioperand(1), v1);
+    next(3);
+
+do_closure_bind:
+    // closure-bind!
+    env_load_closure(tc, tc_cp(tc), ioperand(0));
+    next(1);
+
+application:
+    // apply
+    if (minim_closurep(tc_cp(tc))) {
+        goto call_closure;
     } else {
-        minim_error1(NULL, "invalid bytecode", ins);
+        goto not_procedure;
+    }
+
+do_ccall:
+    // ccall
+    tregs[0] = do_ccall(tc, (void*) operand(0));
+    next(1);
+
+do_ccallv:
+    // ccallv
+    tregs[0] = do_ccallv(tc, (void*) operand(0));
+    next(1);
+
+do_bind:
+    // bind
+    env_bind_cell(tc, Mcons(operand(1), tregs[0]), ioperand(0));
+    tregs[0] = minim_void;
+    next(2);
+
+do_bind_cell:
+    // bind-cell
+    env_bind_cell(tc, tregs[0], ioperand(0));
+    tregs[0] = minim_void;
+    next(1);
+
+do_bind_values:
+    // bind-values
+    env_bind_values(tc, ioperand(0), ioperand(1), operand(2), tregs[0]);
+    tregs[0] = minim_void;
+    next(3);
+
+do_tl_bind_values:
+    // tl-bind-values
+    tl_env_bind_values(tc, ioperand(0), operand(1), tregs[0]);
+    tregs[0] = minim_void;
+    next(2);
+
+do_rebind:
+    // rebind
+    env_rebind(tc, ioperand(0), tregs[0]);
+    tregs[0] = minim_void;
+    next(1);
+
+do_tl_rebind:
+    // tl-rebind
+    tl_env_rebind(tc, operand(0), operand(1), tregs[0]);
+    next(2);
+
+do_push_env:
+    // push-env
+    tc_env(tc) = Menv(ioperand(0));
+    next(1);
+
+do_save_cc:
+    // save-cc
+    push_frame(tc, (mobj) (istream + ioperand(0)));
+    next(1);
+
+do_get_arg:
+    // (get-arg <reg> <stack index>)
+    v0 = tc_frame_ref(tc, ioperand(1));
+    store_reg(tc, tregs, ioperand(0), v0);
+    next(2);
+
+do_set_arg:
+    // (set-arg <stack index> <reg>)
+    tc_frame_ref(tc, ioperand(0)) = load_reg(tc, tregs, ioperand(1));
+    next(2);
+
+do_get_tenv:
+    // (get-tenv <dst reg>)
+    store_reg(tc, tregs, ioperand(0), tc_tenv(tc));
+    next(1);
+
+do_set_tenv:
+    // (set-tenv <src reg>)
+    tc_tenv(tc) = load_reg(tc, tregs, ioperand(0));
+    next(1);
+
+do_do_apply:
+    // do-apply
+    do_apply(tc);
+    goto application;
+
+do_do_arity_error:
+    // do-arity-error
+    arity_mismatch_exn(tc_cp(tc), tc_ac(tc));
+
+do_do_eval:
+    // do-eval
+    tregs[0] = Mclosure(Menv(0), compile_expr(tregs[0]));
+    next(0);
+
+do_do_rest:
+    // do-rest
+    tregs[0] = do_rest(tc, ioperand(0));
+    next(1);
+
+do_do_values:
+    // do-values
+    tregs[0] = do_values(tc, ioperand(0));
+    next(1);
+
+do_do_with_values:
+    // do-with-values
+    values_to_args(tc, tregs[0]);
+    next(0);
+
+do_clear_frame:
+    // clear frame (keeping the first `n` slots)
+    tc_cp(tc) = NULL;
+    tc_ac(tc) = ioperand(0);
+    next(1);
+
+do_brancha:
+    // brancha (jump always)
+    istream += ioperand(0);
+    dispatch();
+
+do_branchf:
+    // branchf (jump if #f)
+    if (tregs[0] == minim_false) {
+        istream += ioperand(0);
+        dispatch();
+    }
+    next(1);
+
+do_branchgt:
+    // branchgt (jump if greater than)
+    if (((mfixnum) tregs[0]) > ioperand(0)) {
+        istream += ioperand(1);
+        dispatch();
+    }
+    next(2);
+
+do_branchlt:
+    // branchlt (jump if less than)
+    if (((mfixnum) tregs[0]) < ioperand(0)) {
+        istream += ioperand(1);
+        dispatch();
     }
+    next(2);
 
-// move to next instruction
-// bail if the instruction stream is empty
-    istream++;
-    if (*istream == NULL) {
-        minim_error(NULL, "bytecode out of bounds");
+do_branchne:
+    // branchne (jump if not equal)
+    if (((mfixnum) tregs[0]) != ioperand(0)) {
+        istream += ioperand(1);
+        dispatch();
     }
-    goto loop;
+    next(2);
+
+do_make_closure:
+    // make-closure
+    tregs[0] = make_closure(tc, operand(0), ioperand(1));
+    next(2);
+
+do_check_stack:
+    // check stack
+    maybe_grow_stack(tc, ioperand(0));
+    next(1);
+
+do_reserve_frame:
+    // reserve-frame
+    reserve_frame(tc, ioperand(0));
+    next(1);
+
+do_shift_frame:
+    // shift-frame
+    shift_frame(tc, ioperand(0));
+    next(1);
+
+do_stack_ref:
+    // stack-ref
+    tregs[0] = tc_lfp(tc)[ioperand(0)];
+    next(1);
+
+do_stack_set:
+    // stack-set!
+    stack_local_set(tc, ioperand(0), tregs[0]);
+    tregs[0] = minim_void;
+    next(1);
+
+do_stack_bind_values:
+    // stack-bind-values
+    stack_bind_values(tc, ioperand(0), ioperand(1), operand(2), tregs[0]);
+    tregs[0] = minim_void;
+    next(3);
+
+do_prim_cons:
+    // cons (inlined)
+    prim_guard(2);
+    v1 = pop_arg(tc);
+    tregs[0] = Mcons(pop_arg(tc), v1);
+    next(1);
+
+do_prim_car:
+    // car (inlined)
+    prim_guard(1);
+    tregs[0] = minim_car(pop_arg(tc));
+    next(1);
+
+do_prim_cdr:
+    // cdr (inlined)
+    prim_guard(1);
+    tregs[0] = minim_cdr(pop_arg(tc));
+    next(1);
+
+do_prim_eq:
+    // eq? (inlined)
+    prim_guard(2);
+    v1 = pop_arg(tc);
+    tregs[0] = minim_eqp(pop_arg(tc), v1) ? minim_true : minim_false;
+    next(1);
+
+do_prim_nullp:
+    // null? (inlined)
+    prim_guard(1);
+    tregs[0] = minim_nullp(pop_arg(tc)) ? minim_true : minim_false;
+    next(1);
+
+do_prim_pairp:
+    // pair? (inlined)
+    prim_guard(1);
+    v1 = pop_arg(tc);
+    tregs[0] = minim_consp(v1) ? minim_true : minim_false;
+    next(1);
+
+do_prim_not:
+    // not (inlined)
+    prim_guard(1);
+    tregs[0] = minim_falsep(pop_arg(tc)) ? minim_true : minim_false;
+    next(1);
+
+do_prim_fixnump:
+    // fixnum? (inlined)
+    prim_guard(1);
+    tregs[0] = minim_fixnump(pop_arg(tc)) ? minim_true : minim_false;
+    next(1);
+
+do_prim_fx_add:
+    // fx+ (inlined)
+    prim_guard(2);
+    v1 = pop_arg(tc);
+    tregs[0] = fx2_add(pop_arg(tc), v1);
+    next(1);
+
+do_prim_fx_sub:
+    // fx- (inlined)
+    prim_guard(2);
+    v1 = pop_arg(tc);
+    tregs[0] = fx2_sub(pop_arg(tc), v1);
+    next(1);
+
+do_prim_fx_eq:
+    // fx= (inlined)
+    prim_guard(2);
+    v1 = pop_arg(tc);
+    tregs[0] = (minim_fixnum(pop_arg(tc)) == minim_fixnum(v1)) ? minim_true : minim_false;
+    next(1);
+
+do_prim_fx_lt:
+    // fx< (inlined)
+    prim_guard(2);
+    v1 = pop_arg(tc);
+    tregs[0] = (minim_fixnum(pop_arg(tc)) < minim_fixnum(v1)) ? minim_true : minim_false;
+    next(1);
+
+do_prim_fx_gt:
+    // fx> (inlined)
+    prim_guard(2);
+    v1 = pop_arg(tc);
+    tregs[0] = (minim_fixnum(pop_arg(tc)) > minim_fixnum(v1)) ? minim_true : minim_false;
+    next(1);
+
+do_prim_vector_ref:
+    // vector-ref (inlined)
+    prim_guard(2);
+    v1 = pop_arg(tc);
+    tregs[0] = minim_vector_ref(pop_arg(tc), minim_fixnum(v1));
+    next(1);
+
+do_end:
+    // ran off the end of the instruction stream
+    minim_error(NULL, "bytecode out of bounds");
 
 // call closure
 call_closure:
@@ -650,7 +1469,7 @@ call_closure:
     tc_env(tc) = minim_closure_env(tc_cp(tc));
     // don't clear either the current procedure or argument count
     // since this is required for binding and arity check
-    goto loop;
+    dispatch();
 
 // performs `do-raise` instruction
 do_raise:
@@ -669,42 +1488,51 @@ do_raise:
 
 // restores previous continuation
 restore_frame:
-    if (tc_sfp(tc) <= tc_stack_base(tc)) {
+    if (tc_sfp(tc) == tc_stack_base(tc) && !minim_nullp(tc_stack_link(tc))) {
         // we underflowed, so we need to unpack the previous stack
         mobj srecord = tc_stack_link(tc);
-        if (minim_nullp(srecord)) {
-            // no previous stack so we should exit
-            // make sure to pop entry frame
-            tc_env(tc) = penv;
-            return tregs[0];
-        }
-
         tc_stack_base(tc) = cache_stack_base(srecord);
+        GC_write_barrier(tc_stack_base(tc));
         tc_stack_size(tc) = cache_stack_len(srecord);
         tc_stack_link(tc) = cache_stack_prev(srecord);
-        tc_sfp(tc) = tc_stack_base(tc);
-        tc_esp(tc) = tc_sfp(tc) + tc_stack_size(tc) - stack_slop;
+        tc_esp(tc) = ptr_add(tc_stack_base(tc), tc_stack_size(tc) - stack_slop);
+
+        // return point was saved when the stack grew
         cc = cache_stack_ret(srecord);
+        istream = continuation_pc(cc);
+        tc_env(tc) = continuation_env(cc);
+        tc_sfp(tc) = continuation_sfp(cc);
+        tc_cp(tc) = continuation_cp(cc);
+        tc_ac(tc) = continuation_ac(cc);
+        tc_lfp(tc) = continuation_lfp(cc);
     } else {
-        cc = tc_ccont(tc);
+        // pop the frame
+        istream = tc_ra(tc);
+        tc_env(tc) = frame_env(tc_sfp(tc));
+        tc_cp(tc) = frame_cp(tc_sfp(tc));
+        tc_ac(tc) = frame_ac(tc_sfp(tc));
+        tc_lfp(tc) = frame_lfp(tc_sfp(tc));
+        tc_sfp(tc) = frame_prev(tc_sfp(tc));
     }
 
-    // restore instruction stream and environment
-    istream = tc_ra(tc);
-    tc_env(tc) = continuation_env(cc);
+    if (istream == NULL) {
+        // popped the entry frame so we should exit
+        tc_reentry(tc) = preentry;
+        return tregs[0];
+    }
 
-    // update thread parameters
-    tc_ccont(tc) = continuation_prev(cc);
-    tc_sfp(tc) = continuation_sfp(cc);
-    tc_cp(tc) = continuation_cp(cc);
-    tc_ac(tc) = continuation_ac(cc);
-    goto loop;
+    dispatch();
 
 not_procedure:
     minim_error1(NULL, "expected procedure", tc_cp(tc));
 }
 
 mobj eval_expr(mobj tc, mobj expr) {
-    mobj code = compile_expr(expr);
-    return eval_istream(tc, minim_code_it(code));
+    mobj code, result;
+
+    // the interpreter only holds an interior pointer into `code`
+    code = compile_expr(expr);
+    result = eval_istream(tc, minim_code_it(code));
+    GC_REGISTER_LOCAL_ARRAY(code);
+    return result;
 }
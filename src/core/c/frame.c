@@ -2,15 +2,15 @@
 
 #include "../minim.h"
 
-mobj Mcontinuation(mobj prev, mobj pc, mobj env, mobj tc) {
-    mobj o = GC_alloc(continuation_size);
-    minim_type(o) = MINIM_OBJ_CONTINUATION;
-    continuation_prev(o) = prev;
-    continuation_pc(o) = pc;
-    continuation_env(o) = env;
-    continuation_sfp(o) = tc_sfp(tc);
-    continuation_cp(o) = tc_cp(tc);
-    continuation_ac(o) = tc_ac(tc);
+mobj Mcontinuation(mobj *fp) {
+    mobj o = GC_alloc_tagged(continuation_size);
+    minim_heap_type(o) = MINIM_OBJ_CONTINUATION;
+    continuation_pc(o) = frame_ra(fp);
+    continuation_env(o) = frame_env(fp);
+    continuation_sfp(o) = frame_prev(fp);
+    continuation_cp(o) = frame_cp(fp);
+    continuation_ac(o) = frame_ac(fp);
+    continuation_lfp(o) = frame_lfp(fp);
     return o;
 }
 
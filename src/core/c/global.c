@@ -4,8 +4,15 @@
 
 intern_table *symbols;
 mobj *curr_thread_ref;
+mobj inline_procs;
+int jit_dump_ir = 0;        // print the IR before and after L3 optimization
+int jit_inline = 1;         // inline small procedures
+size_t prim_guard_misses;   // inlined primitives that called the operator instead
 
 void init_minim() {
+    // precise marking of heap objects
+    init_tracers();
+
     // interned symbol table
     symbols = make_intern_table();
     GC_register_root(symbols);
@@ -42,6 +49,7 @@ void init_minim() {
     branchlt_symbol = intern("#%branchlt");
     branchne_symbol = intern("#%branchne");
     ccall_symbol = intern("#%ccall");
+    ccallv_symbol = intern("#%ccallv");
     check_stack_symbol = intern("#%check-stack");
     clear_frame_symbol = intern("#%clear-frame");
     closure_ref_symbol = intern("#%closure-ref");
@@ -54,9 +62,12 @@ void init_minim() {
     do_rest_symbol = intern("#%do-rest");
     do_values_symbol = intern("#%do-values");
     do_with_values_symbol = intern("#%do-with-values");
+    entry_symbol = intern("#%entry");
     get_arg_symbol = intern("#%get-arg");
     get_tenv_symbol = intern("#%get-tenv");
     literal_symbol = intern("#%literal");
+    local_ref_symbol = intern("#%local-ref");
+    local_set_symbol = intern("#%local-set!");
     lookup_symbol = intern("#%lookup");
     lookup_cell_symbol = intern("#%lookup-cell");
     tl_bind_values_symbol = intern("#%tl-bind-values");
@@ -70,35 +81,32 @@ void init_minim() {
     push_symbol = intern("#%push");
     push_env_symbol = intern("#%push-env");
     rebind_symbol = intern("#%rebind");
+    reserve_frame_symbol = intern("#%reserve-frame");
     ret_symbol = intern("#%ret");
     save_cc_symbol = intern("#%save-cc");
     set_arg_symbol = intern("#%set-arg");
     set_tenv_symbol = intern("#%set-tenv");
     set_proc_symbol = intern("#%set-proc");
+    shift_frame_symbol = intern("#%shift-frame");
+    stack_bind_values_symbol = intern("#%stack-bind-values");
+    stack_ref_symbol = intern("#%stack-ref");
+    stack_set_symbol = intern("#%stack-set!");
+    prim_cons_symbol = intern("#%cons");
+    prim_car_symbol = intern("#%car");
+    prim_cdr_symbol = intern("#%cdr");
+    prim_eq_symbol = intern("#%eq?");
+    prim_nullp_symbol = intern("#%null?");
+    prim_pairp_symbol = intern("#%pair?");
+    prim_not_symbol = intern("#%not");
+    prim_fixnump_symbol = intern("#%fixnum?");
+    prim_fx_add_symbol = intern("#%fx+");
+    prim_fx_sub_symbol = intern("#%fx-");
+    prim_fx_eq_symbol = intern("#%fx=");
+    prim_fx_lt_symbol = intern("#%fx<");
+    prim_fx_gt_symbol = intern("#%fx>");
+    prim_vector_ref_symbol = intern("#%vector-ref");
 
-    // initialize special values    
-
-    minim_null = GC_alloc(sizeof(mbyte));
-    GC_register_root(minim_null);
-    minim_type(minim_null) = MINIM_OBJ_SPECIAL;
-    minim_true = GC_alloc(sizeof(mbyte));
-    GC_register_root(minim_true);
-    minim_type(minim_true) = MINIM_OBJ_SPECIAL;
-    minim_false = GC_alloc(sizeof(mbyte));
-    GC_register_root(minim_false);
-    minim_type(minim_false) = MINIM_OBJ_SPECIAL;
-    minim_eof = GC_alloc(sizeof(mbyte));
-    GC_register_root(minim_eof);
-    minim_type(minim_eof) = MINIM_OBJ_SPECIAL;
-    minim_void = GC_alloc(sizeof(mbyte));
-    GC_register_root(minim_void);
-    minim_type(minim_void) = MINIM_OBJ_SPECIAL;
-    minim_values = GC_alloc(sizeof(mbyte));
-    GC_register_root(minim_values);
-    minim_type(minim_values) = MINIM_OBJ_SPECIAL;
-    minim_unbound = GC_alloc(sizeof(mbyte));
-    GC_register_root(minim_unbound);
-    minim_type(minim_unbound) = MINIM_OBJ_SPECIAL;
+    // initialize special objects
     minim_empty_vec = Mvector(0, NULL);
     GC_register_root(minim_empty_vec);
 
@@ -112,6 +120,10 @@ void init_minim() {
     record_rtd_sealed(minim_base_rtd) = minim_true;
     record_rtd_protocol(minim_base_rtd) = minim_false;
 
+    // procedures that may be inlined (see `jit_register_inline`)
+    inline_procs = Mhashtable(0);
+    GC_register_root(inline_procs);
+
     init_envs();
 }
 
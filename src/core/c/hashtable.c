@@ -25,15 +25,8 @@ static size_t hash_bytes(const void *data, size_t len, size_t hash0) {
 }
 
 static size_t eq_hash2(mobj o, size_t hash) {
-    switch (minim_type(o))
-    {
-    case MINIM_OBJ_FIXNUM:
-        return hash_bytes(&minim_fixnum(o), sizeof(minim_fixnum(o)), hash);
-    case MINIM_OBJ_CHAR:
-        return hash_bytes(&minim_char(o), sizeof(minim_char(o)), hash);
-    default:
-        return hash_bytes(&o, sizeof(mobj), hash);
-    }
+    // immediates are equal only if they are identical
+    return hash_bytes(&o, sizeof(mobj), hash);
 }
 
 size_t eq_hash(mobj o) {
@@ -53,8 +46,8 @@ mobj Mhashtable(size_t size_hint) {
     alloc_ptr = start_size_ptr;
     for (; *alloc_ptr < size_hint; ++alloc_ptr);
 
-    o = GC_alloc(minim_hashtable_size);
-    minim_type(o) = MINIM_OBJ_HASHTABLE;
+    o = GC_alloc_tagged(minim_hashtable_size);
+    minim_heap_type(o) = MINIM_OBJ_HASHTABLE;
     minim_hashtable_alloc_ptr(o) = alloc_ptr;
     minim_hashtable_buckets(o) = Mvector(minim_hashtable_alloc(o), minim_null);
     minim_hashtable_count(o) = 0;
@@ -62,18 +55,19 @@ mobj Mhashtable(size_t size_hint) {
 }
 
 static mobj hashtable_copy2(mobj ht) {
-    mobj o, hd, tl, b;
+    mobj o, nb, hd, tl, b;
     
-    o = GC_alloc(minim_hashtable_size);
-    minim_type(o) = MINIM_OBJ_HASHTABLE;
+    o = GC_alloc_tagged(minim_hashtable_size);
+    nb = Mvector(minim_hashtable_alloc(ht), NULL);
+    minim_heap_type(o) = MINIM_OBJ_HASHTABLE;
     minim_hashtable_alloc_ptr(o) = minim_hashtable_alloc_ptr(ht);
-    minim_hashtable_buckets(o) = Mvector(minim_hashtable_alloc(o), NULL);
+    minim_hashtable_buckets(o) = nb;
     minim_hashtable_count(o) = minim_hashtable_count(ht);
 
     for (long i = 0; i < minim_hashtable_alloc(o); i++) {
         b = minim_hashtable_bucket(ht, i);
         if (minim_nullp(b)) {
-            minim_hashtable_bucket(o, i) = minim_null;
+            minim_vector_ref(nb, i) = minim_null;
         } else {
             hd = tl = Mcons(Mcons(minim_caar(b), minim_cdar(b)), NULL);
             for (b = minim_cdr(b); !minim_nullp(b); b = minim_cdr(b)) {
@@ -82,7 +76,7 @@ static mobj hashtable_copy2(mobj ht) {
             }
 
             minim_cdr(tl) = minim_null;
-            minim_hashtable_bucket(o, i) = hd;
+            minim_vector_ref(nb, i) = hd;
         }
     }
 
@@ -127,6 +121,7 @@ static void eq_hashtable_resize(mobj ht) {
 
     minim_hashtable_alloc_ptr(ht) = alloc_ptr;
     minim_hashtable_buckets(ht) = nb;
+    minim_write_barrier(ht, nb);
 }
 
 void eq_hashtable_set(mobj ht, mobj k, mobj v) {
@@ -138,17 +133,44 @@ void eq_hashtable_set(mobj ht, mobj k, mobj v) {
     for (bi = b; !minim_nullp(bi); bi = minim_cdr(bi)) {
         if (minim_eqp(minim_caar(bi), k)) {
             minim_cdar(bi) = v;
+            minim_write_barrier(minim_car(bi), v);
             return;
         }
     }
 
-    minim_hashtable_bucket(ht, i) = Mcons(Mcons(k, v), b);
+    b = Mcons(Mcons(k, v), b);
+    minim_hashtable_bucket(ht, i) = b;
+    minim_write_barrier(minim_hashtable_buckets(ht), b);
     minim_hashtable_count(ht)++;
     if (minim_hashtable_count(ht) > minim_hashtable_alloc(ht)) {
         eq_hashtable_resize(ht);
     }
 }
 
+void eq_hashtable_delete(mobj ht, mobj k) {
+    mobj b, prev;
+    size_t i;
+
+    i = eq_hash(k) % minim_hashtable_alloc(ht);
+    prev = minim_null;
+    for (b = minim_hashtable_bucket(ht, i); !minim_nullp(b); b = minim_cdr(b)) {
+        if (minim_eqp(minim_caar(b), k)) {
+            if (minim_nullp(prev)) {
+                minim_hashtable_bucket(ht, i) = minim_cdr(b);
+                minim_write_barrier(minim_hashtable_buckets(ht), minim_cdr(b));
+            } else {
+                minim_cdr(prev) = minim_cdr(b);
+                minim_write_barrier(prev, minim_cdr(b));
+            }
+
+            minim_hashtable_count(ht)--;
+            return;
+        }
+
+        prev = b;
+    }
+}
+
 //
 //  Primitives
 //
@@ -194,6 +216,7 @@ mobj hashtable_set(mobj ht, mobj h, mobj cells) {
     // (-> hashtable integer (listof cons) void)
     size_t i = minim_fixnum(h) % minim_hashtable_alloc(ht);
     minim_hashtable_bucket(ht, i) = cells;
+    minim_write_barrier(minim_hashtable_buckets(ht), cells);
     return minim_void;
 }
 
@@ -223,6 +246,7 @@ mobj hashtable_clear(mobj ht) {
     // (-> hashtable void)
     minim_hashtable_alloc_ptr(ht) = start_size_ptr;
     minim_hashtable_buckets(ht) = Mvector(minim_hashtable_alloc(ht), minim_null);
+    GC_write_barrier(ht);
     minim_hashtable_count(ht) = 0;
     return minim_void;
 }
@@ -18,8 +18,8 @@ static void gc_port_dtor(void *ptr, void *data) {
 }
 
 mobj Minput_port(FILE *stream) {
-    mobj o = GC_alloc(minim_port_size);
-    minim_type(o) = MINIM_OBJ_PORT;
+    mobj o = GC_alloc_tagged(minim_port_size);
+    minim_heap_type(o) = MINIM_OBJ_PORT;
     minim_port_flags(o) = PORT_FLAG_READ;
     minim_port(o) = stream;
     GC_register_dtor(o, gc_port_dtor);
@@ -27,8 +27,8 @@ mobj Minput_port(FILE *stream) {
 }
 
 mobj Moutput_port(FILE *stream) {
-    mobj o = GC_alloc(minim_port_size);
-    minim_type(o) = MINIM_OBJ_PORT;
+    mobj o = GC_alloc_tagged(minim_port_size);
+    minim_heap_type(o) = MINIM_OBJ_PORT;
     minim_port_flags(o) = 0x0;
     minim_port(o) = stream;
     GC_register_dtor(o, gc_port_dtor);
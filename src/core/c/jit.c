@@ -7,68 +7,224 @@
 //
 
 mobj Mcode(size_t size) {
-    mobj o = GC_alloc(minim_code_size(size));
-    minim_type(o) = MINIM_OBJ_CODE;
+    mobj o = GC_alloc_tagged(minim_code_size(size));
+    minim_heap_type(o) = MINIM_OBJ_CODE;
     minim_code_len(o) = size;
+    minim_code_native(o) = NULL;
+    minim_code_calls(o) = 0;
     return o;
 }
 
+//
+//  Instruction encoding
+//
+//  Operands are stored unboxed whenever possible:
+//    'o' - object
+//    'i' - integer (fixnum, register index, etc.)
+//    'p' - C function pointer
+//    'l' - branch target as a word offset from the instruction
+//    'c' - word offset of the instruction from the start of the code
+//    'k' - cache of a top-level reference (not in the instruction list)
+//
+
+typedef struct {
+    mobj *name;             // instruction name
+    const char *operands;   // operand kinds
+} opcode_info;
+
+static opcode_info opcodes[opcode_count] = {
+    [OP_END] =              { NULL, "" },
+    [OP_ENTRY] =            { &entry_symbol, "pc" },
+    [OP_LITERAL] =          { &literal_symbol, "o" },
+    [OP_LOOKUP] =           { &lookup_symbol, "i" },
+    [OP_LOOKUP_CELL] =      { &lookup_cell_symbol, "i" },
+    [OP_LOCAL_REF] =        { &local_ref_symbol, "i" },
+    [OP_LOCAL_SET] =        { &local_set_symbol, "i" },
+    [OP_TL_LOOKUP] =        { &tl_lookup_symbol, "ok" },
+    [OP_TL_LOOKUP_CELL] =   { &tl_lookup_cell_symbol, "ok" },
+    [OP_SET_PROC] =         { &set_proc_symbol, "" },
+    [OP_PUSH] =             { &push_symbol, "" },
+    [OP_POP] =              { &pop_symbol, "" },
+    [OP_MOV] =              { &mov_symbol, "ii" },
+    [OP_CLOSURE_REF] =      { &closure_ref_symbol, "ii" },
+    [OP_CLOSURE_SET] =      { &closure_set_symbol, "iii" },
+    [OP_CLOSURE_BIND] =     { &closure_bind_symbol, "i" },
+    [OP_APPLY] =            { &apply_symbol, "" },
+    [OP_RET] =              { &ret_symbol, "" },
+    [OP_CCALL] =            { &ccall_symbol, "p" },
+    [OP_CCALLV] =           { &ccallv_symbol, "p" },
+    [OP_BIND] =             { &bind_symbol, "io" },
+    [OP_BIND_CELL] =        { &bind_cell_symbol, "i" },
+    [OP_BIND_VALUES] =      { &bind_values_symbol, "iio" },
+    [OP_TL_BIND_VALUES] =   { &tl_bind_values_symbol, "io" },
+    [OP_REBIND] =           { &rebind_symbol, "i" },
+    [OP_TL_REBIND] =        { &tl_rebind_symbol, "ok" },
+    [OP_PUSH_ENV] =         { &push_env_symbol, "i" },
+    [OP_SAVE_CC] =          { &save_cc_symbol, "l" },
+    [OP_GET_ARG] =          { &get_arg_symbol, "ii" },
+    [OP_SET_ARG] =          { &set_arg_symbol, "ii" },
+    [OP_GET_TENV] =         { &get_tenv_symbol, "i" },
+    [OP_SET_TENV] =         { &set_tenv_symbol, "i" },
+    [OP_DO_APPLY] =         { &do_apply_symbol, "" },
+    [OP_DO_ARITY_ERROR] =   { &do_arity_error_symbol, "" },
+    [OP_DO_EVAL] =          { &do_eval_symbol, "" },
+    [OP_DO_RAISE] =         { &do_raise_symbol, "" },
+    [OP_DO_REST] =          { &do_rest_symbol, "i" },
+    [OP_DO_VALUES] =        { &do_values_symbol, "i" },
+    [OP_DO_WITH_VALUES] =   { &do_with_values_symbol, "" },
+    [OP_CLEAR_FRAME] =      { &clear_frame_symbol, "i" },
+    [OP_BRANCHA] =          { &brancha_symbol, "l" },
+    [OP_BRANCHF] =          { &branchf_symbol, "l" },
+    [OP_BRANCHGT] =         { &branchgt_symbol, "il" },
+    [OP_BRANCHLT] =         { &branchlt_symbol, "il" },
+    [OP_BRANCHNE] =         { &branchne_symbol, "il" },
+    [OP_MAKE_CLOSURE] =     { &make_closure_symbol, "oi" },
+    [OP_CHECK_STACK] =      { &check_stack_symbol, "i" },
+    [OP_RESERVE_FRAME] =    { &reserve_frame_symbol, "i" },
+    [OP_SHIFT_FRAME] =      { &shift_frame_symbol, "i" },
+    [OP_STACK_REF] =        { &stack_ref_symbol, "i" },
+    [OP_STACK_SET] =        { &stack_set_symbol, "i" },
+    [OP_STACK_BIND_VALUES] = { &stack_bind_values_symbol, "iio" },
+    [OP_PRIM_CONS] =        { &prim_cons_symbol, "o" },
+    [OP_PRIM_CAR] =         { &prim_car_symbol, "o" },
+    [OP_PRIM_CDR] =         { &prim_cdr_symbol, "o" },
+    [OP_PRIM_EQ] =          { &prim_eq_symbol, "o" },
+    [OP_PRIM_NULLP] =       { &prim_nullp_symbol, "o" },
+    [OP_PRIM_PAIRP] =       { &prim_pairp_symbol, "o" },
+    [OP_PRIM_NOT] =         { &prim_not_symbol, "o" },
+    [OP_PRIM_FIXNUMP] =     { &prim_fixnump_symbol, "o" },
+    [OP_PRIM_FX_ADD] =      { &prim_fx_add_symbol, "o" },
+    [OP_PRIM_FX_SUB] =      { &prim_fx_sub_symbol, "o" },
+    [OP_PRIM_FX_EQ] =       { &prim_fx_eq_symbol, "o" },
+    [OP_PRIM_FX_LT] =       { &prim_fx_lt_symbol, "o" },
+    [OP_PRIM_FX_GT] =       { &prim_fx_gt_symbol, "o" },
+    [OP_PRIM_VECTOR_REF] =  { &prim_vector_ref_symbol, "o" },
+};
+
+size_t opcode_operands(opcode_type op) {
+    return strlen(opcodes[op].operands);
+}
+
+char opcode_operand_kind(opcode_type op, size_t i) {
+    return opcodes[op].operands[i];
+}
+
+static opcode_type instr_opcode(mobj in) {
+    for (size_t op = OP_END + 1; op < opcode_count; op++) {
+        if (minim_car(in) == *opcodes[op].name)
+            return op;
+    }
+
+    minim_error1("write_code", "invalid bytecode", in);
+}
+
 mobj code_to_instrs(mobj code) {
     mobj ins, reloc, inv_reloc, *istream;
-    size_t i;
+    opcode_type op;
+    size_t i, argc;
 
-    // build inverse reloc table
-    inv_reloc = minim_null;
+    // build inverse reloc table: offset to label
+    inv_reloc = Mhashtable(0);
     reloc = minim_code_reloc(code);
     for (; !minim_nullp(reloc); reloc = minim_cdr(reloc)) {
-        inv_reloc = assq_set(inv_reloc, minim_cdar(reloc), minim_caar(reloc));
+        eq_hashtable_set(inv_reloc, minim_cdar(reloc), minim_caar(reloc));
     }
 
-    // build instruction sequence
+    // decode instruction sequence
     ins = minim_null;
     istream = minim_code_it(code);
-    for (i = 0; i < minim_code_len(code); i++) {
-        mobj ref, in;
+    for (i = 0; i < minim_code_len(code); i += 1 + argc) {
+        mobj ref, in, x;
 
         // restore label
-        ref = assq_ref(inv_reloc, Mfixnum((intptr_t) &istream[i]));
+        ref = eq_hashtable_find(inv_reloc, Mfixnum(i));
         if (!minim_falsep(ref)) {
             ins = Mcons(minim_cdr(ref), ins);
         }
-        
-        // possibly replace jumps
-        in = istream[i];
-        if (minim_car(in) == brancha_symbol) {
-            // brancha
-            ref = assq_ref(inv_reloc, minim_cadr(in));
-            in = Mlist2(brancha_symbol, minim_cdr(ref));
-        } else if (minim_car(in) == branchf_symbol) {
-            // branchf
-            ref = assq_ref(inv_reloc, minim_cadr(in));
-            in = Mlist2(branchf_symbol, minim_cdr(ref));
-        } else if (minim_car(in) == branchgt_symbol) {
-            // branchgt
-            ref = assq_ref(inv_reloc, minim_car(minim_cddr(in)));
-            in = Mlist3(branchgt_symbol, minim_cadr(in), minim_cdr(ref));
-        } else if (minim_car(in) == branchlt_symbol) {
-            // branchlt
-            ref = assq_ref(inv_reloc, minim_car(minim_cddr(in)));
-            in = Mlist3(branchlt_symbol, minim_cadr(in), minim_cdr(ref));
-        } else if (minim_car(in) == branchne_symbol) {
-            // branchne
-            ref = assq_ref(inv_reloc, minim_car(minim_cddr(in)));
-            in = Mlist3(branchne_symbol, minim_cadr(in), minim_cdr(ref));
-        } else if (minim_car(in) == save_cc_symbol) {
-            // save-cc
-            in = Mlist2(save_cc_symbol, minim_cdr(assq_ref(inv_reloc, minim_cadr(in))));
+
+        // restore instruction (boxing operands and restoring labels)
+        op = (opcode_type) (uintptr_t) istream[i];
+        argc = opcode_operands(op);
+        in = minim_null;
+        for (size_t j = 0; j < argc; j++) {
+            x = istream[i + 1 + j];
+            switch (opcodes[op].operands[j]) {
+            case 'i':
+            case 'p':
+            case 'c':
+                x = Mfixnum((mfixnum) x);
+                break;
+            case 'l':
+                x = minim_cdr(eq_hashtable_find(inv_reloc, Mfixnum(i + (mfixnum) x)));
+                break;
+            case 'k':
+                continue;
+            }
+
+            in = Mcons(x, in);
         }
-    
-        ins = Mcons(in, ins);
+
+        ins = Mcons(Mcons(*opcodes[op].name, list_reverse(in)), ins);
     }
 
     return list_reverse(ins);
 }
 
+// Native code may be entered at the start of the code,
+// wherever a continuation returns, and at the head of a loop
+// (the target of a backwards jump), so an `entry` instruction
+// is placed before each of these locations. Entries at loop heads
+// also count iterations so that a long-running loop becomes hot.
+static mobj add_entries(mobj ins, mobj *reloc) {
+    mobj hd, tl, targets, labels, entries;
+
+    // find return points and loop heads
+    targets = Mhashtable(0);
+    labels = Mhashtable(0);
+    for (mobj it = ins; !minim_nullp(it); it = minim_cdr(it)) {
+        mobj in = minim_car(it);
+        if (minim_stringp(in)) {
+            eq_hashtable_set(labels, in, minim_true);
+        } else if (minim_car(in) == save_cc_symbol) {
+            eq_hashtable_set(targets, minim_cadr(in), minim_true);
+        } else if (minim_car(in) == brancha_symbol && !minim_falsep(eq_hashtable_find(labels, minim_cadr(in)))) {
+            eq_hashtable_set(targets, minim_cadr(in), minim_true);
+        }
+    }
+
+    entries = Mhashtable(0);
+    hd = tl = Mcons(Mlist3(entry_symbol, Mfixnum(0), Mfixnum(0)), minim_null);
+    for (; !minim_nullp(ins); ins = minim_cdr(ins)) {
+        mobj in = minim_car(ins);
+        minim_cdr(tl) = Mcons(in, minim_null);
+        tl = minim_cdr(tl);
+
+        if (minim_stringp(in) && !minim_falsep(eq_hashtable_find(targets, in))) {
+            // return point: the label now refers to the entry
+            mobj entry = Mlist3(entry_symbol, Mfixnum(0), Mfixnum(0));
+            eq_hashtable_set(entries, in, entry);
+            for (; !minim_nullp(minim_cdr(ins)) && minim_stringp(minim_cadr(ins)); ins = minim_cdr(ins)) {
+                minim_cdr(tl) = Mcons(minim_cadr(ins), minim_null);
+                tl = minim_cdr(tl);
+            }
+
+            minim_cdr(tl) = Mcons(entry, minim_null);
+            tl = minim_cdr(tl);
+        }
+    }
+
+    // update the reloc table
+    for (mobj it = *reloc; !minim_nullp(it); it = minim_cdr(it)) {
+        mobj entry = eq_hashtable_find(entries, minim_caar(it));
+        if (!minim_falsep(entry)) {
+            minim_car(it) = Mcons(minim_caar(it), minim_cdr(entry));
+            GC_write_barrier(it);
+        }
+    }
+
+    return hd;
+}
+
 static mobj remove_labels(mobj ins) {
     mobj hd, tl;
 
@@ -84,65 +240,105 @@ static mobj remove_labels(mobj ins) {
 }
 
 mobj write_code(mobj ins, mobj reloc, mobj arity) {
-    mobj code, *istream;
-    size_t i;
+    mobj code, it, offsets, labels, *istream;
+    opcode_type *ops;
+    size_t i, n, len;
 
-    // remove labels
+    // add native code entry points and remove labels
+    ins = add_entries(ins, &reloc);
     ins = remove_labels(ins);
 
+    // decode opcodes and compute the length of the instruction stream
+    n = list_length(ins);
+    ops = GC_alloc_atomic(n * sizeof(opcode_type));
+    len = 0;
+    for (i = 0, it = ins; i < n; i++, it = minim_cdr(it)) {
+        ops[i] = instr_opcode(minim_car(it));
+        len += 1 + opcode_operands(ops[i]);
+    }
+
     // allocate code object and fill header
-    code = Mcode(list_length(ins));
+    code = Mcode(len);
     minim_code_reloc(code) = minim_null;
     minim_code_arity(code) = arity;
     istream = minim_code_it(code);
 
-    // need to recompute the reloc table for in-code addresses
+    // need to recompute the reloc table for in-code offsets:
+    // find the offset of each instruction that is a jump target
+    offsets = Mhashtable(0);
+    for (it = reloc; !minim_nullp(it); it = minim_cdr(it))
+        eq_hashtable_set(offsets, minim_cdar(it), minim_false);
+
+    len = 0;
+    for (i = 0, it = ins; i < n; i++, it = minim_cdr(it)) {
+        mobj cell = eq_hashtable_find(offsets, minim_car(it));
+        if (!minim_falsep(cell))
+            minim_cdr(cell) = Mfixnum(len);
+        len += 1 + opcode_operands(ops[i]);
+    }
+
+    // then map each label to the offset of its target
+    labels = Mhashtable(0);
     for (; !minim_nullp(reloc); reloc = minim_cdr(reloc)) {
-        mobj it = ins;
-        for (i = 0; i < minim_code_len(code); i++) {
-            if (minim_car(it) == minim_cdar(reloc)) {
-                mobj cell = Mcons(minim_caar(reloc), Mfixnum((intptr_t) &istream[i]));
-                minim_code_reloc(code) = Mcons(cell, minim_code_reloc(code)); 
-                break;
-            }
-    
-            it = minim_cdr(it);
+        mobj offset = minim_cdr(eq_hashtable_find(offsets, minim_cdar(reloc)));
+        if (!minim_falsep(offset)) {
+            mobj cell = Mcons(minim_caar(reloc), offset);
+            minim_code_reloc(code) = Mcons(cell, minim_code_reloc(code));
+            eq_hashtable_set(labels, minim_caar(reloc), offset);
         }
     }
 
-    reloc = list_reverse(minim_code_reloc(code));
-    minim_code_reloc(code) = reloc;
+    minim_code_reloc(code) = list_reverse(minim_code_reloc(code));
 
-    // write instructions
-    for (i = 0; i < minim_code_len(code); i++) {
-        mobj in = minim_car(ins);
-        if (minim_car(in) == brancha_symbol) {
-            // brancha
-            in = Mlist2(brancha_symbol, minim_cdr(assq_ref(reloc, minim_cadr(in))));
-        } else if (minim_car(in) == branchf_symbol) {
-            // branchf
-            in = Mlist2(branchf_symbol, minim_cdr(assq_ref(reloc, minim_cadr(in))));
-        } else if (minim_car(in) == branchgt_symbol) {
-            // branchgt
-            in = Mlist3(branchgt_symbol, minim_cadr(in), minim_cdr(assq_ref(reloc, minim_car(minim_cddr(in)))));
-        } else if (minim_car(in) == branchlt_symbol) {
-            // branchlt
-            in = Mlist3(branchlt_symbol, minim_cadr(in), minim_cdr(assq_ref(reloc, minim_car(minim_cddr(in)))));
-        } else if (minim_car(in) == branchne_symbol) {
-            // branchne
-            in = Mlist3(branchne_symbol, minim_cadr(in), minim_cdr(assq_ref(reloc, minim_car(minim_cddr(in)))));
-        } else if (minim_car(in) == save_cc_symbol) {
-            // save-cc
-            in = Mlist2(save_cc_symbol, minim_cdr(assq_ref(reloc, minim_cadr(in))));
+    // write instructions: opcode followed by its operands
+    len = 0;
+    for (i = 0, it = ins; i < n; i++, it = minim_cdr(it)) {
+        const char *kinds;
+        mobj in, args, x;
+        size_t start;
+        
+        in = minim_car(it);
+        start = len;
+        istream[len++] = (mobj) (uintptr_t) ops[i];
+        args = minim_cdr(in);
+        for (kinds = opcodes[ops[i]].operands; *kinds; kinds++) {
+            if (*kinds == 'k') {
+                // empty cache: (<environment> . <cell>)
+                istream[len++] = Mcons(minim_false, minim_false);
+                continue;
+            }
+
+            if (!minim_consp(args))
+                minim_error1("write_code", "malformed instruction", in);
+
+            x = minim_car(args);
+            switch (*kinds) {
+            case 'i':
+            case 'p':
+                // unboxed
+                x = (mobj) minim_fixnum(x);
+                break;
+            case 'l':
+                // jump target: replace label with relative offset
+                x = minim_cdr(eq_hashtable_find(labels, x));
+                x = (mobj) (minim_fixnum(x) - (mfixnum) start);
+                break;
+            case 'c':
+                // offset from start of code
+                x = (mobj) start;
+                break;
+            }
+
+            istream[len++] = x;
+            args = minim_cdr(args);
         }
 
-        // add instruction
-        istream[i] = in;
-        ins = minim_cdr(ins);
+        if (!minim_nullp(args))
+            minim_error1("write_code", "malformed instruction", in);
     }
 
-    // NULL terminator
-    istream[i] = NULL;
+    // terminator
+    istream[len] = (mobj) (uintptr_t) OP_END;
     return code;
 }
 
@@ -152,39 +348,64 @@ mobj write_code(mobj ins, mobj reloc, mobj arity) {
 
 mobj compile_expr(mobj expr) {
     mobj global_env, proc_env, scope_env;
-    mobj fv_table, bound_table;
-    mobj L1, L2, L3;
-    mobj bound, ins, reloc;
+    mobj fv_table, mut_table, cap_table, known_table, loop_table;
+    mobj L1, L2, L3, L4;
+    mobj ins, reloc;
 
     // optimization passes
     L1 = jit_opt_L0(expr);
     L2 = jit_opt_L1(L1);
     L3 = jit_opt_L2(L2);
+    L4 = jit_opt_L3(L3);
+    if (jit_dump_ir) {
+        fprintf(stderr, ";; before L3\n");
+        writeln_object(stderr, L3);
+        fprintf(stderr, ";; after L3\n");
+        writeln_object(stderr, L4);
+    }
 
     // prepare initial compiler environments
     global_env = make_global_cenv();
     proc_env = make_cenv(global_env);
     scope_env = make_scope_cenv(proc_env);
 
-    // compute free variables
-    fv_table = Mbox(minim_null);
-    jit_free_vars(L3, fv_table);
-    global_cenv_set_fvs(global_env, minim_unbox(fv_table));
+    // compute procedures that do not escape and need no closure
+    loop_table = Mhashtable(0);
+    jit_analyze_escape(L4, loop_table);
+    global_cenv_set_loops(global_env, loop_table);
+
+    // compute free, mutated, and captured variables
+    fv_table = Mhashtable(0);
+    mut_table = Mhashtable(0);
+    cap_table = Mhashtable(0);
+    jit_analyze_vars(L4, fv_table, mut_table, cap_table, loop_table);
+    global_cenv_set_fvs(global_env, fv_table);
+    global_cenv_set_mutated(global_env, mut_table);
+    global_cenv_set_captured(global_env, cap_table);
 
-    // compute bound variables
-    bound_table = Mbox(minim_null);
-    bound = jit_bound_vars(L3, bound_table);
-    global_cenv_set_bound(global_env, minim_unbox(bound_table));
+    // compute procedures known to be bound to a variable
+    known_table = Mhashtable(0);
+    jit_known_procs(L4, known_table);
+    global_cenv_set_known(global_env, known_table);
 
     // compile
-    ins = compile_expr2(L3, scope_env, 1);
-    if (!minim_nullp(bound)) {
-        // any top-level let expression needs a temporary environment
-        ins = Mcons(Mlist2(push_env_symbol, Mfixnum(list_length(bound))), ins);
+    ins = compile_expr2(L4, scope_env, 1);
+    cenv_patch_frame_size(proc_env, ins);
+    if (cenv_frame_size(proc_env) > 0) {
+        // any top-level let expression may need stack slots
+        ins = Mcons(Mlist2(reserve_frame_symbol, Mfixnum(cenv_frame_size(proc_env))), ins);
+    }
+
+    if (cenv_env_size(proc_env) > 0) {
+        // or a temporary environment
+        ins = Mcons(Mlist2(push_env_symbol, Mfixnum(cenv_env_size(proc_env))), ins);
     }
 
     reloc = resolve_refs(proc_env, ins);
     return write_code(ins, reloc, Mfixnum(0));
 }
 
-
+void jit_print_stats(FILE *out) {
+    fprintf(out, ";; inlined primitives: %zu guard misses\n", prim_guard_misses);
+    jit_analyze_print_stats(out);
+}
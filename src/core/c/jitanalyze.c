@@ -2,110 +2,188 @@
 
 #include "../minim.h"
 
-static mobj free_vars(mobj expr, mobj table);
-static mobj bound_vars(mobj expr, mobj table);
-
 //
-//  Free variable analysis
+//  Scopes
+//  Variables are resolved by name to their binding site: the
+//  `case-lambda` clause or `mv-let` that binds them. A scope maps
+//  each variable to its binders, innermost first, where a binder
+//  is `(<site> . <depth>)` and `<depth>` is the number of procedures
+//  enclosing the site. A variable without a binder is top-level.
 //
 
-static mobj formals_to_ids(mobj formals) {
-    mobj ids = minim_null;
-    for (; minim_consp(formals); formals = minim_cdr(formals)) {
-        ids = Mcons(minim_car(formals), ids);
+static void scope_bind1(mobj scope, mobj id, mobj binder) {
+    mobj cell = eq_hashtable_find(scope, id);
+    if (minim_falsep(cell)) {
+        eq_hashtable_set(scope, id, Mlist1(binder));
+    } else {
+        minim_cdr(cell) = Mcons(binder, minim_cdr(cell));
+        GC_write_barrier(cell);
     }
+}
 
+static void scope_bind(mobj scope, mobj formals, mobj site, size_t depth) {
+    mobj binder = Mcons(site, Mfixnum(depth));
+    for (; minim_consp(formals); formals = minim_cdr(formals))
+        scope_bind1(scope, minim_car(formals), binder);
     if (!minim_nullp(formals))
-        ids = Mcons(formals, ids);
-
-    return list_reverse(ids);
+        scope_bind1(scope, formals, binder);
 }
 
-static mobj merge_free_vars(mobj xs1, mobj xs2) {
-    mobj fvs = xs2;
+static void scope_unbind1(mobj scope, mobj id) {
+    mobj cell = eq_hashtable_find(scope, id);
+    minim_cdr(cell) = minim_cddr(cell);
+}
 
-    for (; !minim_nullp(xs1); xs1 = minim_cdr(xs1)) {
-        if (minim_falsep(memq(xs2, minim_car(xs1))))
-            fvs = Mcons(minim_car(xs1), fvs);
-    }
+static void scope_unbind(mobj scope, mobj formals) {
+    for (; minim_consp(formals); formals = minim_cdr(formals))
+        scope_unbind1(scope, minim_car(formals));
+    if (!minim_nullp(formals))
+        scope_unbind1(scope, formals);
+}
 
-    return fvs;
+// Returns the innermost binder of `id` (or `#f`).
+static mobj scope_lookup(mobj scope, mobj id) {
+    mobj cell = eq_hashtable_find(scope, id);
+    if (minim_falsep(cell) || minim_nullp(minim_cdr(cell)))
+        return minim_false;
+    return minim_cadr(cell);
 }
 
-static mobj remove_free_vars(mobj ks, mobj fvs) {
-    mobj fvs2;
-    
-    fvs2 = minim_null;
-    for (; !minim_nullp(fvs); fvs = minim_cdr(fvs)) {
-        if (minim_falsep(memq(ks, minim_car(fvs))))
-            fvs2 = Mcons(minim_car(fvs), fvs2);
-    }
+//
+//  Variable analysis
+//  A single pass computes, for each procedure, its free variables
+//  and, for each binding site, the bound variables that are mutated
+//  and those that are captured by a nested procedure.
+//
+//  Variables that are never the target of `set!` can be stored
+//  directly in the environment and copied by value into closures.
+//  Variables that are neither mutated nor free in any nested
+//  procedure can be stored in the stack frame of the procedure.
+//
+//  Each reference is resolved to its binder, and the variable is
+//  added to the free variables of every procedure between the two.
+//  Procedures compiled as loops (see `jit_analyze_escape`) are not
+//  counted: their body is part of the enclosing procedure.
+//  This stops at the first procedure that already has it: all
+//  references to a variable from within a procedure resolve to the
+//  same binder, so it was added to the remaining ones as well.
+//  Thus, the analysis is linear in the size of the expression
+//  and of its results.
+//
 
-    return fvs2;
+typedef struct {
+    mobj scope;         // binders of each variable (see above)
+    mobj procs;         // enclosing procedures, innermost first
+    size_t depth;       // number of enclosing procedures
+    mobj fvs;           // procedure to its free variables
+    mobj mutated;       // binding site to its mutated variables
+    mobj captured;      // binding site to its captured variables
+    mobj loops;         // procedures compiled as loops
+} var_analysis;
+
+// An enclosing procedure: `#(<expr> <free variables> <set>)`
+#define proc_length         3
+#define proc_expr(p)        (minim_vector_ref(p, 0))
+#define proc_fvs(p)         (minim_vector_ref(p, 1))
+#define proc_fv_set(p)      (minim_vector_ref(p, 2))
+
+static void analyze_expr(var_analysis *a, mobj expr);
+
+// Adds `id` to the free variables of a procedure unless
+// it is already there. Returns true if it was added.
+static int proc_add_fv(mobj proc, mobj id) {
+    if (!minim_falsep(eq_hashtable_find(proc_fv_set(proc), id)))
+        return 0;
+
+    eq_hashtable_set(proc_fv_set(proc), id, minim_true);
+    proc_fvs(proc) = Mcons(id, proc_fvs(proc));
+    GC_write_barrier(proc);
+    return 1;
 }
 
-static mobj define_values_free_vars(mobj e, mobj table) {
-    return remove_free_vars(
-        minim_cadr(e),
-        free_vars(minim_car(minim_cddr(e)), table)
-    );
+// Records `id` as one of the variables bound at `site`.
+static void record_site_var(mobj table, mobj site, mobj id) {
+    mobj cell = eq_hashtable_find(table, site);
+    if (minim_falsep(cell)) {
+        eq_hashtable_set(table, site, Mlist1(id));
+    } else if (minim_falsep(memq(minim_cdr(cell), id))) {
+        minim_cdr(cell) = Mcons(id, minim_cdr(cell));
+        GC_write_barrier(cell);
+    }
 }
 
-static mobj lambda_free_vars(mobj e, mobj table) {
-    mobj fvs, ids, seq;
-    
-    ids = formals_to_ids(minim_cadr(e));
-    seq = Mcons(begin_symbol, minim_cddr(e));
-    fvs = remove_free_vars(ids, free_vars(seq, table));
+static void analyze_ref(var_analysis *a, mobj id, int setp) {
+    mobj binder, procs;
+    size_t depth;
 
-    if (!minim_nullp(fvs))
-        minim_unbox(table) = Mcons(Mcons(e, fvs), minim_unbox(table));
-    return fvs;
-}
+    binder = scope_lookup(a->scope, id);
+    depth = minim_falsep(binder) ? 0 : minim_fixnum(minim_cdr(binder));
 
-static mobj case_lambda_free_vars(mobj e, mobj table) {
-    mobj fvs, fvs2, ids, seq;
-    
-    fvs = minim_null;
-    for (mobj clauses = minim_cdr(e); !minim_nullp(clauses); clauses = minim_cdr(clauses)) {
-        ids = formals_to_ids(minim_caar(clauses));
-        seq = Mcons(begin_symbol, minim_cdar(clauses));
-        fvs2 = remove_free_vars(ids, free_vars(seq, table));
-        fvs = merge_free_vars(fvs2, fvs);
+    // free in every procedure between the reference and the binder
+    procs = a->procs;
+    for (size_t d = a->depth; d > depth; d--, procs = minim_cdr(procs)) {
+        if (!proc_add_fv(minim_car(procs), id))
+            break;
     }
 
-    if (!minim_nullp(fvs))
-        minim_unbox(table) = Mcons(Mcons(e, fvs), minim_unbox(table));
-    return fvs;
+    if (!minim_falsep(binder)) {
+        if (setp)
+            record_site_var(a->mutated, minim_car(binder), id);
+        if (a->depth > depth)
+            record_site_var(a->captured, minim_car(binder), id);
+    }
 }
 
-static mobj mvlet_free_vars(mobj e, mobj table) {
-    return merge_free_vars(
-        remove_free_vars(
-            minim_car(minim_cddr(e)),
-            free_vars(minim_cadr(minim_cddr(e)), table)
-        ),
-        free_vars(minim_cadr(e), table)
-    );
+static void analyze_seq(var_analysis *a, mobj es) {
+    for (; !minim_nullp(es); es = minim_cdr(es))
+        analyze_expr(a, minim_car(es));
 }
 
-static mobj begin_free_vars(mobj e, mobj table) {
-    mobj fvs;
-    
-    fvs = minim_null;
-    for (e = minim_cdr(e); !minim_nullp(e); e = minim_cdr(e))
-        fvs = merge_free_vars(free_vars(minim_car(e), table), fvs);
-    return fvs;
+// The binding site of a clause is the clause itself
+// (for `lambda`, the clause is shared with `compile_lambda`).
+static void analyze_clause(var_analysis *a, mobj clause) {
+    scope_bind(a->scope, minim_car(clause), clause, a->depth);
+    analyze_seq(a, minim_cdr(clause));
+    scope_unbind(a->scope, minim_car(clause));
+}
+
+static void analyze_lambda(var_analysis *a, mobj e) {
+    mobj proc;
+
+    if (!minim_falsep(eq_hashtable_find(a->loops, e))) {
+        analyze_clause(a, minim_cdr(e));
+        return;
+    }
+
+    proc = Mvector(proc_length, NULL);
+    proc_expr(proc) = e;
+    proc_fvs(proc) = minim_null;
+    proc_fv_set(proc) = Mhashtable(0);
+
+    a->procs = Mcons(proc, a->procs);
+    a->depth += 1;
+    if (minim_car(e) == lambda_symbol) {
+        analyze_clause(a, minim_cdr(e));
+    } else {
+        for (mobj clauses = minim_cdr(e); !minim_nullp(clauses); clauses = minim_cdr(clauses))
+            analyze_clause(a, minim_car(clauses));
+    }
+
+    a->depth -= 1;
+    a->procs = minim_cdr(a->procs);
+    if (!minim_nullp(proc_fvs(proc)))
+        eq_hashtable_set(a->fvs, e, list_reverse(proc_fvs(proc)));
 }
 
-static mobj app_free_vars(mobj e, mobj table) {
-    mobj fvs = free_vars(minim_car(e), table);
-    for (e = minim_cdr(e); !minim_nullp(e); e = minim_cdr(e))
-        fvs = merge_free_vars(free_vars(minim_car(e), table), fvs);
-    return fvs;
+static void analyze_mvlet(var_analysis *a, mobj e) {
+    mobj ids = minim_car(minim_cddr(e));
+    analyze_expr(a, minim_cadr(e));
+    scope_bind(a->scope, ids, e, a->depth);
+    analyze_expr(a, minim_cadr(minim_cddr(e)));
+    scope_unbind(a->scope, ids);
 }
 
-static mobj free_vars(mobj expr, mobj table) {
+static void analyze_expr(var_analysis *a, mobj expr) {
     if (minim_consp(expr)) {
         // special form or application
         mobj head = minim_car(expr);
@@ -113,126 +191,339 @@ static mobj free_vars(mobj expr, mobj table) {
             // special forms
             if (head == define_values_symbol) {
                 // define-values form
-                return define_values_free_vars(expr, table);
+                analyze_expr(a, minim_car(minim_cddr(expr)));
+                return;
             } else if (head == setb_symbol) {
                 // set! form
-                return begin_free_vars(expr, table);
-            } else if (head == lambda_symbol) {
-                // lambda form
-                return lambda_free_vars(expr, table);
-            } else if (head == case_lambda_symbol) {
-                // case-lambda form
-                return case_lambda_free_vars(expr, table);
-            } else if (head == mvcall_symbol) {
-                // mv-call form
-                return begin_free_vars(expr, table);
+                analyze_ref(a, minim_cadr(expr), 1);
+                analyze_expr(a, minim_car(minim_cddr(expr)));
+                return;
+            } else if (head == lambda_symbol || head == case_lambda_symbol) {
+                // lambda or case-lambda form
+                analyze_lambda(a, expr);
+                return;
             } else if (head == mvlet_symbol) {
                 // mv-let form
-                return mvlet_free_vars(expr, table);
-            } else if (head == mvvalues_symbol) {
-                // mv-values form
-                return begin_free_vars(expr, table);
-            } else if (head == begin_symbol) {
-                // begin form
-                return begin_free_vars(expr, table);
-            } else if (head == if_symbol) {
-                // if form
-                return begin_free_vars(expr, table);
-            } else if (head == quote_symbol) {
-                // quote form
-                return minim_null;
-            } else if (head == quote_syntax_symbol) {
-                // quote-syntax form
-                return minim_null;
-            } else if (head == make_unbound_symbol) {
-                // make-unbound form
-                return minim_null;
+                analyze_mvlet(a, expr);
+                return;
+            } else if (head == mvcall_symbol
+                || head == mvvalues_symbol
+                || head == begin_symbol
+                || head == if_symbol) {
+                // mv-call, mv-values, begin, or if form
+                analyze_seq(a, minim_cdr(expr));
+                return;
+            } else if (head == quote_symbol
+                || head == quote_syntax_symbol
+                || head == make_unbound_symbol) {
+                // quote, quote-syntax, or make-unbound form
+                return;
             }
         }
 
         // application
-        return app_free_vars(expr, table);
+        analyze_seq(a, expr);
     } else if (minim_symbolp(expr)) {
         // symbol
-        return Mlist1(expr);
-    } else if (minim_boolp(expr)
+        analyze_ref(a, expr, 0);
+    } else if (!(minim_boolp(expr)
         || minim_fixnump(expr)
         || minim_charp(expr)
         || minim_stringp(expr)
         || minim_boxp(expr)
-        || minim_vectorp(expr)) {
-        // self-evaluating
-        return minim_null;
-    } else {
-        minim_error1("free_vars", "cannot analyze", expr);
+        || minim_vectorp(expr))) {
+        minim_error1("jit_analyze_vars", "cannot analyze", expr);
     }
 }
 
-mobj jit_free_vars(mobj expr, mobj table) {
-    return free_vars(expr, table);
+void jit_analyze_vars(mobj expr, mobj fvs, mobj mutated, mobj captured, mobj loops) {
+    var_analysis a;
+
+    a.scope = Mhashtable(0);
+    a.procs = minim_null;
+    a.depth = 0;
+    a.fvs = fvs;
+    a.mutated = mutated;
+    a.captured = captured;
+    a.loops = loops;
+    analyze_expr(&a, expr);
 }
 
 //
-//  Bound variable analysis
+//  Known procedure analysis
+//  After normalization, `letrec-values` initializes a variable bound
+//  to a procedure with `(mv-let <lambda> (t) (set! id t))` (see
+//  `jit_opt_L0_letrec_values`). If that is the only `set!` of the
+//  variable, it holds the procedure whenever the procedure runs,
+//  so calls to the variable from the procedure are calls to itself.
+//  The table records each such procedure with its variable.
+//  Since only names are compared, any other `set!` of the same name
+//  rules out the variable.
 //
 
-static mobj define_values_bound_vars(mobj e, mobj table) {
-    return list_append2(
-        minim_cadr(e),
-        bound_vars(minim_car(minim_cddr(e)), table)
-    );
+static void known_procs(mobj expr, mobj sets, mobj procs);
+
+// Is `e` of the form `(mv-let <lambda> (t) (set! id t))`?
+static int letrec_initp(mobj e) {
+    mobj producer, ids, body;
+
+    producer = minim_cadr(e);
+    ids = minim_car(minim_cddr(e));
+    body = minim_cadr(minim_cddr(e));
+    return minim_consp(producer)
+        && (minim_car(producer) == lambda_symbol || minim_car(producer) == case_lambda_symbol)
+        && minim_consp(ids)
+        && minim_nullp(minim_cdr(ids))
+        && minim_consp(body)
+        && minim_car(body) == setb_symbol
+        && minim_car(minim_cddr(body)) == minim_car(ids);
 }
 
-static mobj lambda_bound_vars(mobj e, mobj table) {
-    mobj ids = formals_to_ids(minim_cadr(e));
-    mobj bound = bound_vars(Mcons(begin_symbol, minim_cddr(e)), table);
-    bound = list_append2(ids, bound);
+static void known_procs_seq(mobj es, mobj sets, mobj procs) {
+    for (; !minim_nullp(es); es = minim_cdr(es))
+        known_procs(minim_car(es), sets, procs);
+}
 
-    minim_unbox(table) = Mcons(Mcons(e, Mlist1(bound)), minim_unbox(table));
-    return minim_null;
+static void known_procs(mobj expr, mobj sets, mobj procs) {
+    if (minim_consp(expr)) {
+        // special form or application
+        mobj head = minim_car(expr);
+        if (minim_symbolp(head)) {
+            // special forms
+            if (head == define_values_symbol) {
+                // define-values form
+                known_procs(minim_car(minim_cddr(expr)), sets, procs);
+                return;
+            } else if (head == setb_symbol) {
+                // set! form
+                mobj cell = eq_hashtable_find(sets, minim_cadr(expr));
+                if (minim_falsep(cell)) {
+                    eq_hashtable_set(sets, minim_cadr(expr), Mfixnum(1));
+                } else {
+                    minim_cdr(cell) = Mfixnum(minim_fixnum(minim_cdr(cell)) + 1);
+                }
+
+                known_procs(minim_car(minim_cddr(expr)), sets, procs);
+                return;
+            } else if (head == lambda_symbol) {
+                // lambda form
+                known_procs_seq(minim_cddr(expr), sets, procs);
+                return;
+            } else if (head == case_lambda_symbol) {
+                // case-lambda form
+                for (mobj clauses = minim_cdr(expr); !minim_nullp(clauses); clauses = minim_cdr(clauses))
+                    known_procs_seq(minim_cdar(clauses), sets, procs);
+                return;
+            } else if (head == mvlet_symbol) {
+                // mv-let form
+                if (letrec_initp(expr)) {
+                    mobj id = minim_cadr(minim_cadr(minim_cddr(expr)));
+                    minim_unbox(procs) = Mcons(Mcons(minim_cadr(expr), id), minim_unbox(procs));
+                    GC_write_barrier(procs);
+                }
+
+                known_procs(minim_cadr(expr), sets, procs);
+                known_procs(minim_cadr(minim_cddr(expr)), sets, procs);
+                return;
+            } else if (head == mvcall_symbol
+                || head == mvvalues_symbol
+                || head == begin_symbol
+                || head == if_symbol) {
+                // mv-call, mv-values, begin, or if form
+                known_procs_seq(minim_cdr(expr), sets, procs);
+                return;
+            } else if (head == quote_symbol
+                || head == quote_syntax_symbol
+                || head == make_unbound_symbol) {
+                // quote, quote-syntax, or make-unbound form
+                return;
+            }
+        }
+
+        // application
+        known_procs_seq(expr, sets, procs);
+    }
 }
 
-static mobj case_lambda_bound_vars(mobj e, mobj table) {
-    mobj clause_bound = minim_null;
-    for (mobj clauses = minim_cdr(e); !minim_nullp(clauses); clauses = minim_cdr(clauses)) {
-        mobj ids = formals_to_ids(minim_caar(clauses));
-        mobj bound = list_append2(ids, bound_vars(Mcons(begin_symbol, minim_cdar(clauses)), table));
-        clause_bound = Mcons(list_append2(ids, bound), clause_bound);
+void jit_known_procs(mobj expr, mobj table) {
+    mobj sets, procs;
+
+    sets = Mhashtable(0);
+    procs = Mbox(minim_null);
+    known_procs(expr, sets, procs);
+    for (mobj it = minim_unbox(procs); !minim_nullp(it); it = minim_cdr(it)) {
+        if (minim_cdr(eq_hashtable_find(sets, minim_cdar(it))) == Mfixnum(1))
+            eq_hashtable_set(table, minim_caar(it), minim_cdar(it));
     }
+}
 
-    minim_unbox(table) = Mcons(
-        Mcons(e, list_reverse(clause_bound)),
-        minim_unbox(table)
-    );
+//
+//  Escape analysis
+//  A procedure bound by `letrec-values` escapes unless its variable
+//  is only called, with the number of arguments the procedure accepts,
+//  as the entire body of the `letrec-values` form and from the tail
+//  positions of the procedure itself. Otherwise, the procedure is a
+//  loop that does not need a closure: its body is compiled where it
+//  is bound and each call assigns the arguments and jumps back to the
+//  start of the body (see `compile_loop`). A call to a loop from a
+//  tail position of another loop nested within it is a jump as well
+//  as long as the inner one is also a loop.
+//
+//  The table maps the `mv-let` form binding each loop, the procedure,
+//  and each call to it to the procedure.
+//
 
-    return minim_null;
+typedef struct {
+    mobj scope;         // binders of each variable (see above)
+    mobj loops;         // binding site to its loop record
+    mobj table;         // procedures compiled as loops
+} escape_analysis;
+
+// A loop: `#(<expr> <calls> <escapesp> <outer>)` where `<outer>`
+// lists the loops called from tail positions of its body
+#define loop_length         4
+#define loop_expr(l)        (minim_vector_ref(l, 0))
+#define loop_calls(l)       (minim_vector_ref(l, 1))
+#define loop_escapesp(l)    (minim_vector_ref(l, 2))
+#define loop_outer(l)       (minim_vector_ref(l, 3))
+
+static size_t num_procs = 0;
+static size_t num_loops = 0;
+
+static void escape_expr(escape_analysis *a, mobj expr, mobj tail);
+
+// Is `e` of the form `(mv-let (make-unbound) (id) (begin <init> (id <arg> ...)))`
+// where `<init>` binds `id` to a `lambda` accepting the arguments?
+static int loop_bindingp(mobj e) {
+    mobj producer, ids, body, init, call, formals;
+
+    producer = minim_cadr(e);
+    ids = minim_car(minim_cddr(e));
+    body = minim_cadr(minim_cddr(e));
+    if (!(minim_consp(producer)
+        && minim_car(producer) == make_unbound_symbol
+        && minim_consp(ids)
+        && minim_nullp(minim_cdr(ids))
+        && minim_consp(body)
+        && minim_car(body) == begin_symbol
+        && list_length(body) == 3))
+        return 0;
+
+    init = minim_cadr(body);
+    call = minim_car(minim_cddr(body));
+    if (!(minim_consp(init)
+        && minim_car(init) == mvlet_symbol
+        && letrec_initp(init)
+        && minim_car(minim_cadr(init)) == lambda_symbol
+        && minim_cadr(minim_cadr(minim_cddr(init))) == minim_car(ids)
+        && minim_consp(call)
+        && minim_car(call) == minim_car(ids)))
+        return 0;
+
+    formals = minim_cadr(minim_cadr(init));
+    return minim_listp(formals) && list_length(formals) == list_length(minim_cdr(call));
 }
 
-static mobj mvlet_bound_vars(mobj e, mobj table) {
-    return list_append2(
-        bound_vars(minim_cadr(e), table),
-        list_append2(
-            minim_car(minim_cddr(e)),
-            bound_vars(minim_cadr(minim_cddr(e)), table)
-        )
-    );
+// Returns the loop bound to `id` (or `#f`).
+static mobj escape_lookup(escape_analysis *a, mobj id) {
+    mobj binder, cell;
+
+    binder = scope_lookup(a->scope, id);
+    if (minim_falsep(binder))
+        return minim_false;
+
+    cell = eq_hashtable_find(a->loops, minim_car(binder));
+    return minim_falsep(cell) ? minim_false : minim_cdr(cell);
 }
 
-static mobj begin_bound_vars(mobj e, mobj table) {
-    mobj bound = minim_null;
-    for (e = minim_cdr(e); !minim_nullp(e); e = minim_cdr(e))
-        bound = list_append2(bound, bound_vars(minim_car(e), table));
-    return bound;
+static void escape_ref(escape_analysis *a, mobj id) {
+    mobj loop = escape_lookup(a, id);
+    if (!minim_falsep(loop))
+        loop_escapesp(loop) = minim_true;
 }
 
-static mobj app_bound_vars(mobj e, mobj table) {
-    mobj bound = bound_vars(minim_car(e), table);
-    for (e = minim_cdr(e); !minim_nullp(e); e = minim_cdr(e))
-        bound = list_append2(bound, bound_vars(minim_car(e), table));
-    return bound;
+// Records a call to a loop from a tail position of it.
+// Returns false if `expr` is not such a call.
+static int escape_jump(escape_analysis *a, mobj expr, mobj tail) {
+    mobj loop, formals;
+
+    loop = escape_lookup(a, minim_car(expr));
+    if (minim_falsep(loop))
+        return 0;
+
+    formals = minim_cadr(loop_expr(loop));
+    if (list_length(formals) != list_length(minim_cdr(expr)) || minim_falsep(memq(tail, loop)))
+        return 0;
+
+    // the loops in between must be compiled inline
+    for (; minim_car(tail) != loop; tail = minim_cdr(tail)) {
+        loop_outer(minim_car(tail)) = Mcons(loop, loop_outer(minim_car(tail)));
+        GC_write_barrier(minim_car(tail));
+    }
+
+    loop_calls(loop) = Mcons(expr, loop_calls(loop));
+    GC_write_barrier(loop);
+    return 1;
+}
+
+static void escape_app(escape_analysis *a, mobj expr, mobj tail) {
+    mobj head = minim_car(expr);
+    if (!minim_symbolp(head)) {
+        escape_expr(a, head, minim_null);
+    } else if (!escape_jump(a, expr, tail)) {
+        escape_ref(a, head);
+    }
+
+    for (mobj it = minim_cdr(expr); !minim_nullp(it); it = minim_cdr(it))
+        escape_expr(a, minim_car(it), minim_null);
 }
 
-static mobj bound_vars(mobj expr, mobj table) {
+// Only the last expression is in tail position.
+static void escape_seq(escape_analysis *a, mobj es, mobj tail) {
+    for (; !minim_nullp(es); es = minim_cdr(es))
+        escape_expr(a, minim_car(es), minim_nullp(minim_cdr(es)) ? tail : minim_null);
+}
+
+static void escape_clause(escape_analysis *a, mobj clause, mobj tail) {
+    scope_bind(a->scope, minim_car(clause), clause, 0);
+    escape_seq(a, minim_cdr(clause), tail);
+    scope_unbind(a->scope, minim_car(clause));
+}
+
+static void escape_loop(escape_analysis *a, mobj e, mobj tail) {
+    mobj ids, body, proc, loop;
+
+    ids = minim_car(minim_cddr(e));
+    body = minim_cadr(minim_cddr(e));
+    proc = minim_cadr(minim_cadr(body));
+
+    loop = Mvector(loop_length, NULL);
+    loop_expr(loop) = proc;
+    loop_calls(loop) = minim_null;
+    loop_escapesp(loop) = minim_false;
+    loop_outer(loop) = minim_null;
+    eq_hashtable_set(a->loops, e, loop);
+
+    num_procs += 1;
+    scope_bind(a->scope, ids, e, 0);
+    escape_clause(a, minim_cdr(proc), Mcons(loop, tail));
+    escape_app(a, minim_car(minim_cddr(body)), Mlist1(loop));
+    scope_unbind(a->scope, ids);
+
+    if (minim_truep(loop_escapesp(loop))) {
+        // calls from the body to other loops are not jumps
+        for (mobj it = loop_outer(loop); !minim_nullp(it); it = minim_cdr(it))
+            loop_escapesp(minim_car(it)) = minim_true;
+    } else {
+        eq_hashtable_set(a->table, e, proc);
+        eq_hashtable_set(a->table, proc, proc);
+        for (mobj it = loop_calls(loop); !minim_nullp(it); it = minim_cdr(it))
+            eq_hashtable_set(a->table, minim_car(it), proc);
+        num_loops += 1;
+    }
+}
+
+static void escape_expr(escape_analysis *a, mobj expr, mobj tail) {
     if (minim_consp(expr)) {
         // special form or application
         mobj head = minim_car(expr);
@@ -240,61 +531,75 @@ static mobj bound_vars(mobj expr, mobj table) {
             // special forms
             if (head == define_values_symbol) {
                 // define-values form
-                return define_values_bound_vars(expr, table);
+                escape_expr(a, minim_car(minim_cddr(expr)), minim_null);
+                return;
             } else if (head == setb_symbol) {
                 // set! form
-                return begin_bound_vars(expr, table);
+                escape_ref(a, minim_cadr(expr));
+                escape_expr(a, minim_car(minim_cddr(expr)), minim_null);
+                return;
             } else if (head == lambda_symbol) {
                 // lambda form
-                return lambda_bound_vars(expr, table);
+                num_procs += 1;
+                escape_clause(a, minim_cdr(expr), minim_null);
+                return;
             } else if (head == case_lambda_symbol) {
                 // case-lambda form
-                return case_lambda_bound_vars(expr, table);
-            } else if (head == mvcall_symbol) {
-                // mv-call form
-                return begin_bound_vars(expr, table);
+                num_procs += 1;
+                for (mobj clauses = minim_cdr(expr); !minim_nullp(clauses); clauses = minim_cdr(clauses))
+                    escape_clause(a, minim_car(clauses), minim_null);
+                return;
             } else if (head == mvlet_symbol) {
                 // mv-let form
-                return mvlet_bound_vars(expr, table);
-            } else if (head == mvvalues_symbol) {
-                // mv-values form
-                return begin_bound_vars(expr, table);
+                if (loop_bindingp(expr)) {
+                    escape_loop(a, expr, tail);
+                } else {
+                    mobj ids = minim_car(minim_cddr(expr));
+                    escape_expr(a, minim_cadr(expr), minim_null);
+                    scope_bind(a->scope, ids, expr, 0);
+                    escape_expr(a, minim_cadr(minim_cddr(expr)), tail);
+                    scope_unbind(a->scope, ids);
+                }
+                return;
+            } else if (head == mvcall_symbol || head == mvvalues_symbol) {
+                // mv-call or mv-values form
+                escape_seq(a, minim_cdr(expr), minim_null);
+                return;
             } else if (head == begin_symbol) {
                 // begin form
-                return begin_bound_vars(expr, table);
+                escape_seq(a, minim_cdr(expr), tail);
+                return;
             } else if (head == if_symbol) {
                 // if form
-                return begin_bound_vars(expr, table);
-            } else if (head == quote_symbol) {
-                // quote form
-                return minim_null;
-            } else if (head == quote_syntax_symbol) {
-                // quote-syntax form
-                return minim_null;
-            } else if (head == make_unbound_symbol) {
-                // make-unbound form
-                return minim_null;
+                escape_expr(a, minim_cadr(expr), minim_null);
+                for (mobj it = minim_cddr(expr); !minim_nullp(it); it = minim_cdr(it))
+                    escape_expr(a, minim_car(it), tail);
+                return;
+            } else if (head == quote_symbol
+                || head == quote_syntax_symbol
+                || head == make_unbound_symbol) {
+                // quote, quote-syntax, or make-unbound form
+                return;
             }
         }
 
         // application
-        return app_bound_vars(expr, table);
+        escape_app(a, expr, tail);
     } else if (minim_symbolp(expr)) {
         // symbol
-        return minim_null;
-    } else if (minim_boolp(expr)
-        || minim_fixnump(expr)
-        || minim_charp(expr)
-        || minim_stringp(expr)
-        || minim_boxp(expr)
-        || minim_vectorp(expr)) {
-        // self-evaluating
-        return minim_null;
-    } else {
-        minim_error1("bound_vars", "cannot analyze", expr);
+        escape_ref(a, expr);
     }
 }
 
-mobj jit_bound_vars(mobj expr, mobj table) {
-    return bound_vars(expr, table);
+void jit_analyze_escape(mobj expr, mobj table) {
+    escape_analysis a;
+
+    a.scope = Mhashtable(0);
+    a.loops = Mhashtable(0);
+    a.table = table;
+    escape_expr(&a, expr, minim_null);
+}
+
+void jit_analyze_print_stats(FILE *out) {
+    fprintf(out, ";; closures: %zu procedures, %zu compiled as loops\n", num_procs, num_loops);
 }
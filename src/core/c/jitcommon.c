@@ -5,40 +5,50 @@
 //
 //  Global compiler environment
 //  Represents a single compilation that may span multiple instances.
+//  Templates are indexed in the order they are added. Analysis
+//  results are eq hashtables keyed by expression (see `jitanalyze.c`).
+//  The entry of each loop is recorded once its body is compiled
+//  (see `compile_loop`).
 //
 
-#define global_cenv_length          3
+#define global_cenv_length          7
 #define global_cenv_tmpls(c)        (minim_vector_ref(c, 0))
 #define global_cenv_fvs(c)          (minim_vector_ref(c, 1))
-#define global_cenv_bound(c)        (minim_vector_ref(c, 2))
-#define global_cenv_num_tmpls(c)    (list_length(global_cenv_tmpls(c)))
+#define global_cenv_mutated(c)      (minim_vector_ref(c, 2))
+#define global_cenv_captured(c)     (minim_vector_ref(c, 3))
+#define global_cenv_known(c)        (minim_vector_ref(c, 4))
+#define global_cenv_loops(c)        (minim_vector_ref(c, 5))
+#define global_cenv_entries(c)      (minim_vector_ref(c, 6))
+#define global_cenv_num_tmpls(c)    (minim_hashtable_count(global_cenv_tmpls(c)))
 
 mobj make_global_cenv() {
     mobj cenv = Mvector(global_cenv_length, NULL);
-    global_cenv_tmpls(cenv) = minim_null;
-    global_cenv_fvs(cenv) = minim_null;
-    global_cenv_bound(cenv) = minim_null;
+    global_cenv_tmpls(cenv) = Mhashtable(0);
+    global_cenv_fvs(cenv) = Mhashtable(0);
+    global_cenv_mutated(cenv) = Mhashtable(0);
+    global_cenv_captured(cenv) = Mhashtable(0);
+    global_cenv_known(cenv) = Mhashtable(0);
+    global_cenv_loops(cenv) = Mhashtable(0);
+    global_cenv_entries(cenv) = Mhashtable(0);
     return cenv;
 }
 
 size_t global_cenv_add_template(mobj cenv, mobj jit) {
     size_t idx = global_cenv_num_tmpls(cenv);
-    global_cenv_tmpls(cenv) = Mcons(jit, global_cenv_tmpls(cenv));
+    eq_hashtable_set(global_cenv_tmpls(cenv), Mfixnum(idx), jit);
     return idx;
 }
 
 mobj global_cenv_ref_template(mobj cenv, size_t i) {
-    mobj tmpls;
-    size_t j;
-    
-    tmpls = list_reverse(global_cenv_tmpls(cenv));
-    for (j = i; j > 0; j--) {
-        if (minim_nullp(tmpls))
-            minim_error1("cenv_template_ref", "index out of bounds", Mfixnum(i));
-        tmpls = minim_cdr(tmpls);
-    }
+    mobj cell = eq_hashtable_find(global_cenv_tmpls(cenv), Mfixnum(i));
+    if (minim_falsep(cell))
+        minim_error1("cenv_template_ref", "index out of bounds", Mfixnum(i));
+    return minim_cdr(cell);
+}
 
-    return minim_car(tmpls);
+static mobj global_cenv_ref(mobj table, mobj e, mobj default_val) {
+    mobj cell = eq_hashtable_find(table, e);
+    return minim_falsep(cell) ? default_val : minim_cdr(cell);
 }
 
 void global_cenv_set_fvs(mobj cenv, mobj fvs) {
@@ -46,34 +56,86 @@ void global_cenv_set_fvs(mobj cenv, mobj fvs) {
 }
 
 mobj global_cenv_get_fvs(mobj cenv, mobj e) {
-    mobj cell = assq_ref(global_cenv_fvs(cenv), e);
-    return minim_falsep(cell) ? minim_null : minim_cdr(cell);
+    return global_cenv_ref(global_cenv_fvs(cenv), e, minim_null);
+}
+
+void global_cenv_set_mutated(mobj cenv, mobj mutated) {
+    global_cenv_mutated(cenv) = mutated;
+}
+
+mobj global_cenv_get_mutated(mobj cenv, mobj e) {
+    return global_cenv_ref(global_cenv_mutated(cenv), e, minim_null);
+}
+
+void global_cenv_set_captured(mobj cenv, mobj captured) {
+    global_cenv_captured(cenv) = captured;
+}
+
+mobj global_cenv_get_captured(mobj cenv, mobj e) {
+    return global_cenv_ref(global_cenv_captured(cenv), e, minim_null);
+}
+
+void global_cenv_set_known(mobj cenv, mobj known) {
+    global_cenv_known(cenv) = known;
+}
+
+// Returns the variable always bound to the procedure `e` (or `#f`).
+mobj global_cenv_get_known(mobj cenv, mobj e) {
+    return global_cenv_ref(global_cenv_known(cenv), e, minim_false);
+}
+
+void global_cenv_set_loops(mobj cenv, mobj loops) {
+    global_cenv_loops(cenv) = loops;
+}
+
+// Returns the procedure compiled as a loop that is bound by `e`,
+// called by `e`, or is `e` (or `#f`).
+mobj global_cenv_get_loop(mobj cenv, mobj e) {
+    return global_cenv_ref(global_cenv_loops(cenv), e, minim_false);
 }
 
-void global_cenv_set_bound(mobj cenv, mobj bound) {
-    global_cenv_bound(cenv) = bound;
+void global_cenv_set_loop_entry(mobj cenv, mobj proc, mobj entry) {
+    eq_hashtable_set(global_cenv_entries(cenv), proc, entry);
 }
 
-mobj global_cenv_get_bound(mobj cenv, mobj e) {
-    mobj cell = assq_ref(global_cenv_bound(cenv), e);
-    return minim_falsep(cell) ? minim_null : minim_cdr(cell);
+mobj global_cenv_get_loop_entry(mobj cenv, mobj proc) {
+    return global_cenv_ref(global_cenv_entries(cenv), proc, minim_false);
 }
 
 //
 //  Procedure-level compiler enviornment
 //  Represents a single procedure
+//  Tracks the number of environment and stack slots needed by the
+//  clause being compiled and the number of frames pushed for calls
+//  in progress. The size of the frame is only known once the clause
+//  is compiled, so instructions refer to it with a placeholder
+//  (see `scope_cenv_frame_base`). A procedure that is known to be
+//  bound to a variable also records that variable and the entry
+//  label of each of its clauses (see `scope_cenv_self_entry`).
 //
 
-#define cenv_length         3
+#define cenv_length         9
 #define cenv_global(c)      (minim_vector_ref(c, 0))
 #define cenv_labels(c)      (minim_vector_ref(c, 1))
 #define cenv_fvs(c)         (minim_vector_ref(c, 2))
+#define cenv_env_count(c)   (minim_vector_ref(c, 3))
+#define cenv_slot_count(c)  (minim_vector_ref(c, 4))
+#define cenv_depth(c)       (minim_vector_ref(c, 5))
+#define cenv_frame_ref(c)   (minim_vector_ref(c, 6))
+#define cenv_self(c)        (minim_vector_ref(c, 7))
+#define cenv_entries(c)     (minim_vector_ref(c, 8))
 
 mobj make_cenv(mobj global_cenv) {
     mobj cenv = Mvector(cenv_length, NULL);
     cenv_global(cenv) = global_cenv;
     cenv_labels(cenv) = Mbox(minim_null);
     cenv_fvs(cenv) = minim_null;
+    cenv_env_count(cenv) = Mfixnum(0);
+    cenv_slot_count(cenv) = Mfixnum(0);
+    cenv_depth(cenv) = Mfixnum(0);
+    cenv_frame_ref(cenv) = Mbox(minim_false);
+    cenv_self(cenv) = minim_false;
+    cenv_entries(cenv) = minim_null;
     return cenv;
 }
 
@@ -97,6 +159,7 @@ mobj cenv_make_label(mobj cenv) {
     
     // update list
     minim_unbox(label_box) = Mcons(label, minim_unbox(label_box));
+    GC_write_barrier(label_box);
     return label;
 }
 
@@ -104,26 +167,87 @@ void cenv_set_fvs(mobj cenv, mobj fvs) {
     cenv_fvs(cenv) = fvs;
 }
 
+// Records the variable bound to the procedure and the entry of each
+// clause as a list of `(label req-arity . restp)` in clause order.
+void cenv_set_self(mobj cenv, mobj id, mobj entries) {
+    cenv_self(cenv) = id;
+    cenv_entries(cenv) = entries;
+}
+
+void cenv_reset_sizes(mobj cenv) {
+    cenv_env_count(cenv) = Mfixnum(0);
+    cenv_slot_count(cenv) = Mfixnum(0);
+}
+
+size_t cenv_env_size(mobj cenv) {
+    return minim_fixnum(cenv_env_count(cenv));
+}
+
+size_t cenv_frame_size(mobj cenv) {
+    return minim_fixnum(cenv_slot_count(cenv));
+}
+
+// Replaces each reference to the size of the frame.
+void cenv_patch_frame_size(mobj cenv, mobj ins) {
+    mobj ref, size;
+
+    ref = cenv_frame_ref(cenv);
+    size = cenv_slot_count(cenv);
+    for (; !minim_nullp(ins); ins = minim_cdr(ins)) {
+        mobj in = minim_car(ins);
+        if (minim_consp(in)) {
+            for (in = minim_cdr(in); !minim_nullp(in); in = minim_cdr(in)) {
+                if (minim_car(in) == ref)
+                    minim_car(in) = size;
+            }
+        }
+    }
+}
+
+static void cenv_update_sizes(mobj cenv, size_t env_count, size_t slot_count) {
+    if (env_count > cenv_env_size(cenv))
+        cenv_env_count(cenv) = Mfixnum(env_count);
+    if (slot_count > cenv_frame_size(cenv))
+        cenv_slot_count(cenv) = Mfixnum(slot_count);
+}
+
 //
 //  Scope-level environment
 //  Represents the current compile-time scope
+//  Each variable is either at the top-level, in the environment
+//  (directly or in a cell), or in a stack slot (see `var_location`).
+//  Locations are encoded as fixnums: the index shifted left by two
+//  with the kind of location in the low bits.
 //
 
-#define scope_cenv_length       2
-#define scope_cenv_proc(c)      (minim_vector_ref(c, 0))
-#define scope_cenv_bound(c)     (minim_vector_ref(c, 1))
+#define scope_cenv_length           5
+#define scope_cenv_proc(c)          (minim_vector_ref(c, 0))
+#define scope_cenv_bound(c)         (minim_vector_ref(c, 1))
+#define scope_cenv_locs(c)          (minim_vector_ref(c, 2))
+#define scope_cenv_env_count(c)     (minim_vector_ref(c, 3))
+#define scope_cenv_slot_count(c)    (minim_vector_ref(c, 4))
+
+#define make_location(kind, idx)    (Mfixnum(((idx) << 2) | (kind)))
+#define location_kind(l)            ((var_location) (minim_fixnum(l) & 0x3))
+#define location_index(l)           ((size_t) (minim_fixnum(l) >> 2))
 
 mobj make_scope_cenv(mobj proc_cenv) {
     mobj cenv = Mvector(scope_cenv_length, NULL);
     scope_cenv_proc(cenv) = proc_cenv;
     scope_cenv_bound(cenv) = minim_null;
+    scope_cenv_locs(cenv) = minim_null;
+    scope_cenv_env_count(cenv) = Mfixnum(0);
+    scope_cenv_slot_count(cenv) = Mfixnum(0);
     return cenv;
 }
 
 mobj scope_cenv_extend(mobj cenv) {
     mobj cenv2 = Mvector(scope_cenv_length, NULL);
     scope_cenv_proc(cenv2) = scope_cenv_proc(cenv);
-    scope_cenv_bound(cenv2) = copy_list(scope_cenv_bound(cenv));
+    scope_cenv_bound(cenv2) = scope_cenv_bound(cenv);
+    scope_cenv_locs(cenv2) = scope_cenv_locs(cenv);
+    scope_cenv_env_count(cenv2) = scope_cenv_env_count(cenv);
+    scope_cenv_slot_count(cenv2) = scope_cenv_slot_count(cenv);
     return cenv2;
 }
 
@@ -139,22 +263,130 @@ mobj scope_cenv_make_label(mobj cenv) {
     return cenv_make_label(scope_cenv_proc(cenv));
 }
 
+static void scope_cenv_add(mobj cenv, mobj id, mobj loc) {
+    scope_cenv_bound(cenv) = Mcons(id, scope_cenv_bound(cenv));
+    scope_cenv_locs(cenv) = Mcons(loc, scope_cenv_locs(cenv));
+    GC_write_barrier(cenv);
+    cenv_update_sizes(
+        scope_cenv_proc(cenv),
+        minim_fixnum(scope_cenv_env_count(cenv)),
+        minim_fixnum(scope_cenv_slot_count(cenv))
+    );
+}
+
 size_t scope_cenv_bind_count(mobj cenv) {
-    return list_length(scope_cenv_bound(cenv));
+    return minim_fixnum(scope_cenv_env_count(cenv));
 }
 
-size_t scope_cenv_bind(mobj cenv, mobj id) {
-    size_t idx = list_length(scope_cenv_bound(cenv));
-    scope_cenv_bound(cenv) = Mcons(id, scope_cenv_bound(cenv));
+// Binds a variable to the next slot of the environment.
+size_t scope_cenv_bind(mobj cenv, mobj id, int boxedp) {
+    size_t idx = scope_cenv_bind_count(cenv);
+    scope_cenv_env_count(cenv) = Mfixnum(idx + 1);
+    scope_cenv_add(cenv, id, make_location(boxedp ? VAR_CELL : VAR_LOCAL, idx));
+    return idx;
+}
+
+// Reserves `n` consecutive stack slots, returning the first one.
+size_t scope_cenv_alloc_slots(mobj cenv, size_t n) {
+    size_t slot = minim_fixnum(scope_cenv_slot_count(cenv));
+    scope_cenv_slot_count(cenv) = Mfixnum(slot + n);
+    cenv_update_sizes(scope_cenv_proc(cenv), 0, slot + n);
+    return slot;
+}
+
+// Reserves `n` consecutive slots of the environment, returning the first one.
+size_t scope_cenv_alloc_env(mobj cenv, size_t n) {
+    size_t idx = scope_cenv_bind_count(cenv);
+    scope_cenv_env_count(cenv) = Mfixnum(idx + n);
+    cenv_update_sizes(scope_cenv_proc(cenv), idx + n, 0);
     return idx;
 }
 
-mobj scope_cenv_ref(mobj cenv, mobj id) {
-    mobj ref = memq(scope_cenv_bound(cenv), id);
-    if (minim_falsep(ref)) {
-        return ref;
+// Binds a variable to a slot of the environment.
+void scope_cenv_bind_env(mobj cenv, mobj id, size_t idx, int boxedp) {
+    if (idx >= scope_cenv_bind_count(cenv))
+        scope_cenv_env_count(cenv) = Mfixnum(idx + 1);
+    scope_cenv_add(cenv, id, make_location(boxedp ? VAR_CELL : VAR_LOCAL, idx));
+}
+
+// Binds a variable to a stack slot.
+void scope_cenv_bind_slot(mobj cenv, mobj id, size_t slot) {
+    if (slot >= (size_t) minim_fixnum(scope_cenv_slot_count(cenv)))
+        scope_cenv_slot_count(cenv) = Mfixnum(slot + 1);
+    scope_cenv_add(cenv, id, make_location(VAR_STACK, slot));
+}
+
+var_location scope_cenv_lookup(mobj cenv, mobj id, size_t *idx) {
+    mobj ids, locs;
+
+    ids = scope_cenv_bound(cenv);
+    locs = scope_cenv_locs(cenv);
+    for (; !minim_nullp(ids); ids = minim_cdr(ids), locs = minim_cdr(locs)) {
+        if (minim_car(ids) == id) {
+            *idx = location_index(minim_car(locs));
+            return location_kind(minim_car(locs));
+        }
+    }
+
+    return VAR_TOP_LEVEL;
+}
+
+// If `id` refers to the procedure being compiled, returns the
+// entry label of the clause that accepts `argc` arguments,
+// otherwise `NULL`. A clause with a rest argument is never
+// entered directly since its rest list must be constructed.
+mobj scope_cenv_self_entry(mobj cenv, mobj id, size_t argc) {
+    mobj proc, fvs, entries;
+    size_t idx, fidx;
+
+    proc = scope_cenv_proc(cenv);
+    if (cenv_self(proc) != id)
+        return NULL;
+
+    // the variable must not be shadowed
+    if (scope_cenv_lookup(cenv, id, &idx) != VAR_CELL)
+        return NULL;
+
+    fidx = 0;
+    for (fvs = cenv_fvs(proc); !minim_nullp(fvs) && minim_car(fvs) != id; fvs = minim_cdr(fvs))
+        fidx += 1;
+    if (minim_nullp(fvs) || fidx != idx)
+        return NULL;
+
+    // first clause that accepts the arguments (as in the arity check)
+    for (entries = cenv_entries(proc); !minim_nullp(entries); entries = minim_cdr(entries)) {
+        mobj entry = minim_car(entries);
+        size_t req = minim_fixnum(minim_cadr(entry));
+        if (minim_truep(minim_cddr(entry))) {
+            if (argc >= req)
+                return NULL;
+        } else if (argc == req) {
+            return minim_car(entry);
+        }
+    }
+
+    return NULL;
+}
+
+// Calls push a frame before evaluating their operands.
+void scope_cenv_enter_frame(mobj cenv) {
+    mobj proc = scope_cenv_proc(cenv);
+    cenv_depth(proc) = Mfixnum(minim_fixnum(cenv_depth(proc)) + 1);
+}
+
+void scope_cenv_exit_frame(mobj cenv) {
+    mobj proc = scope_cenv_proc(cenv);
+    cenv_depth(proc) = Mfixnum(minim_fixnum(cenv_depth(proc)) - 1);
+}
+
+// Returns the index of the first argument pushed to the current frame:
+// the locals of the procedure come first in its own frame.
+mobj scope_cenv_frame_base(mobj cenv) {
+    mobj proc = scope_cenv_proc(cenv);
+    if (minim_fixnum(cenv_depth(proc)) == 0) {
+        return cenv_frame_ref(proc);
     } else {
-        return Mfixnum(list_length(ref) - 1);
+        return Mfixnum(0);
     }
 }
 
@@ -171,22 +403,26 @@ static mobj next_non_label(mobj ins) {
     minim_error("next_non_label", "no next instruction");
 }
 
+static mobj label_ref(mobj label_map, mobj label) {
+    return minim_cdr(eq_hashtable_find(label_map, label));
+}
+
 mobj resolve_refs(mobj cenv, mobj ins) {
     mobj reloc, label_map;
 
     reloc = minim_null;
-    label_map = minim_null;
+    label_map = Mhashtable(0);
 
     // build unionfind of labels and eliminate redundant ones
     for (mobj it = ins; !minim_nullp(it); it = minim_cdr(it)) {
         mobj in = minim_car(it);
         if (minim_stringp(in)) {
             // label found (first one is the leading one)
-            reloc = assq_set(reloc, in, next_non_label(it));
-            label_map = assq_set(label_map, in, in);
+            reloc = Mcons(Mcons(in, next_non_label(it)), reloc);
+            eq_hashtable_set(label_map, in, in);
             // subsequent labels
             for (; minim_stringp(minim_cadr(it)); it = minim_cdr(it))
-                label_map = assq_set(label_map, minim_cadr(it), in);
+                eq_hashtable_set(label_map, minim_cadr(it), in);
         }
     }
 
@@ -195,27 +431,34 @@ mobj resolve_refs(mobj cenv, mobj ins) {
         mobj in = minim_car(it);
         if (minim_car(in) == brancha_symbol) {
             // brancha: need to replace the label with the next instruction
-            minim_cadr(in) = minim_cdr(assq_ref(label_map, minim_cadr(in)));
+            minim_cadr(in) = label_ref(label_map, minim_cadr(in));
+            GC_write_barrier(minim_cdr(in));
         } else if (minim_car(in) == branchf_symbol) {
             // branchf: need to replace the label with the next instruction
-            minim_cadr(in) = minim_cdr(assq_ref(label_map, minim_cadr(in)));
+            minim_cadr(in) = label_ref(label_map, minim_cadr(in));
+            GC_write_barrier(minim_cdr(in));
         } else if (minim_car(in) == branchgt_symbol) {
             // branchgt: need to replace the label with the next instruction
-            minim_car(minim_cddr(in)) = minim_cdr(assq_ref(label_map, minim_car(minim_cddr(in))));
+            minim_car(minim_cddr(in)) = label_ref(label_map, minim_car(minim_cddr(in)));
+            GC_write_barrier(minim_cddr(in));
         } else if (minim_car(in) == branchlt_symbol) {
             // branchlt: need to replace the label with the next instruction
-            minim_car(minim_cddr(in)) = minim_cdr(assq_ref(label_map, minim_car(minim_cddr(in))));
+            minim_car(minim_cddr(in)) = label_ref(label_map, minim_car(minim_cddr(in)));
+            GC_write_barrier(minim_cddr(in));
         } else if (minim_car(in) == branchne_symbol) {
             // branchne: need to replace the label with the next instruction
-            minim_car(minim_cddr(in)) = minim_cdr(assq_ref(label_map, minim_car(minim_cddr(in))));
+            minim_car(minim_cddr(in)) = label_ref(label_map, minim_car(minim_cddr(in)));
+            GC_write_barrier(minim_cddr(in));
         } else if (minim_car(in) == make_closure_symbol) {
             // closure: need to lookup JIT object to embed
             minim_cadr(in) = global_cenv_ref_template(cenv_global(cenv), minim_fixnum(minim_cadr(in)));
+            GC_write_barrier(minim_cdr(in));
         } else if (minim_car(in) == save_cc_symbol) {
             // save-cc: need to replace the label with the next instruction
-            minim_cadr(in) = minim_cdr(assq_ref(label_map, minim_cadr(in)));
+            minim_cadr(in) = label_ref(label_map, minim_cadr(in));
+            GC_write_barrier(minim_cdr(in));
         }
     }
 
-    return reloc;   
+    return list_reverse(reloc);
 }
@@ -77,87 +77,188 @@ static mobj with_tail_ret(mobj ins, int tailp) {
     return ins;
 }
 
+// Is every free variable of `expr` a top-level variable?
+static int top_level_fvsp(mobj expr, mobj env) {
+    mobj fvs;
+    size_t idx;
+
+    fvs = global_cenv_get_fvs(scope_cenv_global_env(env), expr);
+    for (; !minim_nullp(fvs); fvs = minim_cdr(fvs)) {
+        if (scope_cenv_lookup(env, minim_car(fvs), &idx) != VAR_TOP_LEVEL)
+            return 0;
+    }
+
+    return 1;
+}
+
 static mobj compile_define_values(mobj expr, mobj env, int tailp) {
-    mobj ids, ins;
+    mobj ids, val, code, ins;
 
     ids = minim_cadr(expr);
-    ins = compile_expr2(minim_car(minim_cddr(expr)), env, 0);
+    val = minim_car(minim_cddr(expr));
+    ins = compile_expr2(val, env, 0);
+
+    // procedure that only refers to top-level variables:
+    // calls to it may be inlined by later expressions
+    if (minim_consp(ids) && minim_nullp(minim_cdr(ids)) &&
+        minim_consp(val) && minim_car(val) == lambda_symbol &&
+        top_level_fvsp(val, env)) {
+        // first instruction is `(make-closure <idx> <nfvs>)`
+        code = global_cenv_ref_template(
+            scope_cenv_global_env(env),
+            minim_fixnum(minim_cadr(minim_car(ins)))
+        );
+        jit_register_inline(minim_car(ids), val, code);
+    }
+
     list_set_tail(ins, Mlist1(Mlist3(tl_bind_values_symbol, Mfixnum(list_length(ids)), ids)));
     return with_tail_ret(ins, tailp);
 }
 
 static mobj compile_setb(mobj expr, mobj env, int tailp) {
-    mobj ins, ref;
+    mobj ins;
+    size_t idx;
 
     ins = compile_expr2(minim_car(minim_cddr(expr)), env, 0);
-    ref = scope_cenv_ref(env, minim_cadr(expr));
-    if (minim_falsep(ref)) {
+    if (scope_cenv_lookup(env, minim_cadr(expr), &idx) == VAR_TOP_LEVEL) {
         // top-level symbol
         list_set_tail(ins, Mlist1(Mlist2(tl_rebind_symbol, minim_cadr(expr))));
     } else {
-        // local symbol
-        list_set_tail(ins, Mlist1(Mlist2(rebind_symbol, ref)));
+        // local symbol (always in a cell)
+        list_set_tail(ins, Mlist1(Mlist2(rebind_symbol, Mfixnum(idx))));
     }
 
     return with_tail_ret(ins, tailp);
 }
 
-static mobj compile_lambda_clause(mobj clause, mobj env, mobj fvs, mobj bound) {
-    mobj ins, args, body;
-    size_t env_size, aidx, bidx;
+// Binds the result to a local variable: mutated variables
+// are stored in a cell, others directly in the environment.
+static mobj compile_bind(mobj id, size_t bidx, int boxedp) {
+    if (boxedp) {
+        return Mlist1(Mlist3(bind_symbol, Mfixnum(bidx), id));
+    } else {
+        return Mlist1(Mlist2(local_set_symbol, Mfixnum(bidx)));
+    }
+}
 
-    env_size = list_length(fvs) + list_length(bound);
-    ins = Mlist2(
-        Mlist2(push_env_symbol, Mfixnum(env_size)),     // create new environment
-        Mlist1(closure_bind_symbol)                     // copy free variables
-    );
+// Variables that are neither mutated nor captured by a closure
+// are stored in the stack frame of the procedure.
+static int stack_varp(mobj id, mobj muts, mobj caps) {
+    return minim_falsep(memq(muts, id)) && minim_falsep(memq(caps, id));
+}
+
+// Does `expr` refer to `id`? Conservative since shadowing
+// bindings of `id` are not taken into account.
+static int refersp(mobj expr, mobj id) {
+    mobj head;
+
+    if (minim_consp(expr)) {
+        head = minim_car(expr);
+        if (head == quote_symbol || head == quote_syntax_symbol)
+            return 0;
+
+        for (; minim_consp(expr); expr = minim_cdr(expr)) {
+            if (refersp(minim_car(expr), id))
+                return 1;
+        }
+    }
+
+    return expr == id;
+}
+
+static mobj compile_lambda_clause(mobj clause, mobj env, size_t nfvs) {
+    mobj ins, binds, rest, body, args, muts, caps, proc_env;
+    size_t env_size, frame_size, aidx, bidx;
+    int boxedp;
 
-    // bind arguments
     env = scope_cenv_extend(env);
+    proc_env = scope_cenv_proc_env(env);
+    cenv_reset_sizes(proc_env);
+    muts = global_cenv_get_mutated(scope_cenv_global_env(env), clause);
+    caps = global_cenv_get_captured(scope_cenv_global_env(env), clause);
+
+    // bind arguments (stack variables remain in their slot)
+    binds = minim_null;
     aidx = 0;
     for (args = minim_car(clause); minim_consp(args); args = minim_cdr(args)) {
-        bidx = scope_cenv_bind(env, minim_car(args));
-        list_set_tail(ins, Mlist2(
-            Mlist3(get_arg_symbol, Mfixnum(res_reg_idx), Mfixnum(aidx)),
-            Mlist3(bind_symbol, Mfixnum(bidx), minim_car(args))
-        ));
+        if (stack_varp(minim_car(args), muts, caps)) {
+            scope_cenv_bind_slot(env, minim_car(args), aidx);
+        } else {
+            boxedp = !minim_falsep(memq(muts, minim_car(args)));
+            bidx = scope_cenv_bind(env, minim_car(args), boxedp);
+            binds = list_append2(binds, Mlist1(Mlist3(get_arg_symbol, Mfixnum(res_reg_idx), Mfixnum(aidx))));
+            binds = list_append2(binds, compile_bind(minim_car(args), bidx, boxedp));
+        }
 
         aidx += 1;
     }
 
-    // bind rest argument
-    if (!minim_nullp(args)) {
-        bidx = scope_cenv_bind(env, args);
-        list_set_tail(ins, Mlist2(
-            Mlist2(do_rest_symbol, Mfixnum(aidx)),
-            Mlist3(bind_symbol, Mfixnum(bidx), args)
-        )); 
+    // bind rest argument (stored in its slot once the frame is reserved)
+    // unless it is never referenced, so the list need not be built
+    rest = minim_null;
+    if (!minim_nullp(args) && refersp(minim_cdr(clause), args)) {
+        binds = list_append2(binds, Mlist1(Mlist2(do_rest_symbol, Mfixnum(aidx))));
+        if (stack_varp(args, muts, caps)) {
+            scope_cenv_bind_slot(env, args, aidx);
+            rest = Mlist1(Mlist2(stack_set_symbol, Mfixnum(aidx)));
+        } else {
+            boxedp = !minim_falsep(memq(muts, args));
+            bidx = scope_cenv_bind(env, args, boxedp);
+            binds = list_append2(binds, compile_bind(args, bidx, boxedp));
+        }
     }
 
-    // reset the frame
-    list_set_tail(ins, Mlist1(Mlist1(clear_frame_symbol)));
-
     // compile the body
     body = Mcons(begin_symbol, minim_cdr(clause));
-    list_set_tail(ins, compile_expr2(body, env, 1));
-    return ins;
+    body = compile_expr2(body, env, 1);
+    cenv_patch_frame_size(proc_env, body);
+    env_size = cenv_env_size(proc_env);
+    frame_size = cenv_frame_size(proc_env);
+
+    // a new environment is only needed for variables that are mutated
+    // or captured, otherwise the environment of the closure is used
+    ins = minim_null;
+    if (env_size > nfvs) {
+        ins = Mlist1(Mlist2(push_env_symbol, Mfixnum(env_size)));
+        if (nfvs > 0) {
+            // copy free variables
+            list_set_tail(ins, Mlist1(Mlist2(closure_bind_symbol, Mfixnum(nfvs))));
+        }
+    }
+
+    // reset the frame, keeping stack variables
+    ins = list_append2(ins, binds);
+    ins = list_append2(ins, Mlist1(Mlist2(reserve_frame_symbol, Mfixnum(frame_size))));
+    ins = list_append2(ins, rest);
+    return list_append2(ins, body);
 }
 
-static mobj compile_lookup_cell(mobj id, mobj env) {
-    mobj ref = scope_cenv_ref(env, id);
-    if (minim_falsep(ref)) {
+// Looks up the contents of a closure slot for a free variable:
+// the cell of a mutated or top-level variable and the value otherwise.
+static mobj compile_lookup_free(mobj id, mobj env) {
+    size_t idx;
+
+    switch (scope_cenv_lookup(env, id, &idx)) {
+    case VAR_TOP_LEVEL:
         // top-level symbol
         return Mlist1(Mlist2(tl_lookup_cell_symbol, id));
-    } else {
+    case VAR_CELL:
+        // mutated local symbol
+        return Mlist1(Mlist2(lookup_cell_symbol, Mfixnum(idx)));
+    case VAR_LOCAL:
         // local symbol
-        return Mlist1(Mlist2(lookup_cell_symbol, ref));
+        return Mlist1(Mlist2(local_ref_symbol, Mfixnum(idx)));
+    default:
+        // stack symbol
+        return Mlist1(Mlist2(stack_ref_symbol, Mfixnum(idx)));
     }
 }
 
-static mobj compile_case_lambda2(mobj expr, mobj env, mobj fvs, mobj bounds, int tailp) {
-    mobj ins, clauses, label, reloc, arity, code;
+static mobj compile_case_lambda2(mobj expr, mobj env, mobj fvs, mobj self, int tailp) {
+    mobj ins, clauses, label, reloc, arity, code, entries, entry;
     mobj proc_env, scope_env;
-    size_t idx;
+    size_t idx, nfvs;
+    var_location loc;
 
     ins = minim_null;
     arity = minim_null;
@@ -170,11 +271,29 @@ static mobj compile_case_lambda2(mobj expr, mobj env, mobj fvs, mobj bounds, int
     // create new scope compiler environment
     // contains free variables but no arguments
     scope_env = make_scope_cenv(proc_env);
-    for (mobj it = fvs; !minim_nullp(it); it = minim_cdr(it))
-        scope_cenv_bind(scope_env, minim_car(it));
+    for (mobj it = fvs; !minim_nullp(it); it = minim_cdr(it)) {
+        loc = scope_cenv_lookup(env, minim_car(it), &idx);
+        scope_cenv_bind(scope_env, minim_car(it), loc == VAR_TOP_LEVEL || loc == VAR_CELL);
+    }
 
-    // compile for each clause
+    // entry label of each clause: a procedure known to be bound
+    // to `self` jumps to them when calling itself
+    entries = minim_null;
     for (clauses = minim_cdr(expr); !minim_nullp(clauses); clauses = minim_cdr(clauses)) {
+        size_t req_arity;
+        int restp;
+
+        restp = get_formals_len(minim_caar(clauses), &req_arity);
+        entry = Mcons(cenv_make_label(proc_env), Mcons(Mfixnum(req_arity), restp ? minim_true : minim_false));
+        entries = list_append2(entries, Mlist1(entry));
+    }
+
+    if (!minim_falsep(self) && !minim_falsep(memq(fvs, self)))
+        cenv_set_self(proc_env, self, entries);
+
+    // compile for each clause
+    clauses = minim_cdr(expr);
+    for (; !minim_nullp(clauses); clauses = minim_cdr(clauses), entries = minim_cdr(entries)) {
         mobj branch, cl_ins;
         size_t req_arity;
         int restp;
@@ -197,33 +316,34 @@ static mobj compile_case_lambda2(mobj expr, mobj env, mobj fvs, mobj bounds, int
         }
         
         arity = update_arity(arity, req_arity, restp);
-        cl_ins = compile_lambda_clause(minim_car(clauses), scope_env, fvs, minim_car(bounds));
+        cl_ins = compile_lambda_clause(minim_car(clauses), scope_env, list_length(fvs));
+        list_set_tail(ins, Mlist1(minim_caar(entries)));
         list_set_tail(ins, cl_ins);
-        bounds = minim_cdr(bounds);
     }
 
     // arity exception
     list_set_tail(ins, Mlist2(label, Mlist1(do_arity_error_symbol)));
 
     // resolve references
-    reloc = resolve_refs(env, ins);
+    reloc = resolve_refs(proc_env, ins);
 
     // register JIT block
     code = write_code(ins, reloc, arity);
     idx = global_cenv_add_template(scope_cenv_global_env(env), code);
 
     // construct closure
-    ins = Mlist1(Mlist3(make_closure_symbol, Mfixnum(idx), Mfixnum(list_length(fvs))));
+    nfvs = list_length(fvs);
+    ins = Mlist1(Mlist3(make_closure_symbol, Mfixnum(idx), Mfixnum(nfvs)));
 
     // if any free variables
     if (!minim_nullp(fvs)) {
         // move closure to temporary
         list_set_tail(ins, Mlist1(Mlist3(mov_symbol, Mfixnum(t0_reg_idx), Mfixnum(res_reg_idx))));
 
-        // for each free variable, lookup the cell and copy into closure
+        // for each free variable, lookup the cell or value and copy into closure
         idx = 0;
         for (; !minim_nullp(fvs); fvs = minim_cdr(fvs)) {
-            list_set_tail(ins, compile_lookup_cell(minim_car(fvs), env));
+            list_set_tail(ins, compile_lookup_free(minim_car(fvs), env));
             list_set_tail(ins, Mlist1(Mlist4(closure_set_symbol, Mfixnum(t0_reg_idx), Mfixnum(idx), Mfixnum(res_reg_idx))));
             idx += 1;
         }
@@ -237,19 +357,19 @@ static mobj compile_case_lambda2(mobj expr, mobj env, mobj fvs, mobj bounds, int
 
 static mobj compile_lambda(mobj expr, mobj env, int tailp) {
     mobj fvs = global_cenv_get_fvs(scope_cenv_global_env(env), expr);
-    mobj bound = global_cenv_get_bound(scope_cenv_global_env(env), expr);
+    mobj self = global_cenv_get_known(scope_cenv_global_env(env), expr);
     expr = Mlist2(case_lambda_symbol, minim_cdr(expr));
-    return compile_case_lambda2(expr, env, fvs, bound, tailp);
+    return compile_case_lambda2(expr, env, fvs, self, tailp);
 }
 
 static mobj compile_case_lambda(mobj expr, mobj env, int tailp) {
     mobj fvs = global_cenv_get_fvs(scope_cenv_global_env(env), expr);
-    mobj bound = global_cenv_get_bound(scope_cenv_global_env(env), expr);
-    return compile_case_lambda2(expr, env, fvs, bound, tailp);
+    mobj self = global_cenv_get_known(scope_cenv_global_env(env), expr);
+    return compile_case_lambda2(expr, env, fvs, self, tailp);
 }
 
 static mobj compile_mvcall(mobj expr, mobj env, int tailp) {
-    mobj ins, label;
+    mobj ins, label, base;
 
     // need to save a continuation if not in tail position
     if (tailp) {
@@ -257,24 +377,137 @@ static mobj compile_mvcall(mobj expr, mobj env, int tailp) {
     } else {
         label = scope_cenv_make_label(env);
         ins = Mlist1(Mlist2(save_cc_symbol, label));
+        scope_cenv_enter_frame(env);
         list_set_tail(ins, compile_expr2(minim_cadr(expr), env, 0));
     }
     
-    list_set_tail(ins, Mlist2(Mlist1(clear_frame_symbol), Mlist1(do_with_values_symbol)));
+    base = scope_cenv_frame_base(env);
+    list_set_tail(ins, Mlist2(Mlist2(clear_frame_symbol, base), Mlist1(do_with_values_symbol)));
     list_set_tail(ins, compile_expr2(minim_car(minim_cddr(expr)), env, 0));
-    list_set_tail(ins, Mlist2(Mlist1(set_proc_symbol), Mlist1(apply_symbol)));
+    list_set_tail(ins, Mlist1(Mlist1(set_proc_symbol)));
 
-    // need a label to jump to if not in tail position
-    if (!tailp) {
-        list_set_tail(ins, Mlist1(label));
+    if (tailp) {
+        // tail position: arguments replace the current frame
+        list_set_tail(ins, Mlist2(Mlist2(shift_frame_symbol, base), Mlist1(apply_symbol)));
+    } else {
+        // need a label to jump to if not in tail position
+        list_set_tail(ins, Mlist2(Mlist1(apply_symbol), label));
+        scope_cenv_exit_frame(env);
     }
 
     return ins;
 }
 
+// Assigns the result to an argument of a loop at `loc`,
+// a `(<kind> . <index>)` pair (see `compile_loop`).
+static mobj compile_loop_assign(mobj id, mobj loc) {
+    size_t idx = minim_fixnum(minim_cdr(loc));
+    switch ((var_location) minim_fixnum(minim_car(loc))) {
+    case VAR_STACK:
+        return Mlist1(Mlist2(stack_set_symbol, Mfixnum(idx)));
+    case VAR_CELL:
+        return compile_bind(id, idx, 1);
+    default:
+        return compile_bind(id, idx, 0);
+    }
+}
+
+// Evaluates the arguments of a call to a loop and assigns them.
+// An argument is stored in a temporary first if a later argument
+// may refer to the variable it is assigned to.
+static mobj compile_loop_args(mobj expr, mobj proc, mobj entry, mobj env) {
+    mobj ins, temps, ids, locs, args;
+    size_t slot;
+    int laterp;
+
+    env = scope_cenv_extend(env);
+    ins = temps = minim_null;
+    ids = minim_cadr(proc);
+    locs = minim_cdr(entry);
+    args = minim_cdr(expr);
+    for (; !minim_nullp(args); args = minim_cdr(args), ids = minim_cdr(ids), locs = minim_cdr(locs)) {
+        ins = list_append2(ins, compile_expr2(minim_car(args), env, 0));
+
+        laterp = 0;
+        for (mobj it = minim_cdr(args); !minim_nullp(it); it = minim_cdr(it)) {
+            if (refersp(minim_car(it), minim_car(ids)))
+                laterp = 1;
+        }
+
+        if (laterp) {
+            slot = scope_cenv_alloc_slots(env, 1);
+            list_set_tail(ins, Mlist1(Mlist2(stack_set_symbol, Mfixnum(slot))));
+            temps = list_append2(temps, Mlist1(Mlist2(stack_ref_symbol, Mfixnum(slot))));
+            temps = list_append2(temps, compile_loop_assign(minim_car(ids), minim_car(locs)));
+        } else {
+            list_set_tail(ins, compile_loop_assign(minim_car(ids), minim_car(locs)));
+        }
+    }
+
+    return list_append2(ins, temps);
+}
+
+// Compiles a procedure bound by `letrec-values` that does not escape
+// (see `jit_analyze_escape`): the arguments of the procedure are
+// bound in the current procedure, then its body is compiled in place.
+// Calls to it assign the arguments and jump to the start of the body.
+static mobj compile_loop(mobj expr, mobj proc, mobj env, int tailp) {
+    mobj clause, muts, caps, loop_env, locs, entry, ins, body;
+    size_t idx;
+    int boxedp;
+
+    clause = minim_cdr(proc);
+    muts = global_cenv_get_mutated(scope_cenv_global_env(env), clause);
+    caps = global_cenv_get_captured(scope_cenv_global_env(env), clause);
+
+    // reserve a location for each argument: arguments of the initial
+    // call are evaluated where the arguments are not yet bound
+    env = scope_cenv_extend(env);
+    loop_env = scope_cenv_extend(env);
+    locs = minim_null;
+    for (mobj it = minim_car(clause); !minim_nullp(it); it = minim_cdr(it)) {
+        if (stack_varp(minim_car(it), muts, caps)) {
+            idx = scope_cenv_alloc_slots(env, 1);
+            scope_cenv_bind_slot(loop_env, minim_car(it), idx);
+            locs = list_append2(locs, Mlist1(Mcons(Mfixnum(VAR_STACK), Mfixnum(idx))));
+        } else {
+            boxedp = !minim_falsep(memq(muts, minim_car(it)));
+            idx = scope_cenv_alloc_env(env, 1);
+            scope_cenv_bind_env(loop_env, minim_car(it), idx, boxedp);
+            locs = list_append2(locs, Mlist1(Mcons(Mfixnum(boxedp ? VAR_CELL : VAR_LOCAL), Mfixnum(idx))));
+        }
+    }
+
+    entry = Mcons(scope_cenv_make_label(env), locs);
+    global_cenv_set_loop_entry(scope_cenv_global_env(env), proc, entry);
+
+    // initial call
+    body = minim_cadr(minim_cddr(expr));
+    ins = compile_loop_args(minim_car(minim_cddr(body)), proc, entry, env);
+
+    // body of the loop
+    body = Mcons(begin_symbol, minim_cdr(clause));
+    return list_append2(ins, Mcons(minim_car(entry), compile_expr2(body, loop_env, tailp)));
+}
+
+// Compiles a call to a loop from a tail position of its body.
+static mobj compile_loop_jump(mobj expr, mobj proc, mobj env) {
+    mobj entry, ins;
+
+    entry = global_cenv_get_loop_entry(scope_cenv_global_env(env), proc);
+    ins = compile_loop_args(expr, proc, entry, env);
+    return list_append2(ins, Mlist1(Mlist2(brancha_symbol, minim_car(entry))));
+}
+
 static mobj compile_mvlet(mobj expr, mobj env, int tailp) {
-    mobj ins, ids, it;
-    size_t bidx, valc;
+    mobj ins, ids, muts, caps, it;
+    size_t bidx, valc, idx, slot;
+    int boxedp, stackp;
+
+    // procedure bound by `letrec-values` compiled as a loop
+    it = global_cenv_get_loop(scope_cenv_global_env(env), expr);
+    if (!minim_falsep(it))
+        return compile_loop(expr, it, env, tailp);
 
     // evaluate producer
     ins = compile_expr2(minim_cadr(expr), env, 0);
@@ -282,15 +515,52 @@ static mobj compile_mvlet(mobj expr, mobj env, int tailp) {
     // extend compile-time environment
     env = scope_cenv_extend(env);
     ids = minim_car(minim_cddr(expr));
+    valc = list_length(ids);
+    muts = global_cenv_get_mutated(scope_cenv_global_env(env), expr);
+    caps = global_cenv_get_captured(scope_cenv_global_env(env), expr);
 
-    // bind values in run-time environment
-    bidx = scope_cenv_bind_count(env);
-    for (it = ids; !minim_nullp(it); it = minim_cdr(it))
-        scope_cenv_bind(env, minim_car(it));
+    stackp = 0;
+    for (it = ids; !minim_nullp(it); it = minim_cdr(it)) {
+        if (stack_varp(minim_car(it), muts, caps))
+            stackp = 1;
+    }
 
-    // bind result in new environment
-    valc = list_length(ids);
-    list_set_tail(ins, Mlist1(Mlist4(bind_values_symbol, Mfixnum(bidx), Mfixnum(valc), ids)));
+    if (stackp) {
+        // bind values to stack slots
+        slot = scope_cenv_alloc_slots(env, valc);
+        list_set_tail(ins, Mlist1(Mlist4(stack_bind_values_symbol, Mfixnum(slot), Mfixnum(valc), ids)));
+
+        // move any other variables into the environment
+        for (it = ids; !minim_nullp(it); it = minim_cdr(it)) {
+            if (stack_varp(minim_car(it), muts, caps)) {
+                scope_cenv_bind_slot(env, minim_car(it), slot);
+            } else {
+                boxedp = !minim_falsep(memq(muts, minim_car(it)));
+                bidx = scope_cenv_bind(env, minim_car(it), boxedp);
+                list_set_tail(ins, Mlist1(Mlist2(stack_ref_symbol, Mfixnum(slot))));
+                list_set_tail(ins, compile_bind(minim_car(it), bidx, boxedp));
+            }
+
+            slot += 1;
+        }
+    } else {
+        // bind values in run-time environment
+        bidx = scope_cenv_bind_count(env);
+        for (it = ids; !minim_nullp(it); it = minim_cdr(it))
+            scope_cenv_bind(env, minim_car(it), !minim_falsep(memq(muts, minim_car(it))));
+        list_set_tail(ins, Mlist1(Mlist4(bind_values_symbol, Mfixnum(bidx), Mfixnum(valc), ids)));
+
+        // move mutated variables into cells
+        idx = bidx;
+        for (it = ids; !minim_nullp(it); it = minim_cdr(it)) {
+            if (!minim_falsep(memq(muts, minim_car(it)))) {
+                list_set_tail(ins, Mlist1(Mlist2(local_ref_symbol, Mfixnum(idx))));
+                list_set_tail(ins, compile_bind(minim_car(it), idx, 1));
+            }
+
+            idx += 1;
+        }
+    }
 
     // evaluate body
     list_set_tail(ins, compile_expr2(minim_cadr(minim_cddr(expr)), env, tailp));
@@ -298,11 +568,12 @@ static mobj compile_mvlet(mobj expr, mobj env, int tailp) {
 }
 
 static mobj compile_mvvalues(mobj expr, mobj env, int tailp) {
-    mobj vals, ins;
+    mobj vals, ins, base;
     
     vals = minim_cdr(expr);
+    base = scope_cenv_frame_base(env);
     if (minim_nullp(vals)) {
-        ins = Mlist1(Mlist1(do_values_symbol));
+        ins = Mlist1(Mlist2(do_values_symbol, base));
     } else {
         ins = Mlist1(Mlist2(check_stack_symbol, Mfixnum(list_length(vals))));
         for (; !minim_nullp(vals); vals = minim_cdr(vals)) {
@@ -310,7 +581,7 @@ static mobj compile_mvvalues(mobj expr, mobj env, int tailp) {
             list_set_tail(ins, Mlist1(Mlist1(push_symbol)));
         }
 
-        list_set_tail(ins, Mlist2(Mlist1(do_values_symbol), Mlist1(clear_frame_symbol)));
+        list_set_tail(ins, Mlist2(Mlist2(do_values_symbol, base), Mlist2(clear_frame_symbol, base)));
     }
 
     return with_tail_ret(ins, tailp);
@@ -376,16 +647,143 @@ static mobj compile_if(mobj expr, mobj env, int tailp) {
     return ins;
 }
 
+static mobj compile_lookup(mobj id, mobj env, int tailp) {
+    mobj ins;
+    size_t idx;
+
+    switch (scope_cenv_lookup(env, id, &idx)) {
+    case VAR_TOP_LEVEL:
+        // top-level symbol
+        ins = Mlist1(Mlist2(tl_lookup_symbol, id));
+        break;
+    case VAR_CELL:
+        // mutated local symbol (or captured top-level symbol)
+        ins = Mlist1(Mlist2(lookup_symbol, Mfixnum(idx)));
+        break;
+    case VAR_LOCAL:
+        // local symbol
+        ins = Mlist1(Mlist2(local_ref_symbol, Mfixnum(idx)));
+        break;
+    default:
+        // stack symbol
+        ins = Mlist1(Mlist2(stack_ref_symbol, Mfixnum(idx)));
+        break;
+    }
+
+    return with_tail_ret(ins, tailp);
+}
+
+// Primitives applied by a dedicated instruction rather than a call.
+// Since the instructions do not check their arguments, only primitives
+// that never raise an error are included (see `compile_inline_prim`).
+typedef struct {
+    const char *name;
+    size_t argc;
+    mobj *instr;
+} inline_prim;
+
+static inline_prim inline_prims[] = {
+    { "cons", 2, &prim_cons_symbol },
+    { "$car", 1, &prim_car_symbol },
+    { "$cdr", 1, &prim_cdr_symbol },
+    { "eq?", 2, &prim_eq_symbol },
+    { "null?", 1, &prim_nullp_symbol },
+    { "pair?", 1, &prim_pairp_symbol },
+    { "not", 1, &prim_not_symbol },
+    { "fixnum?", 1, &prim_fixnump_symbol },
+    { "$fx2+", 2, &prim_fx_add_symbol },
+    { "$fx2-", 2, &prim_fx_sub_symbol },
+    { "$fx2=", 2, &prim_fx_eq_symbol },
+    { "$fx2<", 2, &prim_fx_lt_symbol },
+    { "$fx2>", 2, &prim_fx_gt_symbol },
+    { "$vector-ref", 2, &prim_vector_ref_symbol },
+    { NULL, 0, NULL }
+};
+
+// Returns the inlined primitive applied by `expr` (if any):
+// the operator must be a top-level reference to the primitive
+// from the base environment with the correct number of arguments.
+static inline_prim *find_inline_prim(mobj expr, mobj env, size_t argc) {
+    mobj id;
+    size_t idx;
+
+    id = minim_car(expr);
+    if (minim_consp(id) && minim_car(id) == quote_symbol) {
+        // primitive inserted by the optimizer
+        for (inline_prim *p = inline_prims; p->name; p++) {
+            if (p->argc == argc && minim_cdar(top_env_find(base_env, intern(p->name))) == minim_cadr(id))
+                return p;
+        }
+
+        return NULL;
+    } else if (!minim_symbolp(id)) {
+        return NULL;
+    }
+
+    switch (scope_cenv_lookup(env, id, &idx)) {
+    case VAR_TOP_LEVEL:
+    case VAR_CELL:
+        break;
+    default:
+        // definitely a local variable
+        return NULL;
+    }
+
+    for (inline_prim *p = inline_prims; p->name; p++) {
+        if (p->argc == argc && strcmp(minim_symbol(id), p->name) == 0)
+            return p;
+    }
+
+    return NULL;
+}
+
+// Compiles an application of an inlined primitive. Arguments are pushed
+// as for a call, but the operator is evaluated last and checked against
+// the primitive when the instruction is executed: if the binding has been
+// redefined, the instruction calls the operator instead.
+//
+// Unlike `compile_app`, the operator is evaluated after the arguments, so
+// an argument that rebinds the operator affects this call. The evaluation
+// order of an application is unspecified in Scheme; evaluating the
+// operator last keeps it in %res for the guard without a stack slot.
+static mobj compile_inline_prim(mobj expr, mobj env, inline_prim *p, int tailp) {
+    mobj ins, it, prim;
+
+    prim = minim_cdar(top_env_find(base_env, intern(p->name)));
+    ins = Mlist1(Mlist2(check_stack_symbol, Mfixnum(p->argc)));
+    for (it = minim_cdr(expr); !minim_nullp(it); it = minim_cdr(it)) {
+        list_set_tail(ins, compile_expr2(minim_car(it), env, 0));
+        list_set_tail(ins, Mlist1(Mlist1(push_symbol)));
+    }
+
+    list_set_tail(ins, compile_expr2(minim_car(expr), env, 0));
+    list_set_tail(ins, Mlist1(Mlist2(*p->instr, prim)));
+    return with_tail_ret(ins, tailp);
+}
+
 static mobj compile_app(mobj expr, mobj env, int tailp) {
-    mobj ins, label, it;
+    inline_prim *prim;
+    mobj ins, label, it, entry;
     size_t argc;
 
+    // call to a loop (from a tail position)
+    it = global_cenv_get_loop(scope_cenv_global_env(env), expr);
+    if (!minim_falsep(it))
+        return compile_loop_jump(expr, it, env);
+
+    // primitive applied inline
+    argc = list_length(minim_cdr(expr));
+    prim = find_inline_prim(expr, env, argc);
+    if (prim != NULL)
+        return compile_inline_prim(expr, env, prim, tailp);
+
     // need to save a continuation if not in tail position
     if (tailp) {
         ins = minim_null;
     } else {
         label = scope_cenv_make_label(env);
         ins = Mlist1(Mlist2(save_cc_symbol, label));
+        scope_cenv_enter_frame(env);
     }
 
     // compute procedure
@@ -393,7 +791,6 @@ static mobj compile_app(mobj expr, mobj env, int tailp) {
     list_set_tail(ins, Mlist1(Mlist1(set_proc_symbol)));
 
     // emit stack hint
-    argc = list_length(minim_cdr(expr));
     list_set_tail(ins, Mlist1(Mlist2(check_stack_symbol, Mfixnum(argc))));
 
     // compute arguments
@@ -402,30 +799,22 @@ static mobj compile_app(mobj expr, mobj env, int tailp) {
         list_set_tail(ins, Mlist1(Mlist1(push_symbol)));
     }
 
-    // apply procedure
-    list_set_tail(ins, Mlist1(Mlist1(apply_symbol)));
-
-    // need a label to jump to if not in tail position
-    if (!tailp) {
-        list_set_tail(ins, Mlist1(label));
-    }
-
-    return ins;
-}
-
-static mobj compile_lookup(mobj id, mobj env, int tailp) {
-    mobj ins, ref;
+    // a procedure calling itself jumps to the clause directly,
+    // skipping the arity check (a tail call becomes a loop)
+    entry = scope_cenv_self_entry(env, minim_car(expr), argc);
+    it = (entry == NULL) ? Mlist1(apply_symbol) : Mlist2(brancha_symbol, entry);
 
-    ref = scope_cenv_ref(env, id);
-    if (minim_falsep(ref)) {
-        // top-level symbol
-        ins = Mlist1(Mlist2(tl_lookup_symbol, id));
+    if (tailp) {
+        // tail position: arguments replace the current frame
+        list_set_tail(ins, Mlist1(Mlist2(shift_frame_symbol, scope_cenv_frame_base(env))));
+        list_set_tail(ins, Mlist1(it));
     } else {
-        // local symbol
-        ins = Mlist1(Mlist2(lookup_symbol, ref));
+        // need a label to jump to if not in tail position
+        list_set_tail(ins, Mlist2(it, label));
+        scope_cenv_exit_frame(env);
     }
 
-    return with_tail_ret(ins, tailp);
+    return ins;
 }
 
 static mobj compile_literal(mobj expr, int tailp) {
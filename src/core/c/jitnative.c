@@ -0,0 +1,425 @@
+// jitnative.c: native code generation
+
+#include "../minim.h"
+
+#if defined(MINIM_X86_64)
+
+//
+//  x86-64 backend
+//
+//  Native code is generated from the instruction stream of a code
+//  object once it is hot (see `native_threshold`). Most instructions
+//  are either emitted inline or call into the interpreter's helper
+//  procedures (see `native_helper`). Any other instruction, e.g.,
+//  `apply` or `ret`, returns to the interpreter with the address
+//  of that instruction, so the interpreter handles all transfers
+//  of control between code objects.
+//
+//  The interpreter may enter native code at any `entry` instruction.
+//  Each entry is a stub that saves callee-saved registers before
+//  falling through to the next instruction; the stub is skipped
+//  when reached from native code.
+//
+//  Registers:
+//   %rbx - thread context
+//   %r12 - temporary registers
+//   %rax, %rcx - scratch
+//
+
+// thread context offsets (see `Thread context` in minim.h)
+#define tc_ac_offset        0
+#define tc_cp_offset        ptr_size
+#define tc_sfp_offset       (2 * ptr_size)
+#define tc_env_offset       (4 * ptr_size)
+#define tc_tenv_offset      (21 * ptr_size)
+#define tc_lfp_offset       (22 * ptr_size)
+
+// upper bound on the size of each instruction or entry stub
+// (per word of the instruction)
+#define native_instr_max    32
+#define native_header_size  (2 * ptr_size)
+#define native_page_size    4096
+
+#define native_size(p)      (*((size_t*) (p)))
+#define native_code(p)      ((mbyte*) ptr_add(p, native_header_size))
+
+// registers
+#define REG_RAX     0
+#define REG_RCX     1
+
+typedef struct {
+    mbyte *buf;
+    size_t len;
+} native_buffer;
+
+static void emit1(native_buffer *b, mbyte x) {
+    b->buf[b->len++] = x;
+}
+
+static void emit4(native_buffer *b, uint32_t x) {
+    memcpy(&b->buf[b->len], &x, sizeof(uint32_t));
+    b->len += sizeof(uint32_t);
+}
+
+static void emit8(native_buffer *b, uint64_t x) {
+    memcpy(&b->buf[b->len], &x, sizeof(uint64_t));
+    b->len += sizeof(uint64_t);
+}
+
+// mov <reg>, imm64
+static void emit_mov_imm(native_buffer *b, int reg, uint64_t x) {
+    emit1(b, 0x48);
+    emit1(b, 0xB8 + reg);
+    emit8(b, x);
+}
+
+// mov %rax, [%r12 + disp32]
+static void emit_load_treg(native_buffer *b, size_t idx) {
+    emit1(b, 0x49); emit1(b, 0x8B); emit1(b, 0x84); emit1(b, 0x24);
+    emit4(b, idx * ptr_size);
+}
+
+// mov [%r12 + disp32], %rax
+static void emit_store_treg(native_buffer *b, size_t idx) {
+    emit1(b, 0x49); emit1(b, 0x89); emit1(b, 0x84); emit1(b, 0x24);
+    emit4(b, idx * ptr_size);
+}
+
+// mov <reg>, [%rbx + disp32]
+static void emit_load_tc(native_buffer *b, int reg, size_t offset) {
+    emit1(b, 0x48); emit1(b, 0x8B); emit1(b, 0x83 | (reg << 3));
+    emit4(b, offset);
+}
+
+// mov [%rbx + disp32], %rax
+static void emit_store_tc(native_buffer *b, size_t offset) {
+    emit1(b, 0x48); emit1(b, 0x89); emit1(b, 0x83);
+    emit4(b, offset);
+}
+
+// mov qword [%rbx + disp32], imm32
+static void emit_set_tc(native_buffer *b, size_t offset, uint32_t x) {
+    emit1(b, 0x48); emit1(b, 0xC7); emit1(b, 0x83);
+    emit4(b, offset);
+    emit4(b, x);
+}
+
+// %rax <- stack frame slot
+static void emit_load_arg(native_buffer *b, size_t idx) {
+    emit_load_tc(b, REG_RCX, tc_sfp_offset);
+    emit1(b, 0x48); emit1(b, 0x8B); emit1(b, 0x81);
+    emit4(b, (frame_header_size + idx) * ptr_size);
+}
+
+// stack frame slot <- %rax
+static void emit_store_arg(native_buffer *b, size_t idx) {
+    emit_load_tc(b, REG_RCX, tc_sfp_offset);
+    emit1(b, 0x48); emit1(b, 0x89); emit1(b, 0x81);
+    emit4(b, (frame_header_size + idx) * ptr_size);
+}
+
+// %rax <- environment slot
+static void emit_load_local(native_buffer *b, size_t idx) {
+    emit_load_tc(b, REG_RCX, tc_env_offset);
+    emit1(b, 0x48); emit1(b, 0x8B); emit1(b, 0x81);
+    emit4(b, (1 + idx) * ptr_size);
+}
+
+// %rax <- slot of the locals
+static void emit_load_stack(native_buffer *b, size_t idx) {
+    emit_load_tc(b, REG_RCX, tc_lfp_offset);
+    emit1(b, 0x48); emit1(b, 0x8B); emit1(b, 0x81);
+    emit4(b, idx * ptr_size);
+}
+
+// %rax <- register
+static void emit_load_reg(native_buffer *b, size_t idx) {
+    switch (idx) {
+    case cp_reg_idx:
+        emit_load_tc(b, REG_RAX, tc_cp_offset);
+        break;
+    case ac_reg_idx:
+        emit_load_tc(b, REG_RAX, tc_ac_offset);
+        break;
+    default:
+        emit_load_treg(b, idx);
+        break;
+    }
+}
+
+// register <- %rax
+static void emit_store_reg(native_buffer *b, size_t idx) {
+    switch (idx) {
+    case cp_reg_idx:
+        emit_store_tc(b, tc_cp_offset);
+        break;
+    case ac_reg_idx:
+        emit_store_tc(b, tc_ac_offset);
+        break;
+    default:
+        emit_store_treg(b, idx);
+        break;
+    }
+}
+
+// cmp %rax, %rcx
+static void emit_cmp(native_buffer *b) {
+    emit1(b, 0x48); emit1(b, 0x39); emit1(b, 0xC8);
+}
+
+// cmp %rcx, [%r12 + disp32]
+static void emit_cmp_treg(native_buffer *b, size_t idx) {
+    emit1(b, 0x49); emit1(b, 0x3B); emit1(b, 0x8C); emit1(b, 0x24);
+    emit4(b, idx * ptr_size);
+}
+
+// jmp/jcc rel32 (returns position of the displacement)
+static size_t emit_jump(native_buffer *b, mbyte cc) {
+    if (cc == 0) {
+        emit1(b, 0xE9);
+    } else {
+        emit1(b, 0x0F);
+        emit1(b, cc);
+    }
+
+    emit4(b, 0);
+    return b->len - sizeof(uint32_t);
+}
+
+// calls `fn(tc, tregs, ins)`
+static void emit_helper_call(native_buffer *b, void *fn, mobj *ins) {
+    emit1(b, 0x48); emit1(b, 0x89); emit1(b, 0xDF);     // mov %rdi, %rbx
+    emit1(b, 0x4C); emit1(b, 0x89); emit1(b, 0xE6);     // mov %rsi, %r12
+    emit1(b, 0x48); emit1(b, 0xBA); emit8(b, (muptr) ins);     // mov %rdx, ins
+    emit_mov_imm(b, REG_RAX, (muptr) fn);
+    emit1(b, 0xFF); emit1(b, 0xD0);                     // call %rax
+}
+
+// %res <- top-level variable, inline if the cache of the reference
+// holds a bound cell of the current environment, otherwise by `fn`
+static void emit_tl_lookup(native_buffer *b, void *fn, mobj *ins) {
+    size_t miss, unbound, done;
+
+    emit_mov_imm(b, REG_RAX, (muptr) ins[2]);
+    emit_load_tc(b, REG_RCX, tc_tenv_offset);
+    emit1(b, 0x48); emit1(b, 0x39); emit1(b, 0x48); emit1(b, ptr_size);         // cmp [%rax + 8], %rcx
+    emit1(b, 0x75); miss = b->len; emit1(b, 0);                                 // jne miss
+    emit1(b, 0x48); emit1(b, 0x8B); emit1(b, 0x40); emit1(b, 2 * ptr_size);     // mov %rax, [%rax + 16] (cell)
+    emit1(b, 0x48); emit1(b, 0x8B); emit1(b, 0x40); emit1(b, 2 * ptr_size);     // mov %rax, [%rax + 16] (value)
+    emit1(b, 0x48); emit1(b, 0x3D); emit4(b, (uint32_t) (muptr) minim_unbound); // cmp %rax, unbound
+    emit1(b, 0x74); unbound = b->len; emit1(b, 0);                              // je miss
+    emit_store_treg(b, res_reg_idx);
+    emit1(b, 0xEB); done = b->len; emit1(b, 0);                                 // jmp done
+
+    b->buf[miss] = b->len - (miss + 1);
+    b->buf[unbound] = b->len - (unbound + 1);
+    emit_helper_call(b, fn, ins);
+    b->buf[done] = b->len - (done + 1);
+}
+
+// entry stub: saves callee-saved registers and loads
+// the thread context and temporary registers
+static void emit_entry(native_buffer *b) {
+    emit1(b, 0x53);                                     // push %rbx
+    emit1(b, 0x41); emit1(b, 0x54);                     // push %r12
+    emit1(b, 0x41); emit1(b, 0x55);                     // push %r13 (alignment)
+    emit1(b, 0x48); emit1(b, 0x89); emit1(b, 0xFB);     // mov %rbx, %rdi
+    emit1(b, 0x49); emit1(b, 0x89); emit1(b, 0xF4);     // mov %r12, %rsi
+}
+
+#define entry_stub_size     11
+
+// exit stub: restores callee-saved registers and returns
+// to the interpreter (address of the next instruction in %rax)
+static void emit_exit(native_buffer *b) {
+    emit1(b, 0x41); emit1(b, 0x5D);                     // pop %r13
+    emit1(b, 0x41); emit1(b, 0x5C);                     // pop %r12
+    emit1(b, 0x5B);                                     // pop %rbx
+    emit1(b, 0xC3);                                     // ret
+}
+
+static void native_dtor(void *ptr, void *data) {
+    void *page = minim_code_native((mobj) ptr);
+    free_page(page, native_size(page));
+}
+
+static int valid_regp(mobj idx) {
+    return (muptr) idx <= ac_reg_idx;
+}
+
+void write_native(mobj code) {
+    native_buffer b;
+    mobj *istream;
+    size_t *offsets, *fixups, *targets, *exits;
+    size_t len, size, nfixups, nexits, i;
+    void *page;
+
+    // allocate executable memory
+    istream = minim_code_it(code);
+    len = minim_code_len(code);
+    size = native_header_size + native_instr_max * (len + 2);
+    size = native_page_size * ((size + native_page_size - 1) / native_page_size);
+    page = alloc_page(size);
+    native_size(page) = size;
+    b.buf = native_code(page);
+    b.len = 0;
+
+    // native offset of each instruction and any jumps to patch
+    offsets = GC_alloc_atomic((len + 1) * sizeof(size_t));
+    fixups = GC_alloc_atomic(len * sizeof(size_t));
+    targets = GC_alloc_atomic(len * sizeof(size_t));
+    exits = GC_alloc_atomic(len * sizeof(size_t));
+    nfixups = 0;
+    nexits = 0;
+
+    for (i = 0; i < len; i += 1 + opcode_operands((opcode_type) (muptr) istream[i])) {
+        opcode_type op;
+        mobj *ins;
+        void *fn;
+        mbyte cc;
+
+        ins = &istream[i];
+        op = (opcode_type) (muptr) ins[0];
+        offsets[i] = b.len;
+
+        switch (op) {
+        case OP_ENTRY:
+            // jmp over stub
+            emit1(&b, 0xEB);
+            emit1(&b, entry_stub_size);
+            emit_entry(&b);
+            break;
+        case OP_LITERAL:
+            emit_mov_imm(&b, REG_RAX, (muptr) ins[1]);
+            emit_store_treg(&b, res_reg_idx);
+            break;
+        case OP_MOV:
+            if (!valid_regp(ins[1]) || !valid_regp(ins[2]))
+                goto exit;
+            emit_load_reg(&b, (muptr) ins[2]);
+            emit_store_reg(&b, (muptr) ins[1]);
+            break;
+        case OP_GET_ARG:
+            if (!valid_regp(ins[1]))
+                goto exit;
+            emit_load_arg(&b, (muptr) ins[2]);
+            emit_store_reg(&b, (muptr) ins[1]);
+            break;
+        case OP_LOCAL_REF:
+            emit_load_local(&b, (muptr) ins[1]);
+            emit_store_treg(&b, res_reg_idx);
+            break;
+        case OP_STACK_REF:
+            emit_load_stack(&b, (muptr) ins[1]);
+            emit_store_treg(&b, res_reg_idx);
+            break;
+        case OP_TL_LOOKUP:
+            emit_tl_lookup(&b, native_helper(op), ins);
+            break;
+        case OP_SET_ARG:
+            if (!valid_regp(ins[2]))
+                goto exit;
+            emit_load_reg(&b, (muptr) ins[2]);
+            emit_store_arg(&b, (muptr) ins[1]);
+            break;
+        case OP_CLEAR_FRAME:
+            emit_set_tc(&b, tc_cp_offset, 0);
+            emit_set_tc(&b, tc_ac_offset, (muptr) ins[1]);
+            break;
+        case OP_BRANCHA:
+            fixups[nfixups] = emit_jump(&b, 0);
+            targets[nfixups++] = i + (mfixnum) ins[1];
+            break;
+        case OP_BRANCHF:
+            emit_load_treg(&b, res_reg_idx);
+            emit_mov_imm(&b, REG_RCX, (muptr) minim_false);
+            emit_cmp(&b);
+            fixups[nfixups] = emit_jump(&b, 0x84);      // je
+            targets[nfixups++] = i + (mfixnum) ins[1];
+            break;
+        case OP_BRANCHGT:
+        case OP_BRANCHLT:
+        case OP_BRANCHNE:
+            cc = (op == OP_BRANCHGT) ? 0x8F : ((op == OP_BRANCHLT) ? 0x8C : 0x85);
+            emit_load_treg(&b, res_reg_idx);
+            emit_mov_imm(&b, REG_RCX, (muptr) ins[1]);
+            emit_cmp(&b);
+            fixups[nfixups] = emit_jump(&b, cc);        // jg/jl/jne
+            targets[nfixups++] = i + (mfixnum) ins[2];
+            break;
+        case OP_PRIM_CONS:
+        case OP_PRIM_CAR:
+        case OP_PRIM_CDR:
+        case OP_PRIM_EQ:
+        case OP_PRIM_NULLP:
+        case OP_PRIM_PAIRP:
+        case OP_PRIM_NOT:
+        case OP_PRIM_FIXNUMP:
+        case OP_PRIM_FX_ADD:
+        case OP_PRIM_FX_SUB:
+        case OP_PRIM_FX_EQ:
+        case OP_PRIM_FX_LT:
+        case OP_PRIM_FX_GT:
+        case OP_PRIM_VECTOR_REF:
+            // the interpreter calls the operator if it is not the primitive
+            emit_mov_imm(&b, REG_RCX, (muptr) ins[1]);
+            emit_cmp_treg(&b, res_reg_idx);
+            emit1(&b, 0x74); emit1(&b, 15);             // je over exit
+            emit_mov_imm(&b, REG_RAX, (muptr) ins);
+            exits[nexits++] = emit_jump(&b, 0);
+            emit_helper_call(&b, native_helper(op), ins);
+            break;
+        default:
+            fn = native_helper(op);
+            if (fn == NULL)
+                goto exit;
+            emit_helper_call(&b, fn, ins);
+            break;
+        }
+
+        continue;
+
+exit:
+        // return to the interpreter at this instruction
+        emit_mov_imm(&b, REG_RAX, (muptr) ins);
+        exits[nexits++] = emit_jump(&b, 0);
+    }
+
+    // terminator
+    offsets[i] = b.len;
+    emit_mov_imm(&b, REG_RAX, (muptr) &istream[i]);
+    exits[nexits++] = emit_jump(&b, 0);
+
+    // shared exit
+    size = b.len;
+    emit_exit(&b);
+
+    // patch jumps
+    for (i = 0; i < nfixups; i++) {
+        uint32_t rel = offsets[targets[i]] - (fixups[i] + sizeof(uint32_t));
+        memcpy(&b.buf[fixups[i]], &rel, sizeof(uint32_t));
+    }
+
+    for (i = 0; i < nexits; i++) {
+        uint32_t rel = size - (exits[i] + sizeof(uint32_t));
+        memcpy(&b.buf[exits[i]], &rel, sizeof(uint32_t));
+    }
+
+    make_page_executable(page, native_size(page));
+
+    // update entry points
+    minim_code_native(code) = page;
+    GC_register_dtor(code, native_dtor);
+    for (i = 0; i < len; i += 1 + opcode_operands((opcode_type) (muptr) istream[i])) {
+        if ((opcode_type) (muptr) istream[i] == OP_ENTRY)
+            istream[i + 1] = &b.buf[offsets[i] + 2];
+    }
+}
+
+#else
+
+void write_native(mobj code) {
+    // not supported: always interpret
+}
+
+#endif
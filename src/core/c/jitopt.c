@@ -621,3 +621,717 @@ mobj jit_opt_L2(mobj expr) {
         return expr;
     }
 }
+
+// L3 optimization: simplification
+//  - `if` expressions with a literal test are replaced by a branch
+//  - system primitives applied to fixnum literals are folded
+//  - `mv-let` bindings to literals or immutable local variables are propagated
+//  - procedures bound by `mv-let` that are only ever applied are inlined
+//  - small top-level procedures are inlined at call sites (see `jit_register_inline`)
+//  - unused bindings and pure expressions in sequences are eliminated
+// Variables are compared by name: a variable that is assigned anywhere
+// in the expression is never propagated, and a substitution is abandoned
+// if the body rebinds any variable that it involves.
+
+// Maximum size of a procedure (in pairs) that is inlined at multiple sites
+#define L3_inline_size_max      16
+// Maximum size of a top-level procedure (in pairs) that is inlined
+#define L3_inline_tl_size_max   40
+// Maximum depth of top-level procedures inlined within each other
+#define L3_inline_depth_max     1
+
+static int inline_depth = 0;
+
+typedef struct {
+    const char *name;
+    mobj (*fn)(mobj, mobj);
+    int (*overflowp)(mobj, mobj);
+} fold_prim;
+
+// System primitives that may be folded (fixnum arguments only).
+// Folds that would overflow are left for the runtime to report.
+static fold_prim fold_prims[] = {
+    { "$fx2+", fx2_add, fx2_add_overflowp },
+    { "$fx2-", fx2_sub, fx2_sub_overflowp },
+    { "$fx2*", fx2_mul, fx2_mul_overflowp },
+    { "$fx2=", fx2_eq, NULL },
+    { "$fx2<", fx2_lt, NULL },
+    { "$fx2>", fx2_gt, NULL },
+    { "$fx2<=", fx2_le, NULL },
+    { "$fx2>=", fx2_ge, NULL },
+    { NULL, NULL, NULL }
+};
+
+static mobj jit_opt_L3_expr(mobj expr, mobj env, mobj muts);
+static mobj uninline(mobj expr);
+
+// Is the top-level variable `id` still bound to the system primitive?
+static int system_primp(mobj id) {
+    mobj cell, prim;
+
+    cell = top_env_find(tc_tenv(current_tc()), id);
+    prim = top_env_find(base_env, id);
+    return !minim_falsep(cell) && !minim_falsep(prim) && minim_cdar(cell) == minim_cdar(prim);
+}
+
+// Is `expr` a literal?
+static int literalp(mobj expr) {
+    if (minim_consp(expr))
+        return minim_car(expr) == quote_symbol;
+    return !minim_symbolp(expr);
+}
+
+// Value of a literal
+static mobj literal_value(mobj expr) {
+    return minim_consp(expr) ? minim_cadr(expr) : expr;
+}
+
+// Is `expr` a `lambda` expression with fixed arity?
+static int simple_lambdap(mobj expr) {
+    return minim_consp(expr) &&
+        minim_car(expr) == lambda_symbol &&
+        minim_listp(minim_cadr(expr));
+}
+
+// Is `expr` free of side effects (including errors)?
+static int purep(mobj expr, mobj env) {
+    if (minim_symbolp(expr)) {
+        return !minim_falsep(memq(env, expr));
+    } else if (minim_consp(expr)) {
+        mobj head = minim_car(expr);
+        return head == quote_symbol
+            || head == quote_syntax_symbol
+            || head == lambda_symbol
+            || head == case_lambda_symbol
+            || head == make_unbound_symbol;
+    } else {
+        return 1;
+    }
+}
+
+// Extends `env` with the identifiers of `formals`
+static mobj extend_env(mobj formals, mobj env) {
+    for (; minim_consp(formals); formals = minim_cdr(formals))
+        env = Mcons(minim_car(formals), env);
+    if (minim_symbolp(formals))
+        env = Mcons(formals, env);
+    return env;
+}
+
+// Collects variables that are assigned or defined within `expr`
+static void assigned_vars(mobj expr, mobj table) {
+    mobj head;
+    if (minim_consp(expr)) {
+        head = minim_car(expr);
+        if (head == quote_symbol || head == quote_syntax_symbol) {
+            return;
+        } else if (head == setb_symbol) {
+            minim_unbox(table) = Mcons(minim_cadr(expr), minim_unbox(table));
+        } else if (head == define_values_symbol) {
+            minim_unbox(table) = extend_env(minim_cadr(expr), minim_unbox(table));
+        }
+
+        for (; minim_consp(expr); expr = minim_cdr(expr))
+            assigned_vars(minim_car(expr), table);
+    }
+}
+
+// Collects variables that are bound within `expr`
+static void bound_vars(mobj expr, mobj table) {
+    mobj head, clauses;
+    if (minim_consp(expr)) {
+        head = minim_car(expr);
+        if (head == quote_symbol || head == quote_syntax_symbol) {
+            return;
+        } else if (head == lambda_symbol || head == define_values_symbol) {
+            minim_unbox(table) = extend_env(minim_cadr(expr), minim_unbox(table));
+        } else if (head == case_lambda_symbol) {
+            for (clauses = minim_cdr(expr); minim_consp(clauses); clauses = minim_cdr(clauses))
+                minim_unbox(table) = extend_env(minim_caar(clauses), minim_unbox(table));
+        } else if (head == mvlet_symbol && minim_consp(minim_cddr(expr))) {
+            minim_unbox(table) = extend_env(minim_car(minim_cddr(expr)), minim_unbox(table));
+        }
+
+        for (; minim_consp(expr); expr = minim_cdr(expr))
+            bound_vars(minim_car(expr), table);
+    }
+}
+
+// Collects the symbols within `expr` that are not bound within `expr`
+// or by `bound`: its free variables and names of special forms
+static void free_symbols(mobj expr, mobj bound, mobj table) {
+    mobj head, clauses, body;
+
+    if (minim_symbolp(expr)) {
+        if (minim_falsep(memq(bound, expr)))
+            minim_unbox(table) = Mcons(expr, minim_unbox(table));
+    } else if (minim_consp(expr)) {
+        head = minim_car(expr);
+        if (head == quote_symbol || head == quote_syntax_symbol) {
+            return;
+        } else if (head == lambda_symbol && minim_consp(minim_cdr(expr))) {
+            body = minim_cddr(expr);
+            bound = extend_env(minim_cadr(expr), bound);
+            for (; minim_consp(body); body = minim_cdr(body))
+                free_symbols(minim_car(body), bound, table);
+            return;
+        } else if (head == case_lambda_symbol) {
+            for (clauses = minim_cdr(expr); minim_consp(clauses); clauses = minim_cdr(clauses)) {
+                body = minim_cdar(clauses);
+                for (; minim_consp(body); body = minim_cdr(body))
+                    free_symbols(minim_car(body), extend_env(minim_caar(clauses), bound), table);
+            }
+            return;
+        } else if (head == mvlet_symbol && list_length(expr) == 4) {
+            free_symbols(minim_cadr(expr), bound, table);
+            free_symbols(minim_cadr(minim_cddr(expr)), extend_env(minim_car(minim_cddr(expr)), bound), table);
+            return;
+        }
+
+        for (; minim_consp(expr); expr = minim_cdr(expr))
+            free_symbols(minim_car(expr), bound, table);
+        free_symbols(expr, bound, table);
+    }
+}
+
+// Number of references to `id` within `expr`.
+// References in operator position are also counted in `ops`.
+static size_t count_refs(mobj expr, mobj id, size_t *ops) {
+    mobj head;
+    size_t n;
+
+    if (minim_consp(expr)) {
+        head = minim_car(expr);
+        if (head == quote_symbol || head == quote_syntax_symbol)
+            return 0;
+        if (head == id)
+            *ops += 1;
+
+        n = 0;
+        for (; minim_consp(expr); expr = minim_cdr(expr))
+            n += count_refs(minim_car(expr), id, ops);
+        return n + count_refs(expr, id, ops);
+    } else {
+        return expr == id ? 1 : 0;
+    }
+}
+
+// Size of `expr` in pairs
+static size_t expr_size(mobj expr) {
+    size_t n = 0;
+    for (; minim_consp(expr); expr = minim_cdr(expr))
+        n += 1 + expr_size(minim_car(expr));
+    return n;
+}
+
+// Replaces every reference to `id` within `expr` with `v`.
+// Assumes that `id` is not bound or assigned within `expr`.
+static mobj substitute(mobj expr, mobj id, mobj v) {
+    mobj head, hd, tl;
+
+    if (minim_consp(expr)) {
+        head = minim_car(expr);
+        if (head == quote_symbol || head == quote_syntax_symbol)
+            return expr;
+
+        hd = tl = Mcons(substitute(head, id, v), minim_null);
+        for (expr = minim_cdr(expr); minim_consp(expr); expr = minim_cdr(expr)) {
+            minim_cdr(tl) = Mcons(substitute(minim_car(expr), id, v), minim_null);
+            tl = minim_cdr(tl);
+        }
+
+        minim_cdr(tl) = substitute(expr, id, v);
+        return hd;
+    } else {
+        return expr == id ? v : expr;
+    }
+}
+
+// Do the lists `xs` and `ys` share an element?
+static int intersectp(mobj xs, mobj ys) {
+    for (; !minim_nullp(xs); xs = minim_cdr(xs)) {
+        if (!minim_falsep(memq(ys, minim_car(xs))))
+            return 1;
+    }
+
+    return 0;
+}
+
+// Is `expr` the guard of an inlined procedure (see `jit_opt_L3_inline`)?
+static int inline_guardp(mobj expr) {
+    return minim_consp(expr) &&
+        minim_consp(minim_car(expr)) &&
+        minim_car(minim_car(expr)) == quote_symbol &&
+        minim_cadr(minim_car(expr)) == minim_cdar(top_env_find(base_env, intern("eq?")));
+}
+
+// L3 optimization for sequences: nested `begin` expressions are
+// flattened and pure expressions not in tail position are removed
+static mobj jit_opt_L3_seq(mobj exprs, mobj env, mobj muts) {
+    mobj hd, tl, expr, es;
+
+    hd = tl = Mcons(minim_null, minim_null);
+    for (; !minim_nullp(exprs); exprs = minim_cdr(exprs)) {
+        expr = jit_opt_L3_expr(minim_car(exprs), env, muts);
+        es = (minim_consp(expr) && minim_car(expr) == begin_symbol)
+            ? minim_cdr(expr)
+            : Mlist1(expr);
+
+        for (; !minim_nullp(es); es = minim_cdr(es)) {
+            if (minim_nullp(minim_cdr(es)) && minim_nullp(minim_cdr(exprs))) {
+                // tail position
+                minim_cdr(tl) = Mlist1(minim_car(es));
+                tl = minim_cdr(tl);
+            } else if (!purep(minim_car(es), env)) {
+                minim_cdr(tl) = Mlist1(minim_car(es));
+                tl = minim_cdr(tl);
+            }
+        }
+    }
+
+    return minim_cdr(hd);
+}
+
+// L3 optimization for `begin`
+static mobj jit_opt_L3_begin(mobj expr, mobj env, mobj muts) {
+    mobj exprs = jit_opt_L3_seq(minim_cdr(expr), env, muts);
+    if (minim_nullp(exprs)) {
+        return expr;
+    } else if (minim_nullp(minim_cdr(exprs))) {
+        return minim_car(exprs);
+    } else {
+        return Mcons(begin_symbol, exprs);
+    }
+}
+
+// L3 optimization for `case-lambda`
+static mobj jit_opt_L3_case_lambda(mobj expr, mobj env, mobj muts) {
+    mobj hd, tl, clauses, clause;
+
+    hd = tl = Mcons(minim_car(expr), minim_null);
+    for (clauses = minim_cdr(expr); !minim_nullp(clauses); clauses = minim_cdr(clauses)) {
+        clause = minim_car(clauses);
+        minim_cdr(tl) = Mlist1(Mcons(
+            minim_car(clause),
+            jit_opt_L3_seq(minim_cdr(clause), extend_env(minim_car(clause), env), muts)
+        ));
+        tl = minim_cdr(tl);
+    }
+
+    return hd;
+}
+
+// Returns the source of the procedure bound to the top-level variable `id`
+// if it may be inlined at a call site with `argc` arguments and local
+// variables `env`, and `#f` otherwise. The procedure is stored in `proc`.
+static mobj inlinable_proc(mobj id, size_t argc, mobj env, mobj *proc) {
+    mobj cell, entry, lambda, syms;
+
+    cell = top_env_find(tc_tenv(current_tc()), id);
+    if (minim_falsep(cell) || !minim_closurep(minim_cdar(cell)))
+        return minim_false;
+
+    *proc = minim_cdar(cell);
+    entry = eq_hashtable_find(inline_procs, minim_closure_code(*proc));
+    if (minim_falsep(entry))
+        return minim_false;
+
+    // top-level variables of the procedure must refer to the same bindings
+    entry = minim_cdr(entry);
+    if (minim_cdr(entry) != tc_tenv(current_tc()))
+        return minim_false;
+
+    lambda = minim_car(entry);
+    if (list_length(minim_cadr(lambda)) != argc)
+        return minim_false;
+
+    // and must not be captured at the call site
+    syms = Mbox(minim_null);
+    free_symbols(lambda, minim_null, syms);
+    if (intersectp(minim_unbox(syms), env))
+        return minim_false;
+
+    return lambda;
+}
+
+// Inlines the application `expr` of a top-level procedure `proc` with
+// source `lambda`. The inlined body is guarded by a check that the
+// variable is still bound to `proc`:
+// `(f e ...)`
+//  => `(mv-let (values e ...) (t ...)
+//        (if (eq? f 'proc) ((lambda (x ...) body ...) t ...) (f t ...)))`
+static mobj jit_opt_L3_inline(mobj expr, mobj proc, mobj lambda, mobj env, mobj muts) {
+    mobj args, tmps, eq, guard, assigned;
+
+    // variables assigned by the inlined body must not be propagated
+    assigned = Mbox(muts);
+    assigned_vars(lambda, assigned);
+    muts = minim_unbox(assigned);
+
+    args = minim_cdr(expr);
+    tmps = make_tmp_ids(args);
+    eq = minim_cdar(top_env_find(base_env, intern("eq?")));
+    guard = Mlist3(Mlist2(quote_symbol, eq), minim_car(expr), Mlist2(quote_symbol, proc));
+    expr = Mlist4(if_symbol, guard, Mcons(lambda, tmps), Mcons(minim_car(expr), tmps));
+    if (minim_nullp(args)) {
+        // no arguments to bind
+    } else if (minim_nullp(minim_cdr(args))) {
+        expr = Mlist4(mvlet_symbol, minim_car(args), tmps, expr);
+    } else {
+        expr = Mlist4(mvlet_symbol, Mcons(values_symbol, args), tmps, expr);
+    }
+
+    return jit_opt_L3_expr(jit_opt_L2(expr), env, muts);
+}
+
+// L3 optimization for `application`
+static mobj jit_opt_L3_app(mobj expr, mobj env, mobj muts) {
+    mobj hd, tl, args;
+
+    hd = tl = Mcons(jit_opt_L3_expr(minim_car(expr), env, muts), minim_null);
+    for (args = minim_cdr(expr); !minim_nullp(args); args = minim_cdr(args)) {
+        minim_cdr(tl) = Mlist1(jit_opt_L3_expr(minim_car(args), env, muts));
+        tl = minim_cdr(tl);
+    }
+
+    // fold system primitives, unless the name is bound, assigned, or redefined
+    if (minim_symbolp(minim_car(hd)) &&
+        list_length(hd) == 3 &&
+        minim_falsep(memq(env, minim_car(hd))) &&
+        minim_falsep(memq(muts, minim_car(hd))) &&
+        system_primp(minim_car(hd))) {
+        mobj x = minim_cadr(hd), y = minim_car(minim_cddr(hd));
+        if (literalp(x) && minim_fixnump(literal_value(x)) &&
+            literalp(y) && minim_fixnump(literal_value(y))) {
+            for (fold_prim *p = fold_prims; p->name; p++) {
+                if (strcmp(minim_symbol(minim_car(hd)), p->name) == 0) {
+                    if (p->overflowp && p->overflowp(literal_value(x), literal_value(y)))
+                        break;
+                    return p->fn(literal_value(x), literal_value(y));
+                }
+            }
+        }
+    }
+
+    // inline small top-level procedures
+    if (jit_inline &&
+        inline_depth < L3_inline_depth_max &&
+        minim_symbolp(minim_car(hd)) &&
+        minim_falsep(memq(env, minim_car(hd))) &&
+        minim_falsep(memq(muts, minim_car(hd)))) {
+        mobj proc, lambda;
+        lambda = inlinable_proc(minim_car(hd), list_length(minim_cdr(hd)), env, &proc);
+        if (!minim_falsep(lambda))
+            return jit_opt_L3_inline(hd, proc, lambda, env, muts);
+    }
+
+    return hd;
+}
+
+// Can a reference to `id` within `body` be replaced by `expr`?
+// `bound` is every variable bound within `body` and `ids`
+// are the variables bound along with `id`.
+static int propagatep(mobj id, mobj expr, mobj body, mobj bound, mobj ids, mobj env, mobj muts) {
+    mobj syms;
+    size_t refs, ops;
+
+    if (!minim_falsep(memq(muts, id)) || !minim_falsep(memq(bound, id)))
+        return 0;
+
+    if (expr == id) {
+        // rebinding to itself
+        return 1;
+    } else if (minim_symbolp(expr)) {
+        // immutable local variable
+        return !minim_falsep(memq(env, expr))
+            && minim_falsep(memq(muts, expr))
+            && minim_falsep(memq(bound, expr))
+            && minim_falsep(memq(ids, expr));
+    } else if (literalp(expr)) {
+        // literal
+        return 1;
+    } else if (jit_inline && simple_lambdap(expr)) {
+        // procedure that is only ever applied: either a single time,
+        // or it is small enough to be copied
+        ops = 0;
+        refs = count_refs(body, id, &ops);
+        if (refs == 0 || refs != ops)
+            return 0;
+        if (refs > 1 && expr_size(uninline(expr)) > L3_inline_size_max)
+            return 0;
+
+        // no free variable of the procedure may be captured
+        syms = Mbox(minim_null);
+        free_symbols(expr, minim_null, syms);
+        return !intersectp(minim_unbox(syms), bound) && !intersectp(minim_unbox(syms), ids);
+    } else {
+        return 0;
+    }
+}
+
+// Substitutes each binding of `ids` to `args` into `body` when possible.
+// The remaining bindings are left in `ids` and `args`. The flag `substp`
+// is set if any substitution was made and `inlinep` if a procedure was
+// substituted. Returns the new body.
+static mobj propagate_bindings(mobj *ids, mobj *args, mobj body, mobj env, mobj muts, int *substp, int *inlinep) {
+    mobj bound, id, arg, table, is, as;
+    mobj ids_hd, ids_tl, args_hd, args_tl;
+
+    table = Mbox(minim_null);
+    bound_vars(body, table);
+    bound = minim_unbox(table);
+
+    ids_hd = ids_tl = Mcons(minim_null, minim_null);
+    args_hd = args_tl = Mcons(minim_null, minim_null);
+    for (is = *ids, as = *args; !minim_nullp(is); is = minim_cdr(is), as = minim_cdr(as)) {
+        id = minim_car(is);
+        arg = minim_car(as);
+        if (propagatep(id, arg, body, bound, *ids, env, muts)) {
+            body = substitute(body, id, arg);
+            *substp = 1;
+            if (simple_lambdap(arg)) {
+                // the body now binds the variables of the procedure
+                table = Mbox(bound);
+                bound_vars(arg, table);
+                bound = minim_unbox(table);
+                *inlinep = 1;
+            }
+        } else {
+            minim_cdr(ids_tl) = Mlist1(id);
+            minim_cdr(args_tl) = Mlist1(arg);
+            ids_tl = minim_cdr(ids_tl);
+            args_tl = minim_cdr(args_tl);
+        }
+    }
+
+    *ids = minim_cdr(ids_hd);
+    *args = minim_cdr(args_hd);
+    return body;
+}
+
+// L3 optimization for `mv-let`
+static mobj jit_opt_L3_mvlet(mobj expr, mobj env, mobj muts) {
+    mobj producer, ids, body, args, body_env;
+    mobj ids_hd, ids_tl, args_hd, args_tl;
+    int valuesp, substp, inlinep;
+
+    producer = jit_opt_L3_expr(minim_cadr(expr), env, muts);
+    ids = minim_car(minim_cddr(expr));
+    body = minim_cadr(minim_cddr(expr));
+    body_env = extend_env(ids, env);
+
+    // bindings are optimized individually if they can be matched up
+    // with expressions: either a single identifier or `values` applied
+    // to the same number of arguments
+    if (minim_listp(ids) && list_length(ids) == 1) {
+        valuesp = 0;
+        args = Mlist1(producer);
+    } else if (minim_listp(ids) &&
+               minim_consp(producer) &&
+               minim_car(producer) == values_symbol &&
+               minim_falsep(memq(env, values_symbol)) &&
+               list_length(minim_cdr(producer)) == list_length(ids)) {
+        valuesp = 1;
+        args = minim_cdr(producer);
+    } else {
+        body = jit_opt_L3_expr(body, body_env, muts);
+        return Mlist4(mvlet_symbol, producer, ids, body);
+    }
+
+    // propagate bindings into the unoptimized body
+    substp = inlinep = 0;
+    body = propagate_bindings(&ids, &args, body, env, muts, &substp, &inlinep);
+    if (inlinep)
+        // inlined procedures must be converted to `mv-let`
+        body = jit_opt_L2(body);
+    body = jit_opt_L3_expr(body, body_env, muts);
+
+    // and again, since optimizing the body may have removed obstacles
+    substp = inlinep = 0;
+    body = propagate_bindings(&ids, &args, body, env, muts, &substp, &inlinep);
+    if (inlinep)
+        body = jit_opt_L2(body);
+    if (substp)
+        body = jit_opt_L3_expr(body, body_env, muts);
+
+    // eliminate unused bindings to pure expressions
+    ids_hd = ids_tl = Mcons(minim_null, minim_null);
+    args_hd = args_tl = Mcons(minim_null, minim_null);
+    for (; !minim_nullp(ids); ids = minim_cdr(ids), args = minim_cdr(args)) {
+        size_t ops = 0;
+        if (!purep(minim_car(args), env) || count_refs(body, minim_car(ids), &ops) > 0) {
+            minim_cdr(ids_tl) = Mlist1(minim_car(ids));
+            minim_cdr(args_tl) = Mlist1(minim_car(args));
+            ids_tl = minim_cdr(ids_tl);
+            args_tl = minim_cdr(args_tl);
+        }
+    }
+
+    ids = minim_cdr(ids_hd);
+    args = minim_cdr(args_hd);
+    if (minim_nullp(ids)) {
+        return body;
+    } else if (minim_nullp(minim_cdr(ids))) {
+        return Mlist4(mvlet_symbol, minim_car(args), ids, body);
+    } else {
+        return Mlist4(mvlet_symbol, valuesp ? Mcons(values_symbol, args) : producer, ids, body);
+    }
+}
+
+// Performs L3 optimization with respect to local variables `env`
+// and variables `muts` that may be assigned
+static mobj jit_opt_L3_expr(mobj expr, mobj env, mobj muts) {
+    if (minim_consp(expr)) {
+        // special form or application
+        mobj head = minim_car(expr);
+        if (minim_symbolp(head)) {
+            // special forms
+            if (head == define_values_symbol) {
+                // define-values form
+                return Mlist3(head, minim_cadr(expr), jit_opt_L3_expr(minim_car(minim_cddr(expr)), env, muts));
+            } else if (head == setb_symbol) {
+                // set! form
+                return Mlist3(head, minim_cadr(expr), jit_opt_L3_expr(minim_car(minim_cddr(expr)), env, muts));
+            } else if (head == lambda_symbol) {
+                // lambda form
+                return Mcons(head, Mcons(
+                    minim_cadr(expr),
+                    jit_opt_L3_seq(minim_cddr(expr), extend_env(minim_cadr(expr), env), muts)
+                ));
+            } else if (head == case_lambda_symbol) {
+                // case-lambda form
+                return jit_opt_L3_case_lambda(expr, env, muts);
+            } else if (head == mvcall_symbol) {
+                // mv-call form
+                return Mlist3(
+                    head,
+                    jit_opt_L3_expr(minim_cadr(expr), env, muts),
+                    jit_opt_L3_expr(minim_car(minim_cddr(expr)), env, muts)
+                );
+            } else if (head == mvlet_symbol) {
+                // mv-let form
+                return jit_opt_L3_mvlet(expr, env, muts);
+            } else if (head == mvvalues_symbol) {
+                // mv-values form
+                mobj hd, tl, args;
+                hd = tl = Mcons(head, minim_null);
+                for (args = minim_cdr(expr); !minim_nullp(args); args = minim_cdr(args)) {
+                    minim_cdr(tl) = Mlist1(jit_opt_L3_expr(minim_car(args), env, muts));
+                    tl = minim_cdr(tl);
+                }
+                return hd;
+            } else if (head == begin_symbol) {
+                // begin form
+                return jit_opt_L3_begin(expr, env, muts);
+            } else if (head == if_symbol) {
+                // if form
+                mobj test = jit_opt_L3_expr(minim_cadr(expr), env, muts);
+                if (inline_guardp(test)) {
+                    // inlined procedure: the original call is kept as is
+                    mobj body;
+                    inline_depth += 1;
+                    body = jit_opt_L3_expr(minim_car(minim_cddr(expr)), env, muts);
+                    inline_depth -= 1;
+                    return Mlist4(if_symbol, test, body, minim_cadr(minim_cddr(expr)));
+                } else if (literalp(test)) {
+                    return jit_opt_L3_expr(
+                        minim_falsep(literal_value(test))
+                            ? minim_cadr(minim_cddr(expr))
+                            : minim_car(minim_cddr(expr)),
+                        env,
+                        muts
+                    );
+                }
+
+                return Mlist4(
+                    if_symbol,
+                    test,
+                    jit_opt_L3_expr(minim_car(minim_cddr(expr)), env, muts),
+                    jit_opt_L3_expr(minim_cadr(minim_cddr(expr)), env, muts)
+                );
+            } else if (head == quote_symbol) {
+                // quote form
+                return expr;
+            } else if (head == quote_syntax_symbol) {
+                // quote-syntax form
+                return expr;
+            } else if (head == make_unbound_symbol) {
+                // #%make-unbound form
+                return expr;
+            }
+        }
+
+        // application
+        return jit_opt_L3_app(expr, env, muts);
+    } else {
+        return expr;
+    }
+}
+
+// Perform L3 optimization
+mobj jit_opt_L3(mobj expr) {
+    mobj muts;
+    int depth;
+
+    // an error while optimizing exits without restoring `inline_depth`,
+    // so each expression starts from zero
+    depth = inline_depth;
+    inline_depth = 0;
+
+    muts = Mbox(minim_null);
+    assigned_vars(expr, muts);
+    expr = jit_opt_L3_expr(expr, minim_null, minim_unbox(muts));
+
+    inline_depth = depth;
+    return expr;
+}
+
+// Undoes the inlining of procedures within `expr` by replacing each
+// guarded body with the original call.
+static mobj uninline(mobj expr) {
+    mobj hd, tl;
+
+    if (!minim_consp(expr) || minim_car(expr) == quote_symbol || minim_car(expr) == quote_syntax_symbol)
+        return expr;
+
+    if (minim_car(expr) == if_symbol && inline_guardp(minim_cadr(expr)))
+        return uninline(minim_cadr(minim_cddr(expr)));
+
+    hd = tl = Mcons(uninline(minim_car(expr)), minim_null);
+    for (expr = minim_cdr(expr); minim_consp(expr); expr = minim_cdr(expr)) {
+        minim_cdr(tl) = Mcons(uninline(minim_car(expr)), minim_null);
+        tl = minim_cdr(tl);
+    }
+
+    minim_cdr(tl) = expr;
+    return hd;
+}
+
+// Records the top-level procedure bound to `id` with source `expr`
+// and compiled to `code` so that later calls to it may be inlined.
+// Only small procedures with fixed arity that do not refer to themselves
+// are kept. Procedures inlined into `expr` are not counted against
+// its size: the original calls are kept instead.
+void jit_register_inline(mobj id, mobj expr, mobj code) {
+    size_t ops = 0;
+
+    if (!jit_inline || !simple_lambdap(expr))
+        return;
+
+    expr = uninline(expr);
+    if (count_refs(expr, id, &ops) > 0 || expr_size(expr) > L3_inline_tl_size_max)
+        return;
+
+    eq_hashtable_set(inline_procs, code, Mcons(expr, tc_tenv(current_tc())));
+}
+
+// Forgets the procedure `proc` when the top-level variable bound
+// to it is rebound to `val`, unless `val` shares its code.
+void jit_unregister_inline(mobj proc, mobj val) {
+    if (!minim_closurep(proc))
+        return;
+    if (minim_closurep(val) && minim_closure_code(val) == minim_closure_code(proc))
+        return;
+    eq_hashtable_delete(inline_procs, minim_closure_code(proc));
+}
+
@@ -25,7 +25,7 @@ static mobj compile_do_ret(mobj name, mobj arity, mobj do_instr) {
     code = write_code(ins, reloc, arity);
 
     // return a closure
-    cl = Mclosure(base_env, code, 0);
+    cl = Mclosure(base_env, code);
     minim_closure_name(cl) = name;
     return cl;
 }
@@ -34,6 +34,35 @@ mobj compile_prim(const char *who, void *fn, mobj arity) {
     return compile_do_ret(intern(who), arity, Mlist2(ccall_symbol, Mfixnum((intptr_t) fn)));
 }
 
+// Variadic primitives are C functions `mobj (size_t argc, mobj *args)`
+// that receive the arguments of the frame without building a list.
+mobj compile_variadic_prim(const char *who, void *fn, size_t min_arity) {
+    mobj env, label, ins, reloc, code, cl;
+
+    // prepare compiler
+    env = make_cenv(make_global_cenv());
+    label = cenv_make_label(env);
+
+    // hand written procedure
+    ins = Mlist6(
+        Mlist3(mov_symbol, Mfixnum(res_reg_idx), Mfixnum(ac_reg_idx)),
+        Mlist3(branchlt_symbol, Mfixnum(min_arity), label),
+        Mlist2(ccallv_symbol, Mfixnum((intptr_t) fn)),
+        Mlist1(ret_symbol),
+        label,
+        Mlist1(do_arity_error_symbol)
+    );
+
+    // write to code
+    reloc = resolve_refs(env, ins);
+    code = write_code(ins, reloc, Mcons(Mfixnum(min_arity), minim_false));
+
+    // return a closure
+    cl = Mclosure(base_env, code);
+    minim_closure_name(cl) = intern(who);
+    return cl;
+}
+
 // Short hand for making a function that just calls `compile_do_ret`
 #define define_do_ret(fn_name, arity, do_instr) \
     mobj fn_name(mobj name) { \
@@ -67,7 +96,7 @@ mobj compile_apply(mobj name) {
     code = write_code(ins, reloc, Mcons(Mfixnum(2), minim_false));
 
     // return a closure
-    cl = Mclosure(base_env, code, 0);
+    cl = Mclosure(base_env, code);
     minim_closure_name(cl) = name;
     return cl;
 }
@@ -81,7 +110,7 @@ mobj compile_values(mobj name) {
     
     // hand written procedure
     ins = Mlist2(
-        Mlist1(do_values_symbol),
+        Mlist2(do_values_symbol, Mfixnum(0)),
         Mlist1(ret_symbol)
     );
 
@@ -90,7 +119,7 @@ mobj compile_values(mobj name) {
     code = write_code(ins, reloc, Mcons(Mfixnum(0), minim_false));
 
     // return a closure
-    cl = Mclosure(base_env, code, 0);
+    cl = Mclosure(base_env, code);
     minim_closure_name(cl) = name;
     return cl;
 }
@@ -116,7 +145,7 @@ mobj compile_eval(mobj name) {
         list_append2(Mlist5(
             Mlist3(get_arg_symbol, Mfixnum(res_reg_idx), Mfixnum(0)),  // %res <- %sfp[1] [expr]
             Mlist1(do_eval_symbol),
-            Mlist1(clear_frame_symbol),
+            Mlist2(clear_frame_symbol, Mfixnum(0)),
             Mlist1(set_proc_symbol),
             Mlist1(apply_symbol)
         ),
@@ -160,7 +189,7 @@ mobj compile_eval(mobj name) {
     code = write_code(ins, reloc, Mlist2(Mfixnum(1), Mfixnum(2)));
 
     // return a closure
-    cl = Mclosure(base_env, code, 0);
+    cl = Mclosure(base_env, code);
     minim_closure_name(cl) = name;
     return cl;
 }
@@ -5,8 +5,8 @@
 #include "../minim.h"
 
 mobj Mcons(mobj car, mobj cdr) {
-    mobj o = GC_alloc(minim_cons_size);
-    minim_type(o) = MINIM_OBJ_PAIR;
+    mobj o = GC_alloc_tagged(minim_cons_size);
+    minim_heap_type(o) = MINIM_OBJ_PAIR;
     minim_car(o) = car;
     minim_cdr(o) = cdr;
     return o;
@@ -65,6 +65,7 @@ void list_set_tail(mobj xs, mobj ys) {
     
     for (t = xs; minim_consp(minim_cdr(t)); t = minim_cdr(t));
     minim_cdr(t) = ys;
+    minim_write_barrier(t, ys);
 }
 
 //
@@ -232,12 +233,14 @@ mobj cddddr_proc(mobj x) {
 mobj set_car_proc(mobj p, mobj x) {
     // (-> pair any void)
     minim_car(p) = x;
+    minim_write_barrier(p, x);
     return minim_void;
 }
 
 mobj set_cdr_proc(mobj p, mobj x) {
     // (-> pair any void)
     minim_cdr(p) = x;
+    minim_write_barrier(p, x);
     return minim_void;
 }
 
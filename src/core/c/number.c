@@ -4,11 +4,28 @@
 
 #include "../minim.h"
 
-mobj Mfixnum(long v) {
-    mobj o = GC_alloc_atomic(minim_fixnum_size);
-    minim_type(o) = MINIM_OBJ_FIXNUM;
-    minim_fixnum(o) = v;
-    return o;
+//
+//  Overflow
+//
+
+// Operands are at most 63 bits, so sums and differences fit in
+// an `mfixnum` and only need a range check.
+
+int fx2_add_overflowp(mobj x, mobj y) {
+    mfixnum z = minim_fixnum(x) + minim_fixnum(y);
+    return !minim_fixnum_rangep(z);
+}
+
+int fx2_sub_overflowp(mobj x, mobj y) {
+    mfixnum z = minim_fixnum(x) - minim_fixnum(y);
+    return !minim_fixnum_rangep(z);
+}
+
+int fx2_mul_overflowp(mobj x, mobj y) {
+    mfixnum z;
+    if (__builtin_mul_overflow(minim_fixnum(x), minim_fixnum(y), &z))
+        return 1;
+    return !minim_fixnum_rangep(z);
 }
 
 //
@@ -21,27 +38,38 @@ mobj fixnump_proc(mobj x) {
 
 mobj fx_neg(mobj x) {
     // (-> integer integer)
+    if (minim_fixnum(x) == MFIXNUM_MIN)
+        minim_error1("-", "fixnum overflow", x);
     return Mfixnum(-minim_fixnum(x));
 }
 
 mobj fx2_add(mobj x, mobj y) {
     // (-> integer integer integer)
+    if (fx2_add_overflowp(x, y))
+        minim_error2("+", "fixnum overflow", x, y);
     return Mfixnum(minim_fixnum(x) + minim_fixnum(y));
 }
 
 mobj fx2_sub(mobj x, mobj y) {
     // (-> integer integer integer)
+    if (fx2_sub_overflowp(x, y))
+        minim_error2("-", "fixnum overflow", x, y);
     return Mfixnum(minim_fixnum(x) - minim_fixnum(y));
 }
 
 mobj fx2_mul(mobj x, mobj y) {
     // (-> integer integer integer)
+    if (fx2_mul_overflowp(x, y))
+        minim_error2("*", "fixnum overflow", x, y);
     return Mfixnum(minim_fixnum(x) * minim_fixnum(y));
 }
 
 mobj fx2_div(mobj x, mobj y) {
     // (-> integer integer integer)
-    return Mfixnum(minim_fixnum(x) / minim_fixnum(y));
+    mfixnum z = minim_fixnum(x) / minim_fixnum(y);
+    if (!minim_fixnum_rangep(z))
+        minim_error2("/", "fixnum overflow", x, y);
+    return Mfixnum(z);
 }
 
 mobj fx_remainder(mobj x, mobj y) {
@@ -83,3 +111,94 @@ mobj fx2_le(mobj x, mobj y) {
     // (-> integer integer bool)
     return (minim_fixnum(x) <= minim_fixnum(y)) ? minim_true : minim_false;
 }
+
+//
+//  Variadic primitives
+//
+
+static void check_number(const char *who, mobj x) {
+    if (!minim_fixnump(x))
+        minim_argument_error(who, "number?", x);
+}
+
+mobj add_proc(size_t argc, mobj *args) {
+    // (-> integer ... integer)
+    mobj x = Mfixnum(0);
+    for (size_t i = 0; i < argc; i++) {
+        check_number("+", args[i]);
+        x = fx2_add(x, args[i]);
+    }
+
+    return x;
+}
+
+mobj sub_proc(size_t argc, mobj *args) {
+    // (-> integer integer ... integer)
+    mobj x;
+
+    check_number("-", args[0]);
+    if (argc == 1)
+        return fx_neg(args[0]);
+
+    x = args[0];
+    for (size_t i = 1; i < argc; i++) {
+        check_number("-", args[i]);
+        x = fx2_sub(x, args[i]);
+    }
+
+    return x;
+}
+
+mobj mul_proc(size_t argc, mobj *args) {
+    // (-> integer ... integer)
+    mobj x = Mfixnum(1);
+    for (size_t i = 0; i < argc; i++) {
+        check_number("*", args[i]);
+        x = fx2_mul(x, args[i]);
+    }
+
+    return x;
+}
+
+mobj div_proc(size_t argc, mobj *args) {
+    // (-> integer integer ... integer)
+    mobj x;
+    size_t i;
+
+    check_number("/", args[0]);
+    if (argc == 1) {
+        x = Mfixnum(1);
+        i = 0;
+    } else {
+        x = args[0];
+        i = 1;
+    }
+
+    for (; i < argc; i++) {
+        check_number("/", args[i]);
+        if (minim_fixnum(args[i]) == 0)
+            minim_error1("/", "division by zero", args[i]);
+        x = fx2_div(x, args[i]);
+    }
+
+    return x;
+}
+
+// Comparisons check every argument, even after the result is known
+#define define_compare(name, who, op) \
+    mobj name(size_t argc, mobj *args) { \
+        mobj r = minim_true; \
+        check_number(who, args[0]); \
+        for (size_t i = 1; i < argc; i++) { \
+            check_number(who, args[i]); \
+            if (!(minim_fixnum(args[i - 1]) op minim_fixnum(args[i]))) \
+                r = minim_false; \
+        } \
+        return r; \
+    }
+
+define_compare(num_eq_proc, "=", ==)
+define_compare(num_gt_proc, ">", >)
+define_compare(num_lt_proc, "<", <)
+define_compare(num_ge_proc, ">=", >=)
+define_compare(num_le_proc, "<=", <=)
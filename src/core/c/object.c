@@ -32,6 +32,7 @@ mobj branchgt_symbol;
 mobj branchlt_symbol;
 mobj branchne_symbol;
 mobj ccall_symbol;
+mobj ccallv_symbol;
 mobj check_stack_symbol;
 mobj clear_frame_symbol;
 mobj closure_ref_symbol;
@@ -44,9 +45,12 @@ mobj do_raise_symbol;
 mobj do_rest_symbol;
 mobj do_values_symbol;
 mobj do_with_values_symbol;
+mobj entry_symbol;
 mobj get_arg_symbol;
 mobj get_tenv_symbol;
 mobj literal_symbol;
+mobj local_ref_symbol;
+mobj local_set_symbol;
 mobj lookup_symbol;
 mobj lookup_cell_symbol;
 mobj tl_bind_values_symbol;
@@ -58,38 +62,38 @@ mobj mov_symbol;
 mobj pop_symbol;
 mobj push_symbol;
 mobj push_env_symbol;
+mobj reserve_frame_symbol;
 mobj rebind_symbol;
 mobj ret_symbol;
 mobj save_cc_symbol;
 mobj set_arg_symbol;
 mobj set_proc_symbol;
 mobj set_tenv_symbol;
+mobj shift_frame_symbol;
+mobj stack_bind_values_symbol;
+mobj stack_ref_symbol;
+mobj stack_set_symbol;
+mobj prim_cons_symbol;
+mobj prim_car_symbol;
+mobj prim_cdr_symbol;
+mobj prim_eq_symbol;
+mobj prim_nullp_symbol;
+mobj prim_pairp_symbol;
+mobj prim_not_symbol;
+mobj prim_fixnump_symbol;
+mobj prim_fx_add_symbol;
+mobj prim_fx_sub_symbol;
+mobj prim_fx_eq_symbol;
+mobj prim_fx_lt_symbol;
+mobj prim_fx_gt_symbol;
+mobj prim_vector_ref_symbol;
 
-mobj minim_null;
-mobj minim_true;
-mobj minim_false;
-mobj minim_eof;
-mobj minim_void;
 mobj minim_empty_vec;
 mobj minim_base_rtd;
-mobj minim_values;
-mobj minim_unbound;
 
 int minim_eqp(mobj a, mobj b) {
-    if (a == b) {
-        return 1;
-    } else if (minim_type(a) != minim_type(b)) {
-        return 0;
-    } else {
-        switch (minim_type(a)) {
-        case MINIM_OBJ_CHAR:
-            return minim_char(a) == minim_char(b);
-        case MINIM_OBJ_FIXNUM:
-            return minim_fixnum(a) == minim_fixnum(b);
-        default:
-            return 0;
-        }
-    }
+    // fixnums and characters are immediates
+    return a == b;
 }
 
 static int minim_vector_equalp(mobj a, mobj b) {
@@ -111,10 +115,6 @@ int minim_equalp(mobj a, mobj b) {
         return 0;
     } else {
         switch (minim_type(a)) {
-        case MINIM_OBJ_CHAR:
-            return minim_char(a) == minim_char(b);
-        case MINIM_OBJ_FIXNUM:
-            return minim_fixnum(a) == minim_fixnum(b);
         case MINIM_OBJ_STRING:
             return strcmp(minim_string(a), minim_string(b)) == 0;
         case MINIM_OBJ_PAIR:
@@ -130,6 +130,98 @@ int minim_equalp(mobj a, mobj b) {
     }
 }
 
+//
+//  Tracing
+//
+//  Heap objects (other than frame environments) are allocated
+//  tagged by their type, so the collector only marks the words
+//  of an object that may hold pointers.
+//
+
+typedef void (*mark_proc)(void*, void*);
+
+static void string_mrk(mark_proc mark, void *gc, void *o) {
+    mark(gc, minim_string(o));
+}
+
+static void pair_mrk(mark_proc mark, void *gc, void *o) {
+    mark(gc, minim_car(o));
+    mark(gc, minim_cdr(o));
+}
+
+static void vector_mrk(mark_proc mark, void *gc, void *o) {
+    for (msize i = 0; i < minim_vector_len(o); ++i)
+        mark(gc, minim_vector_ref(o, i));
+}
+
+static void closure_mrk(mark_proc mark, void *gc, void *o) {
+    mark(gc, minim_closure_env(o));
+    mark(gc, minim_closure_code(o));
+    mark(gc, minim_closure_name(o));
+}
+
+static void record_mrk(mark_proc mark, void *gc, void *o) {
+    mark(gc, minim_record_rtd(o));
+    for (int i = 0; i < minim_record_count(o); ++i)
+        mark(gc, minim_record_ref(o, i));
+}
+
+static void box_mrk(mark_proc mark, void *gc, void *o) {
+    mark(gc, minim_unbox(o));
+}
+
+static void syntax_mrk(mark_proc mark, void *gc, void *o) {
+    mark(gc, minim_syntax_e(o));
+    mark(gc, minim_syntax_loc(o));
+}
+
+// hashtables and top-level environments
+static void buckets_mrk(mark_proc mark, void *gc, void *o) {
+    mark(gc, minim_hashtable_buckets(o));
+}
+
+static void continuation_mrk(mark_proc mark, void *gc, void *o) {
+    mark(gc, continuation_pc(o));
+    mark(gc, continuation_env(o));
+    mark(gc, continuation_sfp(o));
+    mark(gc, continuation_cp(o));
+}
+
+// only object and cache operands of the instruction stream are pointers
+static void code_mrk(mark_proc mark, void *gc, void *o) {
+    mobj *istream;
+    size_t i, j, argc;
+
+    mark(gc, minim_code_arity(o));
+    mark(gc, minim_code_reloc(o));
+    istream = minim_code_it(o);
+    for (i = 0; i < minim_code_len(o); i += 1 + argc) {
+        opcode_type op = (opcode_type) (muptr) istream[i];
+        argc = opcode_operands(op);
+        for (j = 0; j < argc; ++j) {
+            char kind = opcode_operand_kind(op, j);
+            if (kind == 'o' || kind == 'k')
+                mark(gc, istream[i + 1 + j]);
+        }
+    }
+}
+
+void init_tracers() {
+    GC_register_tag_mrk(MINIM_OBJ_SYMBOL, string_mrk);
+    GC_register_tag_mrk(MINIM_OBJ_STRING, string_mrk);
+    GC_register_tag_mrk(MINIM_OBJ_PAIR, pair_mrk);
+    GC_register_tag_mrk(MINIM_OBJ_VECTOR, vector_mrk);
+    GC_register_tag_mrk(MINIM_OBJ_CLOSURE, closure_mrk);
+    GC_register_tag_mrk(MINIM_OBJ_PORT, GC_atomic_mrk);
+    GC_register_tag_mrk(MINIM_OBJ_RECORD, record_mrk);
+    GC_register_tag_mrk(MINIM_OBJ_BOX, box_mrk);
+    GC_register_tag_mrk(MINIM_OBJ_HASHTABLE, buckets_mrk);
+    GC_register_tag_mrk(MINIM_OBJ_SYNTAX, syntax_mrk);
+    GC_register_tag_mrk(MINIM_OBJ_TOPENV, buckets_mrk);
+    GC_register_tag_mrk(MINIM_OBJ_CONTINUATION, continuation_mrk);
+    GC_register_tag_mrk(MINIM_OBJ_CODE, code_mrk);
+}
+
 //
 //  Primitives
 //
@@ -14,6 +14,15 @@
     ); \
 }
 
+#define add_variadic_procedure(name, c_fn, min_arity) { \
+    mobj sym = intern(name); \
+    top_env_insert( \
+        env, \
+        sym, \
+        compile_variadic_prim(name, c_fn, min_arity) \
+    ); \
+}
+
 #define add_cprocedure(name, gen) { \
     mobj sym = intern(name); \
     top_env_insert( \
@@ -86,6 +95,7 @@ void init_prims(mobj env) {
     add_procedure("$vector-set!", vector_set, 3);
     add_procedure("$vector-fill!", vector_fill, 2);
     add_procedure("$list->vector", list_to_vector, 1);
+    add_variadic_procedure("vector", vector_proc, 0);
     add_procedure("$vector->list", vector_to_list, 1);
 
     add_procedure("fixnum?", fixnump_proc, 1);
@@ -102,6 +112,15 @@ void init_prims(mobj env) {
     add_procedure("$fx2<", fx2_lt, 2);
     add_procedure("$fx2>=", fx2_ge, 2);
     add_procedure("$fx2<=", fx2_le, 2);
+    add_variadic_procedure("+", add_proc, 0);
+    add_variadic_procedure("-", sub_proc, 1);
+    add_variadic_procedure("*", mul_proc, 0);
+    add_variadic_procedure("/", div_proc, 1);
+    add_variadic_procedure("=", num_eq_proc, 1);
+    add_variadic_procedure(">", num_gt_proc, 1);
+    add_variadic_procedure("<", num_lt_proc, 1);
+    add_variadic_procedure(">=", num_ge_proc, 1);
+    add_variadic_procedure("<=", num_le_proc, 1);
 
     add_procedure("string?", stringp_proc, 1);
     add_procedure("$make-string", make_string, 2);
@@ -114,6 +133,7 @@ void init_prims(mobj env) {
     add_procedure("$string->symbol", string_to_symbol, 1);
     add_procedure("$list->string", list_to_string, 1);
     add_procedure("$string->list", string_to_list, 1);
+    add_variadic_procedure("string-append", string_append, 0);
 
     add_procedure("record?", recordp_proc, 1);
     add_procedure("record-type-descriptor?", record_rtdp_proc, 1);
@@ -8,13 +8,12 @@
 //  Primitives
 //
 
-mobj Mclosure(mobj env, mobj code, size_t free_count) {
-    mobj o = GC_alloc(minim_closure_size(free_count));
-    minim_type(o) = MINIM_OBJ_CLOSURE;
+mobj Mclosure(mobj env, mobj code) {
+    mobj o = GC_alloc_tagged(minim_closure_size);
+    minim_heap_type(o) = MINIM_OBJ_CLOSURE;
     minim_closure_env(o) = env;
     minim_closure_code(o) = code;
     minim_closure_name(o) = minim_false;
-    minim_closure_count(o) = free_count;
     return o;
 }
 
@@ -39,19 +38,11 @@ mobj procedure_name_proc(mobj proc) {
 mobj procedure_rename_proc(mobj proc, mobj id) {
     // (-> procedure symbol? procedure)
     mobj env, code, proc2;
-    size_t num_free;
 
-    // construct new closure
+    // construct new closure (sharing captured variables)
     env = minim_closure_env(proc);
     code = minim_closure_code(proc);
-    num_free = minim_closure_count(proc);
-    proc2 = Mclosure(env, code, num_free);
-
-    // copy free variable cells
-    for (size_t i = 0; i < num_free; i++) {
-        minim_closure_ref(proc2, i) = minim_closure_ref(proc, i);
-    }
-
-    minim_closure_name(proc) = id;
-    return proc;
+    proc2 = Mclosure(env, code);
+    minim_closure_name(proc2) = id;
+    return proc2;
 }
@@ -33,6 +33,25 @@ static void assert_matching_paren(char open, char closed) {
         minim_error2("read_object", "parenthesis mismatch", Mchar(closed), Mchar(open));
     }
 }
+// Appends a digit to a magnitude, saturating just past the largest
+// fixnum magnitude (2^62) so the sign can be applied without overflow.
+static long push_digit(long num, int base, int d) {
+    if (num > MFIXNUM_MAX + 1 ||
+        __builtin_mul_overflow(num, base, &num) ||
+        num > MFIXNUM_MAX + 1 - d) {
+        return MFIXNUM_MAX + 2;
+    }
+
+    return num + d;
+}
+
+static void check_fixnum_range(char *buffer, long len, long num) {
+    if (!minim_fixnum_rangep(num)) {
+        buffer[len] = '\0';
+        minim_error1("read_object", "integer out of fixnum range", Mstring(buffer));
+    }
+}
+
 static int peek_char(FILE *in) {
     int c = getc(in);
     ungetc(c, in);
@@ -350,8 +369,12 @@ loop:
 
         // magnitude
         while (isdigit(c = getc(in))) {
+            if (i >= symbol_max_len - 1) {
+                minim_error("read_object", "number exceeded max length");
+            }
+
             buffer[i++] = c;
-            num = (num * 10) + (c - '0');
+            num = push_digit(num, 10, c - '0');
         }
 
         if (is_symbol_char(c)) {
@@ -361,7 +384,8 @@ loop:
         // check for delimeter
         assert_delimeter(c);
         ungetc(c, in);
-    
+
+        check_fixnum_range(buffer, i, num * sign);
         return Mfixnum(num * sign);
     } else if (0) {
         // hexadecimal number
@@ -382,10 +406,14 @@ read_hex:
 
         // magnitude
         while (isxdigit(c = getc(in))) {
+            if (i >= symbol_max_len - 1) {
+                minim_error("read_object", "number exceeded max length");
+            }
+
             buffer[i++] = c;
-            if ('A' <= c && c <= 'F')       num = (num * 16) + (10 + (c - 'A'));
-            else if ('a' <= c && c <= 'f')  num = (num * 16) + (10 + (c - 'a'));
-            else                            num = (num * 16) + (c - '0');
+            if ('A' <= c && c <= 'F')       num = push_digit(num, 16, 10 + (c - 'A'));
+            else if ('a' <= c && c <= 'f')  num = push_digit(num, 16, 10 + (c - 'a'));
+            else                            num = push_digit(num, 16, c - '0');
         }
 
         if (is_symbol_char(c)) {
@@ -396,6 +424,7 @@ read_hex:
         assert_delimeter(c);
         ungetc(c, in);
 
+        check_fixnum_range(buffer, i, num * sign);
         return Mfixnum(num * sign);
     } else if (c == '"') {
         // string
@@ -5,8 +5,8 @@
 #include "../minim.h"
 
 mobj Mrecord(mobj rtd, int fieldc) {
-    mobj o = GC_alloc(minim_record_size(fieldc));
-    minim_type(o) = MINIM_OBJ_RECORD;
+    mobj o = GC_alloc_tagged(minim_record_size(fieldc));
+    minim_heap_type(o) = MINIM_OBJ_RECORD;
     minim_record_rtd(o) = rtd;
     minim_record_count(o) = fieldc;
     return o;
@@ -140,6 +140,7 @@ mobj record_ref_proc(mobj rec, mobj idx) {
 mobj record_set_proc(mobj rec, mobj idx, mobj x) {
     // (-> record idx any void)
     minim_record_ref(rec, minim_fixnum(idx)) = x;
+    minim_write_barrier(rec, x);
     return minim_void;
 }
 
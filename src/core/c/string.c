@@ -10,17 +10,17 @@ mobj Mstring(const char *s) {
     mobj o;
     size_t len;
 
-    o = GC_alloc(minim_string_size);
+    o = GC_alloc_tagged(minim_string_size);
     len = strlen(s);
-    minim_type(o) = MINIM_OBJ_STRING;
+    minim_heap_type(o) = MINIM_OBJ_STRING;
     minim_string(o) = GC_alloc_atomic((len + 1) * sizeof(char));
     strncpy(minim_string(o), s, len + 1);
     return o;
 }
 
 mobj Mstring2(long len, mchar c) {
-    mobj o = GC_alloc(minim_string_size);
-    minim_type(o) = MINIM_OBJ_STRING;
+    mobj o = GC_alloc_tagged(minim_string_size);
+    minim_heap_type(o) = MINIM_OBJ_STRING;
     if (c == 0) {
         minim_string(o) = GC_calloc_atomic((len + 1), sizeof(char));
     } else {
@@ -100,6 +100,30 @@ mobj list_to_string(mobj xs) {
     return s;
 }
 
+mobj string_append(size_t argc, mobj *args) {
+    // (-> string ... string)
+    mobj s;
+    size_t len, i;
+    char *it;
+
+    len = 0;
+    for (i = 0; i < argc; i++) {
+        if (!minim_stringp(args[i]))
+            minim_argument_error("string-append", "string?", args[i]);
+        len += strlen(minim_string(args[i]));
+    }
+
+    s = Mstring2(len, 0);
+    it = minim_string(s);
+    for (i = 0; i < argc; i++) {
+        size_t n = strlen(minim_string(args[i]));
+        memcpy(it, minim_string(args[i]), n);
+        it += n;
+    }
+
+    return s;
+}
+
 mobj string_to_list(mobj s) {
     // (-> string (listof char))
     mobj lst = minim_null;
@@ -5,8 +5,8 @@
 #include "../minim.h"
 
 mobj Msyntax(mobj e, mobj loc) {
-    mobj o = GC_alloc(minim_syntax_size);
-    minim_type(o) = MINIM_OBJ_SYNTAX;
+    mobj o = GC_alloc_tagged(minim_syntax_size);
+    minim_heap_type(o) = MINIM_OBJ_SYNTAX;
     minim_syntax_e(o) = e;
     minim_syntax_loc(o) = loc;
     return o;
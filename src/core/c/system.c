@@ -64,6 +64,12 @@ int make_page_write_only(void* page, size_t size) {
     return 0;
 }
 
+void free_page(void *page, size_t size) {
+    if (munmap(page, size) == -1) {
+        minim_error("free_page", "failed to free page");
+    }
+}
+
 void set_current_dir(const char *str) {
     if (_set_current_dir(str) != 0) {
         minim_error1("set_current_dir", "could not set current directory", Mstring(str));
@@ -2,20 +2,24 @@
 
 #include "../minim.h"
 
+#define values_buffer_size      8
+
 mobj Mthread_context() {
     mobj tc, env;
     
     tc = GC_alloc(tc_size);
+    GC_register_root(tc);   // mutated without a write barrier
     env = make_base_env();
 
     tc_ac(tc) = 0;
     tc_cp(tc) = NULL;
     tc_sfp(tc) = NULL;
     tc_esp(tc) = NULL;
-    tc_ccont(tc) = minim_null;
     tc_env(tc) = NULL;
     tc_vc(tc) = 0;
-    tc_values(tc) = NULL;
+    tc_values(tc) = GC_calloc(values_buffer_size, sizeof(mobj));
+    tc_values_size(tc) = values_buffer_size;
+    GC_register_root(tc_values(tc));    // mutated without a write barrier
     tc_stack_base(tc) = NULL;
     tc_stack_size(tc) = 0;
     tc_stack_link(tc) = minim_null;
@@ -30,5 +34,6 @@ mobj Mthread_context() {
     tc_error_handler(tc) = minim_false;
     tc_c_error_handler(tc) = minim_false;
     tc_tenv(tc) = env;
+    tc_lfp(tc) = NULL;
     return tc;
 }
@@ -5,8 +5,8 @@
 #include "../minim.h"
 
 mobj Mvector(long len, mobj init) {
-    mobj o = GC_alloc(minim_vector_size(len));
-    minim_type(o) = MINIM_OBJ_VECTOR;
+    mobj o = GC_alloc_tagged(minim_vector_size(len));
+    minim_heap_type(o) = MINIM_OBJ_VECTOR;
     minim_vector_len(o) = len;
     if (init != NULL) {
         for (long i = 0; i < len; ++i)
@@ -43,6 +43,7 @@ mobj vector_ref(mobj v, mobj idx) {
 mobj vector_set(mobj v, mobj idx, mobj x) {
     // (-> vector fixnum any void)
     minim_vector_ref(v, minim_fixnum(idx)) = x;
+    minim_write_barrier(v, x);
     return minim_void;
 }
 
@@ -50,6 +51,7 @@ mobj vector_fill(mobj v, mobj x) {
     // (-> vector any void)
     for (long i = 0; i < minim_vector_len(v); i++)
         minim_vector_ref(v, i) = x;
+    minim_write_barrier(v, x);
     return minim_void;
 }
 
@@ -68,6 +70,13 @@ mobj list_to_vector(mobj lst) {
     return v;
 }
 
+mobj vector_proc(size_t argc, mobj *args) {
+    // (-> any ... vector)
+    mobj v = Mvector(argc, NULL);
+    memcpy(&minim_vector_ref(v, 0), args, argc * sizeof(mobj));
+    return v;
+}
+
 mobj vector_to_list(mobj v) {
     // (-> vector list
     mobj lst = minim_null;
@@ -45,6 +45,7 @@ typedef void            *mobj;
 #define stack_frame_limit       512
 #define stack_slop              (2 * stack_frame_limit)
 #define env_vector_max          6
+#define native_threshold        8
 
 // Special symbols
 
@@ -76,6 +77,7 @@ extern mobj branchgt_symbol;
 extern mobj branchlt_symbol;
 extern mobj branchne_symbol;
 extern mobj ccall_symbol;
+extern mobj ccallv_symbol;
 extern mobj clear_frame_symbol;
 extern mobj check_stack_symbol;
 extern mobj closure_ref_symbol;
@@ -88,9 +90,12 @@ extern mobj do_raise_symbol;
 extern mobj do_rest_symbol;
 extern mobj do_values_symbol;
 extern mobj do_with_values_symbol;
+extern mobj entry_symbol;
 extern mobj get_arg_symbol;
 extern mobj get_tenv_symbol;
 extern mobj literal_symbol;
+extern mobj local_ref_symbol;
+extern mobj local_set_symbol;
 extern mobj lookup_symbol;
 extern mobj lookup_cell_symbol;
 extern mobj tl_bind_values_symbol;
@@ -102,12 +107,31 @@ extern mobj mov_symbol;
 extern mobj pop_symbol;
 extern mobj push_symbol;
 extern mobj push_env_symbol;
+extern mobj reserve_frame_symbol;
 extern mobj rebind_symbol;
 extern mobj ret_symbol;
 extern mobj set_arg_symbol;
 extern mobj set_proc_symbol;
 extern mobj set_tenv_symbol;
 extern mobj save_cc_symbol;
+extern mobj shift_frame_symbol;
+extern mobj stack_bind_values_symbol;
+extern mobj stack_ref_symbol;
+extern mobj stack_set_symbol;
+extern mobj prim_cons_symbol;
+extern mobj prim_car_symbol;
+extern mobj prim_cdr_symbol;
+extern mobj prim_eq_symbol;
+extern mobj prim_nullp_symbol;
+extern mobj prim_pairp_symbol;
+extern mobj prim_not_symbol;
+extern mobj prim_fixnump_symbol;
+extern mobj prim_fx_add_symbol;
+extern mobj prim_fx_sub_symbol;
+extern mobj prim_fx_eq_symbol;
+extern mobj prim_fx_lt_symbol;
+extern mobj prim_fx_gt_symbol;
+extern mobj prim_vector_ref_symbol;
 
 // Object types
 
@@ -137,22 +161,48 @@ typedef enum {
 } mobj_type;
 
 // Objects
+// Fixnums, characters, and special values are immediates
+// encoded in the low bits of an object. Any other object is
+// allocated on the heap and stores its type in its first byte.
+//  [    v    | xx1 ]  fixnum
+//  [    c    | 010 ]  character
+//  [    n    | 110 ]  special value
+//  [   ptr   | 000 ]  heap object
+#define imm_mask                0x7
+#define fixnum_tag              0x1
+#define char_tag                0x2
+#define special_tag             0x6
+
+#define minim_immediatep(o)     (((muptr) (o)) & imm_mask)
+#define minim_specialp(o)       ((((muptr) (o)) & imm_mask) == special_tag)
+
+#define minim_heap_type(o)      (*((mbyte *) (o)))
+#define minim_heap_typep(o, t)  (!minim_immediatep(o) && minim_heap_type(o) == (t))
+
+#define minim_type(o)   \
+    (minim_fixnump(o) ? MINIM_OBJ_FIXNUM : \
+    (minim_charp(o) ? MINIM_OBJ_CHAR : \
+    (minim_specialp(o) ? MINIM_OBJ_SPECIAL : \
+    minim_heap_type(o))))
+
+// Write barrier: follows a store of `x` into an existing object `o`
+// (not needed when initializing a newly allocated object)
+#define minim_write_barrier(o, x) \
+    { if (!minim_immediatep(x)) GC_write_barrier(o); }
+
+// Special values
+#define minim_special(n)        ((mobj) ((((muptr) (n)) << 3) | special_tag))
+
+#define minim_null              minim_special(0)
+#define minim_true              minim_special(1)
+#define minim_false             minim_special(2)
+#define minim_eof               minim_special(3)
+#define minim_void              minim_special(4)
+#define minim_values            minim_special(5)
+#define minim_unbound           minim_special(6)
 
-#define minim_type(o)           (*((mbyte*) o))
-
-// Intermediates
-// +------------+ 
-// |    type    | [0, 1)
-// +------------+
-extern mobj minim_null;
-extern mobj minim_true;
-extern mobj minim_false;
-extern mobj minim_eof;
-extern mobj minim_void;
 extern mobj minim_empty_vec;
 extern mobj minim_base_rtd;
-extern mobj minim_values;
-extern mobj minim_unbound;
 
 #define minim_nullp(x)        ((x) == minim_null)
 #define minim_truep(x)        ((x) == minim_true)
@@ -168,14 +218,10 @@ extern mobj minim_unbound;
 #define minim_boolp(o)          ((o) == minim_true || (o) == minim_false)
 #define minim_not(o)            ((o) == minim_false ? minim_true : minim_false)
 
-// Characters
-// +------------+
-// |    type    | [0, 1)
-// |     c     |  [4, 8)
-// +------------+
-#define minim_char_size         ptr_size
-#define minim_charp(o)          (minim_type(o) == MINIM_OBJ_CHAR)
-#define minim_char(o)           (*((char *) ptr_add(o, 4)))
+// Characters (immediate)
+#define Mchar(c)                ((mobj) ((((muptr) (c)) << 3) | char_tag))
+#define minim_charp(o)          ((((muptr) (o)) & imm_mask) == char_tag)
+#define minim_char(o)           ((mchar) (((intptr_t) (o)) >> 3))
 
 #define NUL_CHAR        ((mchar) 0x00)      // null
 #define BEL_CHAR        ((mchar) 0x07)      // alarm / bell
@@ -189,14 +235,16 @@ extern mobj minim_unbound;
 #define SP_CHAR         ((mchar) 0x20)      // space
 #define DEL_CHAR        ((mchar) 0x7F)      // delete
 
-// Fixnum
-// +------------+
-// |    type    | [0, 1)
-// |     v      | [8, 16)
-// +------------+ 
-#define minim_fixnum_size       (2 * ptr_size)
-#define minim_fixnump(o)        (minim_type(o) == MINIM_OBJ_FIXNUM)
-#define minim_fixnum(o)         (*((mfixnum*) ptr_add(o, ptr_size)))
+// Fixnum (immediate)
+// Fixnums are 63-bit: [MFIXNUM_MIN, MFIXNUM_MAX] = [-2^62, 2^62 - 1].
+// `Mfixnum` does not check its argument; the reader and the fixnum
+// arithmetic primitives raise an error rather than wrap.
+#define MFIXNUM_MAX             ((mfixnum) (((muptr) 1 << 62) - 1))
+#define MFIXNUM_MIN             (-MFIXNUM_MAX - 1)
+#define minim_fixnum_rangep(v)  ((v) >= MFIXNUM_MIN && (v) <= MFIXNUM_MAX)
+#define Mfixnum(v)              ((mobj) ((((muptr) (v)) << 1) | fixnum_tag))
+#define minim_fixnump(o)        (((muptr) (o)) & fixnum_tag)
+#define minim_fixnum(o)         (((mfixnum) (o)) >> 1)
 
 // Symbols
 // +------------+
@@ -204,7 +252,7 @@ extern mobj minim_unbound;
 // |    str     | [8, 16)
 // +------------+
 #define minim_symbol_size       (2 * ptr_size)
-#define minim_symbolp(o)        (minim_type(o) == MINIM_OBJ_SYMBOL)
+#define minim_symbolp(o)        minim_heap_typep(o, MINIM_OBJ_SYMBOL)
 #define minim_symbol(o)         (*((char **) ptr_add(o, ptr_size)))
 
 // String
@@ -213,7 +261,7 @@ extern mobj minim_unbound;
 // |    str     | [8, 16)
 // +------------+ 
 #define minim_string_size       (2 * ptr_size)
-#define minim_stringp(o)        (minim_type(o) == MINIM_OBJ_STRING)
+#define minim_stringp(o)        minim_heap_typep(o, MINIM_OBJ_STRING)
 #define minim_string(o)         (*((char **) ptr_add(o, ptr_size)))
 #define minim_string_ref(o, i)  (minim_string(o)[(i)])
 
@@ -225,7 +273,7 @@ extern mobj minim_unbound;
 // +------------+ 
 #define minim_cons_size         (3 * ptr_size)
 
-#define minim_consp(o)          (minim_type(o) == MINIM_OBJ_PAIR)
+#define minim_consp(o)          minim_heap_typep(o, MINIM_OBJ_PAIR)
 #define minim_car(o)            (*((mobj*) ptr_add(o, ptr_size)))
 #define minim_cdr(o)            (*((mobj*) ptr_add(o, 2 * ptr_size)))
 
@@ -248,7 +296,7 @@ extern mobj minim_unbound;
 // |    elts    | [16, 16 + 8 * N)
 // +------------+ 
 #define minim_vector_size(n)        (ptr_size * (2 + (n)))
-#define minim_vectorp(o)            (minim_type(o) == MINIM_OBJ_VECTOR)
+#define minim_vectorp(o)            minim_heap_typep(o, MINIM_OBJ_VECTOR)
 #define minim_vector_len(o)         (*((msize*) ptr_add(o, ptr_size)))
 #define minim_vector_ref(o, i)      (((mobj*) ptr_add(o, 2 * ptr_size))[i])
 
@@ -258,7 +306,7 @@ extern mobj minim_unbound;
 // |   content  | [8, 16)
 // +------------+
 #define minim_box_size      (2 * ptr_size)
-#define minim_boxp(o)       (minim_type(o) == MINIM_OBJ_BOX)
+#define minim_boxp(o)       minim_heap_typep(o, MINIM_OBJ_BOX)
 #define minim_unbox(o)      (*((mobj*) ptr_add(o, ptr_size)))
 
 // Closure
@@ -267,16 +315,14 @@ extern mobj minim_unbound;
 // |    env     | [8, 16)
 // |    code    | [16, 24)
 // |    name    | [24, 32)
-// |    #free   | [32, 40)
-// |    free    | [40, ...)
 // +------------+
-#define minim_closure_size(n)       ((5 + (n)) * ptr_size)
-#define minim_closurep(o)           (minim_type(o) == MINIM_OBJ_CLOSURE)
+//
+// Captured variables are stored in `env` (see `make-closure`).
+#define minim_closure_size          (4 * ptr_size)
+#define minim_closurep(o)           minim_heap_typep(o, MINIM_OBJ_CLOSURE)
 #define minim_closure_env(o)        (*((mobj*) ptr_add(o, ptr_size)))
 #define minim_closure_code(o)       (*((mobj*) ptr_add(o, 2 * ptr_size)))
 #define minim_closure_name(o)       (*((mobj*) ptr_add(o, 3 * ptr_size)))
-#define minim_closure_count(o)      (*((size_t*) ptr_add(o, 4 * ptr_size)))
-#define minim_closure_ref(o, i)     (*((mobj*) ptr_add(o, (5 + (i)) * ptr_size)))
 
 // Port
 // +------------+
@@ -285,7 +331,7 @@ extern mobj minim_unbound;
 // |     fp     | [8, 16)
 // +------------+
 #define minim_port_size         (2 * ptr_size)
-#define minim_portp(o)          (minim_type(o) == MINIM_OBJ_PORT)
+#define minim_portp(o)          minim_heap_typep(o, MINIM_OBJ_PORT)
 #define minim_port_flags(o)     (*((mbyte*) ptr_add(o, 1)))
 #define minim_port(o)           (*((FILE**) ptr_add(o, ptr_size)))
 
@@ -310,7 +356,7 @@ extern mobj minim_unbound;
 // |    loc     | [16, 24)
 // +------------+
 #define minim_syntax_size       (3 * ptr_size)
-#define minim_syntaxp(o)        (minim_type(o) == MINIM_OBJ_SYNTAX)
+#define minim_syntaxp(o)        minim_heap_typep(o, MINIM_OBJ_SYNTAX)
 #define minim_syntax_e(o)       (*((mobj*) ptr_add(o, ptr_size)))
 #define minim_syntax_loc(o)     (*((mobj*) ptr_add(o, 2 * ptr_size)))
 
@@ -323,7 +369,7 @@ extern mobj minim_unbound;
 // |    ...     |
 // +------------+
 #define minim_record_size(n)        (ptr_size * (2 + (n)))
-#define minim_recordp(o)            (minim_type(o) == MINIM_OBJ_RECORD)
+#define minim_recordp(o)            minim_heap_typep(o, MINIM_OBJ_RECORD)
 #define minim_record_count(o)       (*((int*) ptr_add(o, 4)))
 #define minim_record_rtd(o)         (*((mobj*) ptr_add(o, ptr_size)))
 #define minim_record_ref(o, i)      (((mobj*) ptr_add(o, 2 * ptr_size))[i])
@@ -410,7 +456,7 @@ extern mobj minim_unbound;
 // |    count   | [24, 32)
 // +------------+
 #define minim_hashtable_size            (4 * ptr_size)
-#define minim_hashtablep(o)             (minim_type(o) == MINIM_OBJ_HASHTABLE)
+#define minim_hashtablep(o)             minim_heap_typep(o, MINIM_OBJ_HASHTABLE)
 #define minim_hashtable_buckets(o)      (*((mobj*) ptr_add(o, ptr_size)))
 #define minim_hashtable_bucket(o, i)    (minim_vector_ref(minim_hashtable_buckets(o), i))
 #define minim_hashtable_alloc_ptr(o)    (*((msize**) ptr_add(o, 2 * ptr_size)))
@@ -424,7 +470,7 @@ extern mobj minim_unbound;
 // |    ...     |
 // +------------+
 #define minim_env_size(n)       ((1 + (n)) * ptr_size)
-#define minim_envp(o)           (minim_type(o) == MINIM_OBJ_ENV)
+#define minim_envp(o)           minim_heap_typep(o, MINIM_OBJ_ENV)
 #define minim_env_ref(o, i)     (*((mobj*) ptr_add(o, (1 + (i)) * ptr_size)))
 
 // Environment (top-level)
@@ -435,7 +481,7 @@ extern mobj minim_unbound;
 // |   count    | [24, 32)
 // +------------+
 #define minim_top_env_size              (4 * ptr_size)
-#define minim_top_envp(o)               (minim_type(o) == MINIM_OBJ_TOPENV)
+#define minim_top_envp(o)               minim_heap_typep(o, MINIM_OBJ_TOPENV)
 #define minim_top_env_buckets(o)        (*((mobj*) ptr_add(o, ptr_size)))
 #define minim_top_env_bucket(o, i)      (minim_vector_ref(minim_top_env_buckets(o), i))
 #define minim_top_env_alloc_ptr(o)      (*((msize**) ptr_add(o, 2 * ptr_size)))
@@ -443,23 +489,24 @@ extern mobj minim_unbound;
 #define minim_top_env_count(o)          (*((msize*) ptr_add(o, 3 * ptr_size)))
 
 // Continuations
+// Heap copy of a stack frame's return point (see `Stack frames`)
 // +------------+
 // |    type    | [0, 1)
-// |    prev    | [8, 16)
-// |    pc      | [16, 24)
-// |    env     | [24, 32)
-// |    sfp     | [32, 40)
-// |    cp      | [40, 48)
-// |    ac      | [48, 56)
+// |    pc      | [8, 16)
+// |    env     | [16, 24)
+// |    sfp     | [24, 32)
+// |    cp      | [32, 40)
+// |    ac      | [40, 48)
+// |    lfp     | [48, 56)
 // +------------+
 #define continuation_size           (7 * ptr_size)
-#define minim_continuationp(o)      (minim_type(o) == MINIM_OBJ_CONTINUATION)
-#define continuation_prev(c)        (*((mobj*) ptr_add(c, ptr_size)))
-#define continuation_pc(c)          (*((mobj*) ptr_add(c, 2 * ptr_size)))
-#define continuation_env(c)         (*((mobj*) ptr_add(c, 3 * ptr_size)))
-#define continuation_sfp(c)         (*((mobj**) ptr_add(c, 4 * ptr_size)))
-#define continuation_cp(c)          (*((mobj*) ptr_add(c, 5 * ptr_size)))
-#define continuation_ac(c)          (*((size_t*) ptr_add(c, 6 * ptr_size)))
+#define minim_continuationp(o)      minim_heap_typep(o, MINIM_OBJ_CONTINUATION)
+#define continuation_pc(c)          (*((mobj*) ptr_add(c, ptr_size)))
+#define continuation_env(c)         (*((mobj*) ptr_add(c, 2 * ptr_size)))
+#define continuation_sfp(c)         (*((mobj**) ptr_add(c, 3 * ptr_size)))
+#define continuation_cp(c)          (*((mobj*) ptr_add(c, 4 * ptr_size)))
+#define continuation_ac(c)          (*((size_t*) ptr_add(c, 5 * ptr_size)))
+#define continuation_lfp(c)         (*((mobj**) ptr_add(c, 6 * ptr_size)))
 
 // Procedures
 
@@ -467,8 +514,6 @@ extern mobj minim_unbound;
 
 // Constructors
 
-mobj Mchar(mchar c);
-mobj Mfixnum(long v);
 mobj Msymbol(const char *s);
 mobj Mgensym(const char *s);
 mobj Mstring(const char *s);
@@ -476,7 +521,7 @@ mobj Mstring2(long len, mchar c);
 mobj Mcons(mobj car, mobj cdr);
 mobj Mvector(long len, mobj init);
 mobj Mbox(mobj x);
-mobj Mclosure(mobj env, mobj code, size_t free_count);
+mobj Mclosure(mobj env, mobj code);
 mobj Minput_port(FILE *stream);
 mobj Moutput_port(FILE *stream);
 mobj Msyntax(mobj e, mobj loc);
@@ -484,7 +529,7 @@ mobj Mrecord(mobj rtd, int fieldc);
 mobj Mhashtable(size_t size_hint);
 mobj Menv(size_t size);
 mobj Mtop_env(size_t size_hint);
-mobj Mcontinuation(mobj prev, mobj pc, mobj env, mobj tc);
+mobj Mcontinuation(mobj *fp);
 
 // Object
 
@@ -511,6 +556,9 @@ mobj integer_to_char(mobj x);
 // Fixnums
 
 mobj fixnump_proc(mobj x);
+int fx2_add_overflowp(mobj x, mobj y);
+int fx2_sub_overflowp(mobj x, mobj y);
+int fx2_mul_overflowp(mobj x, mobj y);
 mobj fx_neg(mobj x);
 mobj fx2_add(mobj x, mobj y);
 mobj fx2_sub(mobj x, mobj y);
@@ -523,6 +571,15 @@ mobj fx2_gt(mobj x, mobj y);
 mobj fx2_lt(mobj x, mobj y);
 mobj fx2_ge(mobj x, mobj y);
 mobj fx2_le(mobj x, mobj y);
+mobj add_proc(size_t argc, mobj *args);
+mobj sub_proc(size_t argc, mobj *args);
+mobj mul_proc(size_t argc, mobj *args);
+mobj div_proc(size_t argc, mobj *args);
+mobj num_eq_proc(size_t argc, mobj *args);
+mobj num_gt_proc(size_t argc, mobj *args);
+mobj num_lt_proc(size_t argc, mobj *args);
+mobj num_ge_proc(size_t argc, mobj *args);
+mobj num_le_proc(size_t argc, mobj *args);
 
 // Symbol
 
@@ -541,6 +598,7 @@ mobj symbol_to_string(mobj s);
 mobj string_to_symbol(mobj s);
 mobj list_to_string(mobj xs);
 mobj string_to_list(mobj s);
+mobj string_append(size_t argc, mobj *args);
 
 // Pair
 
@@ -610,6 +668,7 @@ mobj vector_set(mobj v, mobj idx, mobj x);
 mobj vector_fill(mobj v, mobj x);
 mobj vector_to_list(mobj v);
 mobj list_to_vector(mobj xs);
+mobj vector_proc(size_t argc, mobj *args);
 
 // Box
 
@@ -691,6 +750,7 @@ mobj equal_hash_proc(mobj x);
 mobj eq_hashtable_find(mobj ht, mobj k);
 mobj eq_hashtable_find2(mobj ht, mobj k, size_t h);
 void eq_hashtable_set(mobj ht, mobj k, mobj v);
+void eq_hashtable_delete(mobj ht, mobj k);
 
 mobj hashtablep_proc(mobj x);
 mobj make_hashtable(mobj size);
@@ -744,6 +804,7 @@ void set_current_dir(const char *str);
 void *alloc_page(size_t size);
 int make_page_executable(void *page, size_t size);
 int make_page_write_only(void *page, size_t size);
+void free_page(void *page, size_t size);
 
 mobj load_file(mobj tc, const char *fname);
 mobj load_prelude(mobj tc);
@@ -768,6 +829,7 @@ NORETURN void minim_error(const char *name, const char *msg);
 NORETURN void minim_error1(const char *name, const char *msg, mobj x);
 NORETURN void minim_error2(const char *name, const char *msg, mobj x, mobj y);
 NORETURN void minim_error3(const char *name, const char *msg, mobj x, mobj y, mobj z);
+NORETURN void minim_argument_error(const char *name, const char *expect, mobj x);
 
 mobj boot_error_proc(mobj who, mobj msg, mobj args);
 mobj c_error_handler_proc();
@@ -790,35 +852,61 @@ mobj error_handler_set_proc(mobj proc);
 
 mobj Mcached_stack(mobj *base, mobj prev, size_t len, mobj ret);
 
+// Stack frames
+// Allocated inline on the stack by `save-cc`. The header saves
+// the caller's state and is followed by the arguments.
+// +------------+
+// |    ra      | [0, 8)
+// |    env     | [8, 16)
+// |    cp      | [16, 24)
+// |    ac      | [24, 32)
+// |    prev    | [32, 40)
+// |    lfp     | [40, 48)
+// |    args    | [48, ...)
+// |    ...     |
+// +------------+
+//
+// Once a procedure is entered, the first slots of its frame hold
+// its locals (see `reserve-frame`) and `lfp` points to them.
+#define frame_header_size       6
+#define frame_ra(fp)            ((fp)[0])
+#define frame_env(fp)           ((fp)[1])
+#define frame_cp(fp)            ((fp)[2])
+#define frame_ac(fp)            (*((size_t*) &(fp)[3]))
+#define frame_prev(fp)          (*((mobj**) &(fp)[4]))
+#define frame_lfp(fp)           (*((mobj**) &(fp)[5]))
+#define frame_args(fp)          (&(fp)[frame_header_size])
+
 // Thread context
 // Encapsulates all Scheme runtime information of a thread
-#define tc_size                 (23 * ptr_size)
+#define tc_size                 (24 * ptr_size)
 #define tc_ac(tc)               (*((size_t *) (tc)))
 #define tc_cp(tc)               (*((mobj*) ptr_add(tc, ptr_size)))
 #define tc_sfp(tc)              (*((mobj**) ptr_add(tc, 2 * ptr_size)))
 #define tc_esp(tc)              (*((mobj**) ptr_add(tc, 3 * ptr_size)))
-#define tc_ccont(tc)            (*((mobj*) ptr_add(tc, 4 * ptr_size)))
-#define tc_env(tc)              (*((mobj*) ptr_add(tc, 5 * ptr_size)))
-#define tc_vc(tc)               (*((size_t*) ptr_add(tc, 6 * ptr_size)))
-#define tc_values(tc)           (*((mobj**) ptr_add(tc, 7 * ptr_size)))
-#define tc_stack_base(tc)       (*((mobj**) ptr_add(tc, 8 * ptr_size)))
-#define tc_stack_size(tc)       (*((size_t*) ptr_add(tc, 9 * ptr_size)))
-#define tc_stack_link(tc)       (*((void**) ptr_add(tc, 10 * ptr_size)))
-#define tc_sseg(tc)             (*((mobj**) ptr_add(tc, 11 * ptr_size)))
-#define tc_reentry(tc)          (*((jmp_buf**) ptr_add(tc, 12 * ptr_size)))
-#define tc_input_port(tc)       (*((mobj*) ptr_add(tc, 13 * ptr_size)))
-#define tc_output_port(tc)      (*((mobj*) ptr_add(tc, 14 * ptr_size)))
-#define tc_error_port(tc)       (*((mobj*) ptr_add(tc, 15 * ptr_size)))
-#define tc_directory(tc)        (*((mobj*) ptr_add(tc, 16 * ptr_size)))
-#define tc_command_line(tc)     (*((mobj*) ptr_add(tc, 17 * ptr_size)))
-#define tc_record_equal(tc)     (*((mobj*) ptr_add(tc, 18 * ptr_size)))
-#define tc_record_hash(tc)      (*((mobj*) ptr_add(tc, 19 * ptr_size)))
-#define tc_error_handler(tc)    (*((mobj*) ptr_add(tc, 20 * ptr_size)))
-#define tc_c_error_handler(tc)  (*((mobj*) ptr_add(tc, 21 * ptr_size)))
-#define tc_tenv(tc)             (*((mobj*) ptr_add(tc, 22 * ptr_size)))
-
-#define tc_ra(tc)               (tc_sfp(tc)[0])
-#define tc_frame(tc)            ((mobj *) ptr_add(tc_sfp(tc), ptr_size))
+#define tc_env(tc)              (*((mobj*) ptr_add(tc, 4 * ptr_size)))
+#define tc_vc(tc)               (*((size_t*) ptr_add(tc, 5 * ptr_size)))
+#define tc_values(tc)           (*((mobj**) ptr_add(tc, 6 * ptr_size)))
+#define tc_stack_base(tc)       (*((mobj**) ptr_add(tc, 7 * ptr_size)))
+#define tc_stack_size(tc)       (*((size_t*) ptr_add(tc, 8 * ptr_size)))
+#define tc_stack_link(tc)       (*((void**) ptr_add(tc, 9 * ptr_size)))
+#define tc_sseg(tc)             (*((mobj**) ptr_add(tc, 10 * ptr_size)))
+#define tc_reentry(tc)          (*((jmp_buf**) ptr_add(tc, 11 * ptr_size)))
+#define tc_input_port(tc)       (*((mobj*) ptr_add(tc, 12 * ptr_size)))
+#define tc_output_port(tc)      (*((mobj*) ptr_add(tc, 13 * ptr_size)))
+#define tc_error_port(tc)       (*((mobj*) ptr_add(tc, 14 * ptr_size)))
+#define tc_directory(tc)        (*((mobj*) ptr_add(tc, 15 * ptr_size)))
+#define tc_command_line(tc)     (*((mobj*) ptr_add(tc, 16 * ptr_size)))
+#define tc_record_equal(tc)     (*((mobj*) ptr_add(tc, 17 * ptr_size)))
+#define tc_record_hash(tc)      (*((mobj*) ptr_add(tc, 18 * ptr_size)))
+#define tc_error_handler(tc)    (*((mobj*) ptr_add(tc, 19 * ptr_size)))
+#define tc_c_error_handler(tc)  (*((mobj*) ptr_add(tc, 20 * ptr_size)))
+#define tc_tenv(tc)             (*((mobj*) ptr_add(tc, 21 * ptr_size)))
+#define tc_lfp(tc)              (*((mobj**) ptr_add(tc, 22 * ptr_size)))
+#define tc_values_size(tc)      (*((size_t*) ptr_add(tc, 23 * ptr_size)))
+
+#define tc_ra(tc)               (frame_ra(tc_sfp(tc)))
+#define tc_frame(tc)            (frame_args(tc_sfp(tc)))
 #define tc_frame_ref(tc, i)     (tc_frame(tc)[i])
 
 mobj Mthread_context();
@@ -827,23 +915,121 @@ mobj Mthread_context();
 // +------------+
 // |   type     | [0, 1)
 // |   size     | [8, 16)
-// |   arity    | [24, 32)
-// |   reloc    | [32, 40)
-// |   instrs   | [40, ...) 
+// |   arity    | [16, 24)
+// |   reloc    | [24, 32)
+// |   native   | [32, 40)
+// |   calls    | [40, 48)
+// |   instrs   | [48, ...) 
 // |   ...      |
 // +------------+
-#define minim_code_header_size      4
+//
+// `size` is the number of words in the instruction stream.
+// Each instruction is encoded as an opcode word followed
+// by a fixed number of operand words (see `opcode_type`).
+// Integer operands are stored unboxed and branch targets
+// are word offsets relative to the branching instruction.
+// The stream is terminated by `OP_END`.
+//
+// `native` is the native code for the object (if compiled)
+// and `calls` counts entries into the object until it is.
+#define minim_code_header_size      6
 #define minim_code_size(n)          ((minim_code_header_size * ptr_size) + (n * ptr_size) + ptr_size)
-#define minim_codep(o)              (minim_type(o) == MINIM_OBJ_CODE)
+#define minim_codep(o)              minim_heap_typep(o, MINIM_OBJ_CODE)
 #define minim_code_len(o)           (*((size_t*) ptr_add(o, ptr_size)))
 #define minim_code_arity(o)         (*((mobj*) ptr_add(o, 2 * ptr_size)))
 #define minim_code_reloc(o)         (*((mobj*) ptr_add(o, 3 * ptr_size)))
-#define minim_code_it(o)            ((mobj *) ptr_add(o, 4 * ptr_size))
+#define minim_code_native(o)        (*((void**) ptr_add(o, 4 * ptr_size)))
+#define minim_code_calls(o)         (*((size_t*) ptr_add(o, 5 * ptr_size)))
+#define minim_code_it(o)            ((mobj *) ptr_add(o, minim_code_header_size * ptr_size))
 #define minim_code_ref(o, i)        (minim_code_it(o)[i]) 
 
 mobj Mcode(size_t size);
 mobj code_to_instrs(mobj code);
 
+// Opcodes
+
+typedef enum {
+    OP_END = 0,
+    OP_ENTRY,
+    OP_LITERAL,
+    OP_LOOKUP,
+    OP_LOOKUP_CELL,
+    OP_LOCAL_REF,
+    OP_LOCAL_SET,
+    OP_TL_LOOKUP,
+    OP_TL_LOOKUP_CELL,
+    OP_SET_PROC,
+    OP_PUSH,
+    OP_POP,
+    OP_MOV,
+    OP_CLOSURE_REF,
+    OP_CLOSURE_SET,
+    OP_CLOSURE_BIND,
+    OP_APPLY,
+    OP_RET,
+    OP_CCALL,
+    OP_CCALLV,
+    OP_BIND,
+    OP_BIND_CELL,
+    OP_BIND_VALUES,
+    OP_TL_BIND_VALUES,
+    OP_REBIND,
+    OP_TL_REBIND,
+    OP_PUSH_ENV,
+    OP_SAVE_CC,
+    OP_GET_ARG,
+    OP_SET_ARG,
+    OP_GET_TENV,
+    OP_SET_TENV,
+    OP_DO_APPLY,
+    OP_DO_ARITY_ERROR,
+    OP_DO_EVAL,
+    OP_DO_RAISE,
+    OP_DO_REST,
+    OP_DO_VALUES,
+    OP_DO_WITH_VALUES,
+    OP_CLEAR_FRAME,
+    OP_BRANCHA,
+    OP_BRANCHF,
+    OP_BRANCHGT,
+    OP_BRANCHLT,
+    OP_BRANCHNE,
+    OP_MAKE_CLOSURE,
+    OP_CHECK_STACK,
+    OP_RESERVE_FRAME,
+    OP_SHIFT_FRAME,
+    OP_STACK_REF,
+    OP_STACK_SET,
+    OP_STACK_BIND_VALUES,
+    // inlined primitives (see `compile_inline_prim`)
+    OP_PRIM_CONS,
+    OP_PRIM_CAR,
+    OP_PRIM_CDR,
+    OP_PRIM_EQ,
+    OP_PRIM_NULLP,
+    OP_PRIM_PAIRP,
+    OP_PRIM_NOT,
+    OP_PRIM_FIXNUMP,
+    OP_PRIM_FX_ADD,
+    OP_PRIM_FX_SUB,
+    OP_PRIM_FX_EQ,
+    OP_PRIM_FX_LT,
+    OP_PRIM_FX_GT,
+    OP_PRIM_VECTOR_REF,
+} opcode_type;
+
+#define opcode_count        (OP_PRIM_VECTOR_REF + 1)
+
+size_t opcode_operands(opcode_type op);
+char opcode_operand_kind(opcode_type op, size_t i);
+
+// Native code
+
+typedef mobj *(*native_proc)(mobj tc, mobj *tregs);
+
+void write_native(mobj code);
+void *native_helper(opcode_type op);
+
 // I/O
 
 mobj read_object(FILE *in);
@@ -886,13 +1072,34 @@ size_t global_cenv_add_template(mobj cenv, mobj jit);
 mobj global_cenv_ref_template(mobj cenv, size_t i);
 void global_cenv_set_fvs(mobj cenv, mobj fvs);
 mobj global_cenv_get_fvs(mobj cenv, mobj e);
-void global_cenv_set_bound(mobj cenv, mobj bound);
-mobj global_cenv_get_bound(mobj cenv, mobj e);
+void global_cenv_set_mutated(mobj cenv, mobj mutated);
+mobj global_cenv_get_mutated(mobj cenv, mobj e);
+void global_cenv_set_captured(mobj cenv, mobj captured);
+mobj global_cenv_get_captured(mobj cenv, mobj e);
+void global_cenv_set_known(mobj cenv, mobj known);
+mobj global_cenv_get_known(mobj cenv, mobj e);
+void global_cenv_set_loops(mobj cenv, mobj loops);
+mobj global_cenv_get_loop(mobj cenv, mobj e);
+void global_cenv_set_loop_entry(mobj cenv, mobj proc, mobj entry);
+mobj global_cenv_get_loop_entry(mobj cenv, mobj proc);
 
 mobj make_cenv(mobj global_env);
 mobj cenv_global_env(mobj cenv);
 mobj cenv_make_label(mobj cenv);
 void cenv_set_fvs(mobj cenv, mobj fvs);
+void cenv_set_self(mobj cenv, mobj id, mobj entries);
+void cenv_reset_sizes(mobj cenv);
+size_t cenv_env_size(mobj cenv);
+size_t cenv_frame_size(mobj cenv);
+void cenv_patch_frame_size(mobj cenv, mobj ins);
+
+// Location of a variable (see `scope_cenv_lookup`)
+typedef enum {
+    VAR_TOP_LEVEL,      // top-level environment
+    VAR_LOCAL,          // environment slot holding the value
+    VAR_CELL,           // environment slot holding a cell
+    VAR_STACK,          // slot in the frame of the procedure
+} var_location;
 
 mobj make_scope_cenv(mobj proc_cenv);
 mobj scope_cenv_extend(mobj cenv);
@@ -900,11 +1107,21 @@ mobj scope_cenv_proc_env(mobj cenv);
 mobj scope_cenv_global_env(mobj cenv);
 mobj scope_cenv_make_label(mobj cenv);
 size_t scope_cenv_bind_count(mobj cenv);
-size_t scope_cenv_bind(mobj cenv, mobj id);
-mobj scope_cenv_ref(mobj cenv, mobj id);
-
-mobj jit_free_vars(mobj expr, mobj table);
-mobj jit_bound_vars(mobj expr, mobj table);
+size_t scope_cenv_bind(mobj cenv, mobj id, int boxedp);
+size_t scope_cenv_alloc_slots(mobj cenv, size_t n);
+void scope_cenv_bind_slot(mobj cenv, mobj id, size_t slot);
+size_t scope_cenv_alloc_env(mobj cenv, size_t n);
+void scope_cenv_bind_env(mobj cenv, mobj id, size_t idx, int boxedp);
+var_location scope_cenv_lookup(mobj cenv, mobj id, size_t *idx);
+void scope_cenv_enter_frame(mobj cenv);
+void scope_cenv_exit_frame(mobj cenv);
+mobj scope_cenv_frame_base(mobj cenv);
+mobj scope_cenv_self_entry(mobj cenv, mobj id, size_t argc);
+
+void jit_analyze_vars(mobj expr, mobj fvs, mobj mutated, mobj captured, mobj loops);
+void jit_known_procs(mobj expr, mobj table);
+void jit_analyze_escape(mobj expr, mobj table);
+void jit_analyze_print_stats(FILE *out);
 
 mobj write_code(mobj ins, mobj reloc, mobj arity);
 mobj resolve_refs(mobj cenv, mobj ins);
@@ -912,10 +1129,15 @@ mobj resolve_refs(mobj cenv, mobj ins);
 mobj jit_opt_L0(mobj expr);
 mobj jit_opt_L1(mobj expr);
 mobj jit_opt_L2(mobj expr);
+mobj jit_opt_L3(mobj expr);
+void jit_register_inline(mobj id, mobj expr, mobj code);
+void jit_unregister_inline(mobj proc, mobj val);
 mobj compile_expr(mobj expr);
 mobj compile_expr2(mobj expr, mobj env, int tailp);
+void jit_print_stats(FILE *out);
 
 mobj compile_prim(const char *who, void *fn, mobj arity);
+mobj compile_variadic_prim(const char *who, void *fn, size_t min_arity);
 mobj compile_apply(mobj name);
 mobj compile_eval(mobj name);
 mobj compile_identity(mobj name);
@@ -958,6 +1180,10 @@ mobj intern_symbol(intern_table *itab, const char *sym);
 // Globals
 
 extern intern_table *symbols;
+extern mobj inline_procs;
+extern int jit_dump_ir;
+extern int jit_inline;
+extern size_t prim_guard_misses;
 extern mobj *curr_thread_ref;
 extern size_t bucket_sizes[];
 
@@ -967,6 +1193,7 @@ extern size_t bucket_sizes[];
 // Primitives
 
 void init_minim();
+void init_tracers();
 void init_prims(mobj env);
 
 #endif  // _MINIM_H_
@@ -0,0 +1 @@
+#define USE_MINIM_GC 1
@@ -7,8 +7,12 @@
 
 #include "minim-gc/gc.h"
 
+// roots keep their status when reallocated
+#define GC_realloc_root(p, n)       GC_realloc(p, n)
+
 #else
 
+#include <string.h>
 #include "boehm-gc/include/gc.h"
 
 #define GC_alloc(n)                 GC_malloc(n)
@@ -16,20 +20,43 @@
 #define GC_realloc(p, n)            GC_realloc(p, n)
 
 #define GC_alloc_atomic(n)          GC_malloc_atomic(n)
-#define GC_calloc_atomic(s, n)      GC_malloc_atomic((s) * (n))
 #define GC_realloc_atomic(p, n)     GC_realloc(p, n)
 
-#define GC_register_root(o)         GC_add_roots(o, (((void *) o) + sizeof(*o)))
+#define GC_alloc_tagged(n)          GC_malloc(n)
+
+#define GC_register_root(o)         GC_add_roots((void *) (o), ((char *) (o)) + GC_size(o))
 #define GC_register_dtor(o, p)      GC_register_finalizer(o, p, 0, 0, 0)
+#define GC_register_tag_mrk(t, f)   ((void) (t), (void) (f))
+#define GC_write_barrier(o)
 
 #define GC_init(x)          GC_init(); 
 #define GC_finalize()       GC_deinit();
 #define GC_pause()          GC_disable()
 #define GC_resume()         GC_enable()
+#define GC_set_pause_budget(n)
+#define GC_set_threads(n)
 
 // ignore
 #define GC_REGISTER_LOCAL_ARRAY(x)
 
+// atomic objects are not cleared by Boehm's GC
+static inline void *GC_calloc_atomic(size_t s, size_t n) {
+    return memset(GC_malloc_atomic(s * n), 0, s * n);
+}
+
+// objects are scanned conservatively, so markers are never called
+static inline void GC_atomic_mrk(void (*func)(void*, void*), void *gc, void *ptr) { }
+
+// roots are address ranges, so a root that moves is registered again
+static inline void *GC_realloc_root(void *p, size_t n) {
+    void *q;
+
+    GC_remove_roots(p, ((char *) p) + GC_size(p));
+    q = GC_realloc(p, n);
+    GC_register_root(q);
+    return q;
+}
+
 #endif
 
 #endif
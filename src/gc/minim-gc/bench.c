@@ -0,0 +1,80 @@
+/*
+    Benchmark of parallel collection.
+
+    Builds a large binary tree that stays live, then times full
+    collections with an increasing number of marking and sweeping
+    threads. Each collection also frees a smaller garbage tree.
+*/
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <time.h>
+
+#include "gc.h"
+
+#define LIVE_DEPTH      20
+#define GARBAGE_DEPTH   18
+#define ITERATIONS      5
+
+typedef struct node_t {
+    struct node_t *left, *right;
+    size_t value;
+} node_t;
+
+static node_t *make_tree(size_t depth) {
+    node_t *n = GC_alloc(sizeof(node_t));
+    n->value = depth;
+    if (depth > 0) {
+        n->left = make_tree(depth - 1);
+        n->right = make_tree(depth - 1);
+    }
+
+    return n;
+}
+
+static double now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+int main() {
+    volatile int stack_top;
+    static size_t threads[] = { 1, 2, 4, 8, 16 };
+    node_t *live;
+    size_t live_size;
+
+    GC_init(((void*) &stack_top));
+    GC_pause();
+
+    // the tree must survive every collection
+    live = make_tree(LIVE_DEPTH);
+    live_size = ((1 << (LIVE_DEPTH + 1)) - 1) * sizeof(node_t);
+    GC_register_root(live);
+
+    printf("threads  collect (ms)\n");
+    for (size_t t = 0; t < sizeof(threads) / sizeof(size_t); ++t) {
+        double total = 0.0;
+
+        GC_set_threads(threads[t]);
+        for (size_t i = 0; i < ITERATIONS; ++i) {
+            double start;
+
+            make_tree(GARBAGE_DEPTH);
+            start = now_ms();
+            GC_collect();
+            total += now_ms() - start;
+        }
+
+        printf("%7zu  %12.2f\n", threads[t], total / ITERATIONS);
+    }
+
+    if (live->value != LIVE_DEPTH || GC_get_allocated() < live_size) {
+        fprintf(stderr, "live tree was collected\n");
+        return 1;
+    }
+
+    GC_finalize();
+    return 0;
+}
@@ -1,3 +1,5 @@
+#include <pthread.h>
+#include <sched.h>
 #include <setjmp.h>
 #include <stdlib.h>
 #include <string.h>
@@ -9,154 +11,467 @@
 #include "gc-impl.h"
 
 #define POINTER_SIZE        sizeof(void*)
+#define SLOT_ALIGN          16
 
-static size_t bucket_sizes[] = {
-    8209,
-    16411,
-    32771,
-    65537,
-    131101,
-    262147,
-    524309,
-    1048583,
-    2097169,
-    4194319,
-    8388617,
-    16777259,
-    33554467,
-    67108879,
-    134217757,
-    268435459,
-    536870923,
-    1073741827,
-    2147483659,
-    4294967311,
-    8589934609,
-    17179869209,
-    34359738421,
-    68719476767,
-    137438953481,
-    274877906951,
-    549755813911,
-    1099511627791,
-    2199023255579,
-    4398046511119,
-    8796093022237,
-    17592186044423,
-    35184372088891,
-    70368744177679,
-    140737488355333,
-    281474976710677,
-    562949953421381,
-    1125899906842679,
-    2251799813685269,
-    4503599627370517,
-    9007199254740997,
-    18014398509482143,
-    36028797018963971,
-    72057594037928017,
-    144115188075855881,
-    288230376151711813,
-    576460752303423619,
-    1152921504606847009,
-    2305843009213693967,
-    4611686018427388039,
-    0
+// parallel tasks
+#define GC_TASK_MARK        1
+#define GC_TASK_SWEEP       2
+
+// slot size of each size class
+static size_t class_sizes[GC_CLASS_COUNT] = {
+    8, 16, 24, 32, 48, 64, 80, 96, 128, 160,
+    192, 256, 384, 512, 768, 1024, 1536, 2048, 3072, 4096
 };
 
+// size class of each size (in words)
+static uint8_t size_classes[GC_MAX_SMALL_SIZE / POINTER_SIZE + 1];
+
 void GC_atomic_mrk(void (*)(void*, void*), void*, void*);
 
 /*************** Helper functions *****************/
 
 #define ptr_arr_ref(arr, n)     (((void**) (arr))[n])
 #define ptr_ref(p)              (*((void**) (p)))
+#define align_up(x, a)          ((((x) + (a) - 1) / (a)) * (a))
 
-// Inserts an existing bucket into the record table updating `r->next`.
 static void
-insert_record(gc_t *gc,
-              gc_record_t *r) {
-    size_t i;
-    
-    // compute index and insert
-    i = gc_hash(gc_record_ptr(r)) % gc->alloc;
-    gc_record_next_set(r, gc->buckets[i]);
-    gc->buckets[i] = r;
+init_size_classes() {
+    size_t c = 0;
+    for (size_t w = 0; w <= GC_MAX_SMALL_SIZE / POINTER_SIZE; ++w) {
+        while (class_sizes[c] < w * POINTER_SIZE)
+            ++c;
+        size_classes[w] = c;
+    }
+}
+
+static void
+vec_push(gc_vec_t *v,
+         void *x) {
+    if (v->size == v->alloc) {
+        v->alloc = (v->alloc == 0) ? GC_VEC_SIZE : 2 * v->alloc;
+        v->data = realloc(v->data, v->alloc * sizeof(void*));
+    }
+
+    v->data[v->size++] = x;
+}
+
+static void
+vec_remove(gc_vec_t *v,
+           void *x) {
+    // recent entries are usually near the end
+    for (size_t i = v->size; i > 0; --i) {
+        if (v->data[i - 1] == x) {
+            v->data[i - 1] = v->data[--v->size];
+            return;
+        }
+    }
+}
+
+/* Page map */
+
+static int
+page_map_ref(gc_t *gc,
+             uintptr_t addr) {
+    uintptr_t i;
+    uint64_t *leaf;
+
+    if (addr >> GC_ADDR_BITS)
+        return 0;
+
+    i = addr >> GC_PAGE_SHIFT;
+    leaf = gc->page_map[i >> GC_MAP_LEAF_BITS];
+    return leaf && gc_bit_ref(leaf, i & ((1 << GC_MAP_LEAF_BITS) - 1));
+}
+
+static void
+page_map_set(gc_t *gc,
+             uintptr_t addr) {
+    uintptr_t i;
+    uint64_t **leaf;
+
+    i = addr >> GC_PAGE_SHIFT;
+    leaf = &gc->page_map[i >> GC_MAP_LEAF_BITS];
+    if (*leaf == NULL)
+        *leaf = calloc(GC_MAP_LEAF_WORDS, sizeof(uint64_t));
+    gc_bit_set(*leaf, i & ((1 << GC_MAP_LEAF_BITS) - 1));
 }
 
 static void
-gc_resize(gc_t *gc,
-          size_t *alloc_ptr) {
-    gc_record_t **old_buckets = gc->buckets;
-    size_t old_alloc = gc->alloc;
+page_map_unset(gc_t *gc,
+               uintptr_t addr) {
+    uintptr_t i = addr >> GC_PAGE_SHIFT;
+    gc_bit_unset(gc->page_map[i >> GC_MAP_LEAF_BITS], i & ((1 << GC_MAP_LEAF_BITS) - 1));
+}
+
+/* Hooks (destructors and markers) */
 
-    // update size and create new buckets
-    gc->alloc_ptr = alloc_ptr;
-    gc->alloc = *gc->alloc_ptr;
-    gc->buckets = (gc_record_t **) calloc(gc->alloc, sizeof(gc_record_t*));
+static size_t
+hook_hash(void *ptr) {
+    size_t h = (((uintptr_t) ptr) >> 3) * 11400714819323198485llu;
+    return h ^ (h >> 32);
+}
+
+static gc_hook_t *
+hook_find(gc_t *gc,
+          void *ptr) {
+    gc_hook_t *h = gc->hooks[hook_hash(ptr) & (gc->hooks_alloc - 1)];
+    while (h && h->ptr != ptr)
+        h = h->next;
+    return h;
+}
 
-    // rehash
+static void
+hook_resize(gc_t *gc) {
+    gc_hook_t **old = gc->hooks;
+    size_t old_alloc = gc->hooks_alloc;
+
+    gc->hooks_alloc *= 2;
+    gc->hooks = calloc(gc->hooks_alloc, sizeof(gc_hook_t*));
     for (size_t i = 0; i < old_alloc; ++i) {
-        gc_record_t *r = old_buckets[i];
-        while (r) {
-            gc_record_t *nr = gc_record_next(r);     
-            insert_record(gc, r);
-            r = nr;
+        gc_hook_t *h = old[i];
+        while (h) {
+            gc_hook_t *nh = h->next;
+            size_t j = hook_hash(h->ptr) & (gc->hooks_alloc - 1);
+            h->next = gc->hooks[j];
+            gc->hooks[j] = h;
+            h = nh;
         }
     }
 
-    free(old_buckets);
+    free(old);
+}
+
+// Returns the hook of `ptr`, adding one if needed.
+static gc_hook_t *
+hook_add(gc_t *gc,
+         void *ptr) {
+    gc_hook_t *h;
+    size_t i;
+
+    h = hook_find(gc, ptr);
+    if (h)  return h;
+
+    if (gc->hooks_size >= gc->hooks_alloc)
+        hook_resize(gc);
+
+    i = hook_hash(ptr) & (gc->hooks_alloc - 1);
+    h = malloc(sizeof(gc_hook_t));
+    h->next = gc->hooks[i];
+    h->ptr = ptr;
+    h->dtor = NULL;
+    h->mrk = NULL;
+    gc->hooks[i] = h;
+    ++gc->hooks_size;
+    return h;
+}
+
+// Unlinks and returns the hook of `ptr`.
+static gc_hook_t *
+hook_remove(gc_t *gc,
+            void *ptr) {
+    gc_hook_t **it = &gc->hooks[hook_hash(ptr) & (gc->hooks_alloc - 1)];
+    while ((*it)->ptr != ptr)
+        it = &(*it)->next;
+
+    gc_hook_t *h = *it;
+    *it = h->next;
+    --gc->hooks_size;
+    return h;
+}
+
+/* Pages */
+
+// Lays out the metadata of a page with `count` slots of `size` bytes.
+static void
+init_page(gc_page_t *pg,
+          size_t size,
+          size_t count,
+          uint8_t cls) {
+    size_t words = (count + 63) / 64;
+    char *meta = ((char *) pg) + sizeof(gc_page_t);
+
+    pg->next = NULL;
+    pg->prev = NULL;
+    pg->free = NULL;
+    pg->marks = (uint64_t *) meta;
+    pg->allocs = pg->marks + words;
+    pg->flags = (uint8_t *) (pg->allocs + words);
+    pg->slots = ((char *) pg) + align_up(sizeof(gc_page_t) + 2 * words * sizeof(uint64_t) + count, SLOT_ALIGN);
+    pg->end = pg->slots + count * size;
+    pg->bump = pg->slots;
+    pg->size = size;
+    pg->count = count;
+    pg->live = 0;
+    pg->cls = cls;
+    pg->young = 0;
+    pg->unswept = 0;
+    memset(meta, 0, pg->slots - meta);
+}
+
+static size_t
+page_capacity(size_t size) {
+    size_t count = (GC_PAGE_SIZE - sizeof(gc_page_t)) / size;
+    while (align_up(sizeof(gc_page_t) + 2 * ((count + 63) / 64) * sizeof(uint64_t) + count, SLOT_ALIGN) +
+           count * size > GC_PAGE_SIZE)
+        --count;
+    return count;
+}
+
+static gc_page_t *
+new_page(gc_t *gc,
+         uint8_t cls) {
+    gc_class_t *c;
+    gc_page_t *pg;
+    size_t size;
+
+    pg = aligned_alloc(GC_PAGE_SIZE, GC_PAGE_SIZE);
+    if (pg == NULL)
+        return NULL;
+
+    size = class_sizes[cls];
+    init_page(pg, size, page_capacity(size), cls);
+    page_map_set(gc, (uintptr_t) pg);
+
+    // new pages go last, so the cursor never revisits full pages
+    c = &gc->classes[cls];
+    pg->prev = c->last;
+    if (c->last)    c->last->next = pg;
+    else            c->pages = pg;
+    c->last = pg;
+    return pg;
+}
+
+// Allocates a block with a single slot for a big object.
+static gc_page_t *
+new_big_page(gc_t *gc,
+             size_t size) {
+    gc_page_t *pg;
+    size_t total;
+
+    size = align_up(size, POINTER_SIZE);
+    total = align_up(align_up(sizeof(gc_page_t) + 2 * sizeof(uint64_t) + 1, SLOT_ALIGN) + size, GC_PAGE_SIZE);
+    pg = aligned_alloc(GC_PAGE_SIZE, total);
+    if (pg == NULL)
+        return NULL;
+
+    init_page(pg, size, 1, GC_BIG_CLASS);
+    page_map_set(gc, (uintptr_t) pg);
+
+    pg->next = gc->bigs;
+    if (gc->bigs)   gc->bigs->prev = pg;
+    gc->bigs = pg;
+    return pg;
+}
+
+// Returns an empty page to the system.
+static void
+release_page(gc_t *gc,
+             gc_page_t *pg) {
+    if (pg->cls == GC_BIG_CLASS) {
+        if (pg->prev)   pg->prev->next = pg->next;
+        else            gc->bigs = pg->next;
+        if (pg->next)   pg->next->prev = pg->prev;
+    } else {
+        gc_class_t *c = &gc->classes[pg->cls];
+        if (pg->prev)   pg->prev->next = pg->next;
+        else            c->pages = pg->next;
+        if (pg->next)   pg->next->prev = pg->prev;
+        else            c->last = pg->prev;
+        if (c->cur == pg)
+            c->cur = pg->next;
+    }
+
+    page_map_unset(gc, (uintptr_t) pg);
+    free(pg);
+}
+
+// Finds the page and slot of an object. Objects are found by address
+// arithmetic: only pointers to the start of an allocated slot match.
+static gc_page_t *
+find_object(gc_t *gc,
+            void *ptr,
+            size_t *idx) {
+    gc_page_t *pg;
+    size_t off;
+
+    // objects are always aligned, so skip tagged words
+    if (((uintptr_t) ptr) & (POINTER_SIZE - 1))
+        return NULL;
+
+    pg = gc_page_of(ptr);
+    if (!page_map_ref(gc, (uintptr_t) pg) || (char *) ptr < pg->slots || (char *) ptr >= pg->bump)
+        return NULL;
+
+    off = ((char *) ptr) - pg->slots;
+    if (off % pg->size != 0)
+        return NULL;
+
+    *idx = off / pg->size;
+    return gc_bit_ref(pg->allocs, *idx) ? pg : NULL;
+}
+
+// Like `find_object` but also matches pointers into the middle of
+// an allocated slot, e.g., return addresses into a code object.
+// Only used when marking: `ptr` is moved to the start of the object.
+static gc_page_t *
+find_interior(gc_t *gc,
+              void **ptr,
+              size_t *idx) {
+    gc_page_t *pg;
+
+    // objects are always aligned, so skip tagged words
+    if (((uintptr_t) *ptr) & (POINTER_SIZE - 1))
+        return NULL;
+
+    pg = gc_page_of(*ptr);
+    if (!page_map_ref(gc, (uintptr_t) pg) || (char *) *ptr < pg->slots || (char *) *ptr >= pg->bump)
+        return NULL;
+
+    *idx = gc_page_index(pg, *ptr);
+    if (!gc_bit_ref(pg->allocs, *idx))
+        return NULL;
+
+    *ptr = gc_page_ref(pg, *idx);
+    return pg;
+}
+
+// Returns a slot to the free list of its page (does not update stats).
+static void
+free_slot(gc_page_t *pg,
+          size_t i) {
+    void *ptr = gc_page_ref(pg, i);
+
+    pg->flags[i] = 0;
+    gc_bit_unset(pg->allocs, i);
+    gc_bit_unset(pg->marks, i);
+    ptr_ref(ptr) = pg->free;
+    pg->free = ptr;
+    --pg->live;
+}
+
+// Frees a slot (does not release the page).
+static void
+free_object(gc_t *gc,
+            gc_page_t *pg,
+            size_t i,
+            int destroy) {
+    if (pg->flags[i] & GC_OBJ_HOOK) {
+        void *ptr = gc_page_ref(pg, i);
+        gc_hook_t *h = hook_remove(gc, ptr);
+        if (destroy && h->dtor)
+            h->dtor(ptr, NULL);
+        free(h);
+    }
+
+    free_slot(pg, i);
+    gc->allocs -= pg->size;
+    --gc->size;
 }
 
+// Sets the destructor and marker of an object.
 static void
-gc_expand_if_needed(gc_t *gc) {
-    if (gc_load(gc) > GC_TABLE_LOAD_FACTOR) {      // needs larger size
-        gc_resize(gc, gc->alloc_ptr + 1);
+set_object_hooks(gc_t *gc,
+                 gc_page_t *pg,
+                 size_t i,
+                 gc_dtor_t dtor,
+                 gc_mark_t mrk) {
+    void *ptr = gc_page_ref(pg, i);
+
+    if (pg->flags[i] & GC_OBJ_HOOK)
+        free(hook_remove(gc, ptr));
+    pg->flags[i] &= ~(GC_OBJ_HOOK | GC_OBJ_ATOMIC | GC_OBJ_TAGGED);
+
+    if (mrk == (gc_mark_t) GC_atomic_mrk) {
+        pg->flags[i] |= GC_OBJ_ATOMIC;
+        mrk = NULL;
+    } else if (mrk == (gc_mark_t) gc_tagged_mrk) {
+        pg->flags[i] |= GC_OBJ_TAGGED;
+        mrk = NULL;
+    }
+
+    if (dtor || mrk) {
+        gc_hook_t *h = hook_add(gc, ptr);
+        h->dtor = dtor;
+        h->mrk = mrk;
+        pg->flags[i] |= GC_OBJ_HOOK;
     }
 }
 
+/* Marking */
+
+// Marks every pointer within an object, calling `mark(ctx, p)`
+// on each pointer `p`.
 static void
-gc_shrink_if_needed(gc_t *gc) {
-    size_t *ideal_ptr = gc->alloc_ptr;
-    // compute ideal size
-    while ((*ideal_ptr > 4 * gc->size) && ideal_ptr != &bucket_sizes[0])
-        --ideal_ptr;
+gc_scan_object(gc_t *gc,
+               void *ctx,
+               gc_page_t *pg,
+               size_t i,
+               void (*mark)(void*, void*)) {
+    void *ptr;
+
+    if (pg->flags[i] & GC_OBJ_ATOMIC)
+        return;
+
+    ptr = gc_page_ref(pg, i);
+    if (pg->flags[i] & GC_OBJ_HOOK) {
+        gc_hook_t *h = hook_find(gc, ptr);
+        if (h->mrk) {       // custom marker
+            h->mrk(mark, ctx, ptr);
+            return;
+        }
+    }
 
-    if (ideal_ptr != gc->alloc_ptr)
-        gc_resize(gc, ideal_ptr);
+    if (pg->flags[i] & GC_OBJ_TAGGED) {
+        gc_mark_t mrk = gc->tag_mrks[*((uint8_t *) ptr)];
+        if (mrk) {          // marker of the type tag
+            mrk(mark, ctx, ptr);
+            return;
+        }
+    }
+
+    // default (conservative)
+    for (size_t k = 0; k < pg->size / POINTER_SIZE; ++k)
+        mark(ctx, ptr_arr_ref(ptr, k));
 }
 
+// Marks an object, pushing it onto the grey stack to be scanned
+// later (see `gc_drain`). Marks are sticky: a marked object is old,
+// so marking stops at the old generation.
 static void
-gc_mark_ptr(gc_t *gc,
+gc_mark_ptr(void *ctx,
             void *ptr) {
+    gc_t *gc = ctx;
+    gc_page_t *pg;
     size_t i;
 
-#if GC_HEAP_HEURISTIC
-    // decent heuristic for possible "heap" location
-    if (ptr < (void*) gc_mark_ptr || ptr > gc->stack_bottom)
+    pg = find_interior(gc, &ptr, &i);
+    if (pg == NULL ||                       // not an object
+        gc_bit_ref(pg->marks, i) ||         // early exit if root, old, or already marked
+        (pg->flags[i] & GC_OBJ_ROOT))
         return;
-#endif
 
-    i = gc_hash(ptr) % gc->alloc;
-    for (gc_record_t *r = gc->buckets[i]; r; r = gc_record_next(r)) {
-        if (ptr == gc_record_ptr(r)) {    // found correct record
-            if (gc_record_markp(r) ||     // early exit if root or already marked
-                gc_record_rootp(r))
-                return;
+    gc_bit_set(pg->marks, i);
+    vec_push(&gc->grey, ptr);
+}
 
-            // set mark flag
-            gc_record_mark_set(r);
+// Marks a pointer found on the stack or in a root. The mutator
+// writes to such objects without a write barrier, so they are
+// scanned now (even if old) and again at the next minor collection.
+static void
+gc_mark_direct(void *ctx,
+               void *ptr) {
+    gc_t *gc = ctx;
+    gc_page_t *pg;
+    size_t i;
 
-            // recurse into pointer block
-            if (!r->mrk) {                                      // default (conservative)
-                for (size_t k = 0; k < r->size / POINTER_SIZE; ++k)
-                    gc_mark_ptr(gc, ptr_arr_ref(gc_record_ptr(r), k));
-            } else if (r->mrk != (gc_mark_t) GC_atomic_mrk) {    // custom marker
-                r->mrk(gc_mark_ptr, gc, gc_record_ptr(r));
-            }
+    pg = find_interior(gc, &ptr, &i);
+    if (pg == NULL || (pg->flags[i] & (GC_OBJ_ROOT | GC_OBJ_REMEMBER)))
+        return;
 
-            return;
-        }
-    }
+    gc_bit_set(pg->marks, i);
+    pg->flags[i] |= GC_OBJ_REMEMBER;
+    vec_push(&gc->remembered, ptr);
+    vec_push(&gc->grey, ptr);
 }
 
 __attribute__((no_sanitize("address")))
@@ -167,7 +482,7 @@ gc_mark_stack(gc_t *gc) {
     b = gc->stack_bottom;
     t = &b;
     for (void *p = t; p <= b; p += POINTER_SIZE)
-        gc_mark_ptr(gc, ptr_ref(p));
+        gc_mark_direct(gc, ptr_ref(p));
 }
 
 static void
@@ -175,23 +490,14 @@ gc_mark(gc_t *gc) {
     jmp_buf env;
     void (*volatile mark_stack)(gc_t*) = gc_mark_stack;
 
-    // exit if nothing allocated
-    if (gc->size == 0)
-        return;
-
     // mark roots
-    for (size_t i = 0; i < gc->alloc; ++i) {
-        for (gc_record_t *r = gc->buckets[i]; r; r = gc_record_next(r)) {
-            if (gc_record_rootp(r)) {
-                gc_record_mark_set(r);
-                if (!r->mrk) {                                      // default (conservative)
-                    for (size_t k = 0; k < r->size / POINTER_SIZE; ++k)
-                        gc_mark_ptr(gc, ptr_arr_ref(gc_record_ptr(r), k));
-                } else if (r->mrk != (gc_mark_t) GC_atomic_mrk) {    // custom marker
-                    r->mrk(gc_mark_ptr, gc, gc_record_ptr(r));
-                }
-            }
-        }
+    for (size_t i = 0; i < gc->roots.size; ++i) {
+        gc_page_t *pg;
+        size_t j;
+
+        pg = find_object(gc, gc->roots.data[i], &j);
+        gc_bit_set(pg->marks, j);
+        gc_scan_object(gc, gc, pg, j, gc_mark_direct);
     }
 
     // push registers and mark stack
@@ -200,60 +506,574 @@ gc_mark(gc_t *gc) {
     mark_stack(gc);
 }
 
+// Scans at most `budget` grey objects, returning true
+// if there are no more grey objects.
+static int
+gc_drain(gc_t *gc,
+         size_t budget) {
+    while (gc->grey.size > 0 && budget > 0) {
+        gc_page_t *pg;
+        size_t i;
+
+        // skip objects freed since they were marked
+        pg = find_object(gc, gc->grey.data[--gc->grey.size], &i);
+        if (pg)     gc_scan_object(gc, gc, pg, i, gc_mark_ptr);
+        --budget;
+    }
+
+    return gc->grey.size == 0;
+}
+
+// Rescans every remembered object: the mark phase remembers
+// a new set of objects for the next collection.
+static void
+gc_mark_remembered(gc_t *gc) {
+    for (size_t i = 0; i < gc->remembered.size; ++i) {
+        void *ptr = gc->remembered.data[i];
+        gc_page_t *pg = gc_page_of(ptr);
+        size_t j = gc_page_index(pg, ptr);
+
+        pg->flags[j] &= ~GC_OBJ_REMEMBER;
+        gc_scan_object(gc, gc, pg, j, gc_mark_ptr);
+    }
+
+    gc->remembered.size = 0;
+}
+
+/* Parallel marking and sweeping */
+
+// Marks an object, pushing it onto the stack of the worker `ctx`.
+// Workers may race to mark the same object, so the mark bit is set
+// atomically and only the winner scans it.
+static void
+gc_mark_par(void *ctx,
+            void *ptr) {
+    gc_worker_t *w = ctx;
+    gc_page_t *pg;
+    uint64_t bit, *word;
+    size_t i;
+
+    pg = find_interior(w->gc, &ptr, &i);
+    if (pg == NULL || (pg->flags[i] & GC_OBJ_ROOT))
+        return;
+
+    bit = ((uint64_t) 1) << (i % 64);
+    word = &pg->marks[i / 64];
+    if ((__atomic_load_n(word, __ATOMIC_RELAXED) & bit) ||
+        (__atomic_fetch_or(word, bit, __ATOMIC_RELAXED) & bit))
+        return;
+
+    pthread_mutex_lock(&w->lock);
+    vec_push(&w->stack, ptr);
+    pthread_mutex_unlock(&w->lock);
+}
+
+static int
+worker_pop(gc_worker_t *w,
+           void **ptr) {
+    int found = 0;
+
+    pthread_mutex_lock(&w->lock);
+    if (w->stack.size > 0) {
+        *ptr = w->stack.data[--w->stack.size];
+        found = 1;
+    }
+
+    pthread_mutex_unlock(&w->lock);
+    return found;
+}
+
+// Moves half of the grey objects of some other worker to `w`.
+// Returns true if any were taken.
+static int
+worker_steal(gc_worker_t *w) {
+    gc_pool_t *pool = w->gc->pool;
+
+    for (size_t k = 1; k < pool->count; ++k) {
+        gc_worker_t *v = &pool->workers[(w->id + k) % pool->count];
+        gc_worker_t *first, *second;
+        size_t n;
+
+        // lock in a fixed order
+        first = (v->id < w->id) ? v : w;
+        second = (v->id < w->id) ? w : v;
+        pthread_mutex_lock(&first->lock);
+        pthread_mutex_lock(&second->lock);
+        n = (v->stack.size + 1) / 2;
+        for (size_t j = 0; j < n; ++j)
+            vec_push(&w->stack, v->stack.data[--v->stack.size]);
+        pthread_mutex_unlock(&second->lock);
+        pthread_mutex_unlock(&first->lock);
+
+        if (n > 0)
+            return 1;
+    }
+
+    return 0;
+}
+
+static int
+pool_has_work(gc_pool_t *pool) {
+    for (size_t k = 0; k < pool->count; ++k) {
+        gc_worker_t *w = &pool->workers[k];
+        size_t size;
+
+        pthread_mutex_lock(&w->lock);
+        size = w->stack.size;
+        pthread_mutex_unlock(&w->lock);
+        if (size > 0)
+            return 1;
+    }
+
+    return 0;
+}
+
+// Scans grey objects, stealing from other workers when out of work.
+// Only active workers push objects, so marking is done once every
+// worker is idle.
+static void
+gc_mark_work(gc_worker_t *w) {
+    gc_pool_t *pool = w->gc->pool;
+    void *ptr;
+
+    for (;;) {
+        while (worker_pop(w, &ptr)) {
+            gc_page_t *pg;
+            size_t i;
+
+            pg = find_object(w->gc, ptr, &i);
+            if (pg)     gc_scan_object(w->gc, w, pg, i, gc_mark_par);
+        }
+
+        if (worker_steal(w))
+            continue;
+
+        // idle until another worker has objects to steal
+        __atomic_sub_fetch(&pool->active, 1, __ATOMIC_SEQ_CST);
+        for (;;) {
+            if (__atomic_load_n(&pool->active, __ATOMIC_SEQ_CST) == 0)
+                return;
+
+            if (pool_has_work(pool)) {
+                __atomic_add_fetch(&pool->active, 1, __ATOMIC_SEQ_CST);
+                if (worker_steal(w))
+                    break;
+                __atomic_sub_fetch(&pool->active, 1, __ATOMIC_SEQ_CST);
+            }
+
+            sched_yield();
+        }
+    }
+}
+
+// Frees unmarked objects on pages claimed by `w`. Objects with hooks
+// are left for the collecting thread since the hook table is shared.
+static void
+gc_sweep_work(gc_worker_t *w) {
+    gc_pool_t *pool = w->gc->pool;
+    size_t n;
+
+    while ((n = __atomic_fetch_add(&pool->next, 1, __ATOMIC_RELAXED)) < pool->npages) {
+        gc_page_t *pg = pool->pages[n];
+        for (size_t k = 0; k < gc_page_words(pg); ++k) {
+            uint64_t dead = pg->allocs[k] & ~pg->marks[k];
+            while (dead) {
+                size_t i = 64 * k + __builtin_ctzll(dead);
+                if (pg->flags[i] & GC_OBJ_HOOK) {
+                    vec_push(&w->hooked, gc_page_ref(pg, i));
+                } else {
+                    free_slot(pg, i);
+                    w->freed_size += pg->size;
+                    ++w->freed;
+                }
+
+                dead &= dead - 1;
+            }
+        }
+    }
+}
+
+static void
+gc_run_task(gc_worker_t *w,
+            int task) {
+    if (task == GC_TASK_MARK)   gc_mark_work(w);
+    else                        gc_sweep_work(w);
+}
+
+static void *
+gc_worker_main(void *arg) {
+    gc_worker_t *w = arg;
+    gc_pool_t *pool = w->gc->pool;
+    size_t gen = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (pool->gen == gen && !pool->exit)
+            pthread_cond_wait(&pool->start, &pool->lock);
+        if (pool->exit)
+            break;
+
+        gen = pool->gen;
+        pthread_mutex_unlock(&pool->lock);
+        gc_run_task(w, pool->task);
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->pending == 0)
+            pthread_cond_signal(&pool->done);
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+// Runs a task on every worker, returning once all of them finish.
+// The calling thread is the first worker.
+static void
+gc_run_parallel(gc_t *gc,
+                int task) {
+    gc_pool_t *pool = gc->pool;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->task = task;
+    pool->pending = pool->count - 1;
+    pool->active = pool->count;
+    ++pool->gen;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    gc_run_task(&pool->workers[0], task);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->pending > 0)
+        pthread_cond_wait(&pool->done, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+static void
+gc_pool_create(gc_t *gc,
+               size_t count) {
+    gc_pool_t *pool = calloc(1, sizeof(gc_pool_t));
+
+    gc->pool = pool;
+    pool->count = count;
+    pool->workers = calloc(count, sizeof(gc_worker_t));
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    for (size_t k = 0; k < count; ++k) {
+        gc_worker_t *w = &pool->workers[k];
+        w->gc = gc;
+        w->id = k;
+        pthread_mutex_init(&w->lock, NULL);
+    }
+
+    for (size_t k = 1; k < count; ++k)
+        pthread_create(&pool->workers[k].thread, NULL, gc_worker_main, &pool->workers[k]);
+}
+
+static void
+gc_pool_destroy(gc_t *gc) {
+    gc_pool_t *pool = gc->pool;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->exit = 1;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (size_t k = 0; k < pool->count; ++k) {
+        gc_worker_t *w = &pool->workers[k];
+        if (k > 0)  pthread_join(w->thread, NULL);
+        pthread_mutex_destroy(&w->lock);
+        free(w->stack.data);
+        free(w->hooked.data);
+    }
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->start);
+    pthread_cond_destroy(&pool->done);
+    free(pool->workers);
+    free(pool);
+    gc->pool = NULL;
+}
+
+// Scans every grey object, in parallel if there are helper threads.
+static void
+gc_drain_all(gc_t *gc) {
+    gc_pool_t *pool = gc->pool;
+
+    if (pool == NULL) {
+        gc_drain(gc, SIZE_MAX);
+        return;
+    }
+
+    // deal grey objects to the workers
+    for (size_t i = 0; i < gc->grey.size; ++i)
+        vec_push(&pool->workers[i % pool->count].stack, gc->grey.data[i]);
+
+    gc->grey.size = 0;
+    gc_run_parallel(gc, GC_TASK_MARK);
+}
+
+// Sweeps pages in parallel, then frees objects with hooks
+// and releases empty pages.
+static void
+gc_sweep_par(gc_t *gc,
+             gc_page_t **pages,
+             size_t npages) {
+    gc_pool_t *pool = gc->pool;
+
+    pool->pages = pages;
+    pool->npages = npages;
+    pool->next = 0;
+    gc_run_parallel(gc, GC_TASK_SWEEP);
+
+    for (size_t k = 0; k < pool->count; ++k) {
+        gc_worker_t *w = &pool->workers[k];
+        for (size_t j = 0; j < w->hooked.size; ++j) {
+            gc_page_t *pg = gc_page_of(w->hooked.data[j]);
+            free_object(gc, pg, gc_page_index(pg, w->hooked.data[j]), 1);
+        }
+
+        gc->allocs -= w->freed_size;
+        gc->size -= w->freed;
+        w->hooked.size = 0;
+        w->freed = 0;
+        w->freed_size = 0;
+    }
+
+    for (size_t k = 0; k < npages; ++k) {
+        gc_page_t *pg = pages[k];
+        pg->young = 0;
+        pg->unswept = 0;
+        if (pg->live == 0)
+            release_page(gc, pg);
+    }
+}
+
+/* Sweeping */
+
+// Clears the marks of a page.
+static void
+gc_unmark_page(gc_page_t *pg) {
+    memset(pg->marks, 0, gc_page_words(pg) * sizeof(uint64_t));
+    pg->young = 0;
+}
+
+// Clears all marks, so every object is young again.
 static void
 gc_unmark(gc_t *gc) {
-    for (size_t i = 0; i < gc->alloc; ++i) {
-        for (gc_record_t *r = gc->buckets[i]; r; r = gc_record_next(r))
-            gc_record_mark_unset(r);
+    for (size_t c = 0; c < GC_CLASS_COUNT; ++c) {
+        for (gc_page_t *pg = gc->classes[c].pages; pg; pg = pg->next)
+            gc_unmark_page(pg);
+    }
+
+    for (gc_page_t *pg = gc->bigs; pg; pg = pg->next)
+        gc_unmark_page(pg);
+
+    for (size_t i = 0; i < gc->remembered.size; ++i) {
+        gc_page_t *pg = gc_page_of(gc->remembered.data[i]);
+        pg->flags[gc_page_index(pg, gc->remembered.data[i])] &= ~GC_OBJ_REMEMBER;
+    }
+
+    gc->nursery.size = 0;
+    gc->remembered.size = 0;
+    gc->grey.size = 0;
+}
+
+// Frees every unmarked object of a page and releases the page
+// if it is empty, returning true if released. Survivors stay
+// marked (old).
+static int
+gc_sweep_page(gc_t *gc,
+              gc_page_t *pg) {
+    for (size_t w = 0; w < gc_page_words(pg); ++w) {
+        uint64_t dead = pg->allocs[w] & ~pg->marks[w];
+        while (dead) {
+            free_object(gc, pg, 64 * w + __builtin_ctzll(dead), 1);
+            dead &= dead - 1;
+        }
+    }
+
+    pg->young = 0;
+    pg->unswept = 0;
+    if (pg->live == 0) {
+        release_page(gc, pg);
+        return 1;
     }
+
+    return 0;
 }
 
+static void
+gc_sweep_finish(gc_t *gc) {
+    for (size_t c = 0; c < GC_CLASS_COUNT; ++c)
+        gc->classes[c].cur = gc->classes[c].pages;
+
+    gc->nursery.size = 0;
+    gc->dirty = 0;
+}
+
+// Sweeps every page.
 static void
 gc_sweep(gc_t *gc) {
-    for (size_t i = 0; i < gc->alloc; ++i) {
-        gc_record_t *r = gc->buckets[i], *pr = NULL;
-        while (r) {
-            if (!gc_record_markp(r)) {      // unmarked
-                gc_record_t *nr = gc_record_next(r);
-
-                // update stats and remove record
-                gc->allocs -= r->size;
-                --gc->size;
-                
-                // call dtor if needed and free record and bucket entry
-                if (r->dtor)    r->dtor(gc_record_ptr(r), NULL);
-                free(r);
-
-                // repair bucket entries as needed
-                if (pr)     gc_record_next_set(pr, nr);
-                else        gc->buckets[i] = nr;
-                
-                r = nr;
-            } else {
-                pr = r;
-                r = gc_record_next(r);
-            }
+    if (gc->pool) {
+        gc_vec_t pages = { NULL, 0, 0 };
+        for (size_t c = 0; c < GC_CLASS_COUNT; ++c) {
+            for (gc_page_t *pg = gc->classes[c].pages; pg; pg = pg->next)
+                vec_push(&pages, pg);
+        }
+
+        for (gc_page_t *pg = gc->bigs; pg; pg = pg->next)
+            vec_push(&pages, pg);
+
+        gc_sweep_par(gc, (gc_page_t **) pages.data, pages.size);
+        gc_sweep_finish(gc);
+        free(pages.data);
+        return;
+    }
+
+    for (size_t c = 0; c < GC_CLASS_COUNT; ++c) {
+        gc_page_t *pg = gc->classes[c].pages;
+        while (pg) {
+            gc_page_t *npg = pg->next;
+            gc_sweep_page(gc, pg);
+            pg = npg;
         }
     }
 
-    // reset dirty byte counter and unmark
+    gc_page_t *pg = gc->bigs;
+    while (pg) {
+        gc_page_t *npg = pg->next;
+        gc_sweep_page(gc, pg);
+        pg = npg;
+    }
+
+    gc_sweep_finish(gc);
+}
+
+// Sweeps every page in the nursery: only these pages
+// have been allocated into since the last collection.
+static void
+gc_sweep_nursery(gc_t *gc) {
+    if (gc->pool) {
+        gc_sweep_par(gc, (gc_page_t **) gc->nursery.data, gc->nursery.size);
+    } else {
+        for (size_t i = 0; i < gc->nursery.size; ++i)
+            gc_sweep_page(gc, gc->nursery.data[i]);
+    }
+
+    gc_sweep_finish(gc);
+}
+
+// Defers sweeping of small-object pages until allocation
+// reaches them (see `gc_alloc`). Big objects are swept now.
+static void
+gc_sweep_lazy(gc_t *gc) {
+    for (size_t c = 0; c < GC_CLASS_COUNT; ++c) {
+        for (gc_page_t *pg = gc->classes[c].pages; pg; pg = pg->next) {
+            pg->young = 0;
+            pg->unswept = 1;
+        }
+    }
+
+    gc_page_t *pg = gc->bigs;
+    while (pg) {
+        gc_page_t *npg = pg->next;
+        gc_sweep_page(gc, pg);
+        pg = npg;
+    }
+
+    gc_sweep_finish(gc);
+    gc->flags |= GC_SWEEPING;
+}
+
+// Sweeps every page not yet swept since the last collection.
+static void
+gc_finish_sweep(gc_t *gc) {
+    if (!(gc->flags & GC_SWEEPING))
+        return;
+
+    for (size_t c = 0; c < GC_CLASS_COUNT; ++c) {
+        gc_page_t *pg = gc->classes[c].pages;
+        while (pg) {
+            gc_page_t *npg = pg->next;
+            if (pg->unswept)
+                gc_sweep_page(gc, pg);
+            pg = npg;
+        }
+    }
+
+    gc->flags &= ~GC_SWEEPING;
+}
+
+/* Major collections */
+
+// Finishes a major collection in a single pause: objects on the
+// stack or mutated since they were marked are rescanned.
+static void
+gc_finish_major(gc_t *gc,
+                int lazy) {
+    gc_mark_remembered(gc);
+    gc_mark(gc);
+    gc_drain_all(gc);
+
+    gc->flags &= ~GC_MARKING;
+    if (lazy)   gc_sweep_lazy(gc);
+    else        gc_sweep(gc);
+    gc->minors = 0;
+}
+
+// Incremental step of a major collection: the stack and roots are
+// marked each step since the mutator writes to objects referenced
+// from them without a write barrier.
+static void
+gc_mark_step(gc_t *gc) {
+    gc_mark(gc);
+    if (gc_drain(gc, gc->budget))
+        gc_finish_major(gc, 1);
     gc->dirty = 0;
+}
+
+// Starts an incremental major collection.
+static void
+gc_start_major(gc_t *gc) {
+    gc_finish_sweep(gc);
     gc_unmark(gc);
-    gc_shrink_if_needed(gc);
+    gc->flags |= GC_MARKING;
+    gc_mark_step(gc);
 }
 
 /*************** Interface ******************/
 
 gc_t *
 gc_create(void *stack) {
-    gc_t *gc = malloc(sizeof(gc_t));
+    static int init = 0;
+    gc_t *gc;
+
+    if (!init) {
+        init_size_classes();
+        init = 1;
+    }
+
+    gc = malloc(sizeof(gc_t));
+    gc->classes = calloc(GC_CLASS_COUNT, sizeof(gc_class_t));
+    gc->bigs = NULL;
+    gc->page_map = calloc(GC_MAP_TOP_SIZE, sizeof(uint64_t*));
+    gc->hooks_alloc = GC_HOOK_TABLE_SIZE;
+    gc->hooks_size = 0;
+    gc->hooks = calloc(gc->hooks_alloc, sizeof(gc_hook_t*));
+    gc->tag_mrks = calloc(GC_TAG_COUNT, sizeof(gc_mark_t));
+    gc->nursery = (gc_vec_t) { NULL, 0, 0 };
+    gc->remembered = (gc_vec_t) { NULL, 0, 0 };
+    gc->roots = (gc_vec_t) { NULL, 0, 0 };
+    gc->grey = (gc_vec_t) { NULL, 0, 0 };
+    gc->pool = NULL;
     gc->stack_bottom = stack;
-    gc->alloc_ptr = &bucket_sizes[0];
-    gc->alloc = *gc->alloc_ptr;
-    gc->buckets = (gc_record_t **) calloc(gc->alloc, sizeof(gc_record_t*));
     gc->size = 0;
     gc->dirty = 0;
     gc->allocs = 0;
+    gc->minors = 0;
+    gc->budget = GC_PAUSE_BUDGET;
     gc->flags = GC_COLLECT;
 
     return gc;
@@ -262,16 +1082,31 @@ gc_create(void *stack) {
 void
 gc_destroy(gc_t* gc) {
     // remove root flags
-    for (size_t i = 0; i < gc->alloc; ++i) {
-        for (gc_record_t *r = gc->buckets[i]; r; r = gc_record_next(r)) {
-            if (gc_record_rootp(r))
-                gc_record_root_unset(r);
-        }
+    for (size_t i = 0; i < gc->roots.size; ++i) {
+        gc_page_t *pg = gc_page_of(gc->roots.data[i]);
+        pg->flags[gc_page_index(pg, gc->roots.data[i])] &= ~GC_OBJ_ROOT;
     }
-    
-    // free up gc structure
+
+    // stop helper threads
+    if (gc->pool)
+        gc_pool_destroy(gc);
+
+    // free every object and page
+    gc->flags &= ~(GC_MARKING | GC_SWEEPING);
+    gc_unmark(gc);
     gc_sweep(gc);
-    free(gc->buckets);
+
+    for (size_t i = 0; i < GC_MAP_TOP_SIZE; ++i)
+        free(gc->page_map[i]);
+
+    free(gc->nursery.data);
+    free(gc->remembered.data);
+    free(gc->roots.data);
+    free(gc->grey.data);
+    free(gc->page_map);
+    free(gc->hooks);
+    free(gc->tag_mrks);
+    free(gc->classes);
     free(gc);
 }
 
@@ -285,161 +1120,264 @@ gc_resume(gc_t *gc){
     gc->flags |= GC_COLLECT;
 }
 
-void
-gc_remove(gc_t *gc,
-          void *ptr,
-          int destroy) {
-    gc_record_t *r, *pr;
+void *
+gc_alloc(gc_t *gc,
+         size_t size,
+         gc_dtor_t dtor,
+         gc_mark_t mrk) {
+    gc_page_t *pg;
+    void *ptr;
     size_t i;
 
-    i = gc_hash(ptr) % gc->alloc;
-    r = gc->buckets[i];
-    pr = NULL;
-    while (r) {
-        if (ptr == gc_record_ptr(r)) {    // found correct record
-            // update stats
-            gc->allocs -= r->size;
-            --gc->size;
-
-            // repair bucket entries as needed
-            if (pr)     gc_record_next_set(pr, r->next);
-            else        gc->buckets[i] = gc_record_next(r);
-
-            // free if needed
-            if (destroy)    free(r);
-            return;
+    if (size <= GC_MAX_SMALL_SIZE) {
+        uint8_t cls = size_classes[(size + POINTER_SIZE - 1) / POINTER_SIZE];
+        gc_class_t *c = &gc->classes[cls];
+
+        // find a page with a free slot, sweeping pages as needed
+        pg = c->cur;
+        while (pg) {
+            gc_page_t *npg = pg->next;
+            if (!(pg->unswept && gc_sweep_page(gc, pg)) &&
+                (pg->free || pg->bump != pg->end))
+                break;
+            pg = npg;
+        }
+
+        if (pg == NULL) {
+            pg = new_page(gc, cls);
+            if (pg == NULL) {
+                gc_collect(gc);
+                pg = new_page(gc, cls);
+                if (pg == NULL)
+                    return NULL;
+            }
         }
 
-        pr = r;
-        r = gc_record_next(r);
+        c->cur = pg;
+        if (pg->free) {
+            ptr = pg->free;
+            pg->free = ptr_ref(ptr);
+        } else {
+            ptr = pg->bump;
+            pg->bump += pg->size;
+        }
+    } else {
+        pg = new_big_page(gc, size);
+        if (pg == NULL) {
+            gc_collect(gc);
+            pg = new_big_page(gc, size);
+            if (pg == NULL)
+                return NULL;
+        }
+
+        ptr = pg->slots;
+        pg->bump = pg->end;
     }
-}
 
-gc_record_t *
-gc_alloc_record(gc_t *gc,
-                size_t size,
-                gc_dtor_t dtor,
-                gc_mark_t mrk) {
-    gc_record_t *r = malloc(size + sizeof(gc_record_t));
-    if (r == NULL)
-    {
-        gc_collect(gc);
-        r = malloc(size + sizeof(gc_record_t));
-        if (r == NULL)
-            return NULL;
+    // new pages are young
+    if (!pg->young) {
+        pg->young = 1;
+        vec_push(&gc->nursery, pg);
     }
 
-    r->next = NULL;
-    r->size = size;
-    r->dtor = dtor;
-    r->mrk = mrk;
-    return r;
+    i = gc_page_index(pg, ptr);
+    gc_bit_set(pg->allocs, i);
+    memset(ptr, 0, pg->size);
+    set_object_hooks(gc, pg, i, dtor, mrk);
+    ++pg->live;
+
+    // update stats
+    gc->dirty += pg->size;
+    gc->allocs += pg->size;
+    ++gc->size;
+    return ptr;
 }
 
-gc_record_t *
-gc_calloc_record(gc_t *gc,
-                size_t nmem,
-                size_t size,
-                gc_dtor_t dtor,
-                gc_mark_t mrk) {
-    gc_record_t *r = calloc(1, (nmem * size) + sizeof(gc_record_t));
-    if (r == NULL)
-    {
-        gc_collect(gc);
-        r = calloc(1, (nmem * size) + sizeof(gc_record_t));
-        if (r == NULL)
-            return NULL;
-    }
-
-    r->next = NULL;
-    r->size = nmem * size;
-    r->dtor = dtor;
-    r->mrk = mrk;
-    return r;
-}
-
-gc_record_t *
-gc_realloc_record(gc_t *gc,
-                  gc_record_t *r,
-                  size_t size,
-                  gc_dtor_t dtor,
-                  gc_mark_t mrk) {
-    gc_record_t *r2;
-    uint8_t flags;
-
-    flags = gc_record_flags(r);
-    r2 = realloc(r, size + sizeof(gc_record_t));
-    if (r2 == NULL)
-    {
-        gc_collect(gc);
-        r2 = realloc(r, size + sizeof(gc_record_t));
-        if (r2 == NULL)
-            return NULL;
-    }
-
-    r2->next = NULL;
-    r2->size = size;
-    r2->dtor = dtor;
-    r2->mrk = mrk;
-    
-    if (flags & GC_RECORD_ROOT)
-        gc_record_root_set(r2);
-    return r2;
-}
-
-gc_record_t *
-gc_get_record(gc_t *gc,
-              void *ptr) {
-    size_t i = gc_hash(ptr) % gc->alloc;
-    for (gc_record_t *r = gc->buckets[i]; r; r = gc_record_next(r)) {
-        if (ptr == gc_record_ptr(r)) {
-            return r;
-        }
+void *
+gc_realloc(gc_t *gc,
+           void *ptr,
+           size_t size,
+           gc_dtor_t dtor,
+           gc_mark_t mrk) {
+    gc_page_t *pg;
+    void *nptr;
+    size_t i;
+
+    pg = find_object(gc, ptr, &i);
+    if (pg == NULL)
+        return gc_alloc(gc, size, dtor, mrk);
+
+    // still fits
+    if (size <= pg->size && (pg->cls == GC_BIG_CLASS || size_classes[(size + POINTER_SIZE - 1) / POINTER_SIZE] == pg->cls)) {
+        set_object_hooks(gc, pg, i, dtor, mrk);
+        return ptr;
     }
 
-    return NULL;
+    // otherwise, move the object
+    nptr = gc_alloc(gc, size, dtor, mrk);
+    if (nptr == NULL)
+        return NULL;
+
+    pg = find_object(gc, ptr, &i);
+    memcpy(nptr, ptr, (size < pg->size) ? size : pg->size);
+    if (pg->flags[i] & GC_OBJ_ROOT)
+        gc_register_root(gc, nptr);
+
+    gc_free(gc, ptr);
+    return nptr;
 }
 
 void
-gc_add_record(gc_t *gc,
-              gc_record_t *record) {
-    // resize and add
-    gc_expand_if_needed(gc);
-    insert_record(gc, record);
+gc_free(gc_t *gc,
+        void *ptr) {
+    gc_page_t *pg;
+    size_t i;
 
-    // update stats
-    gc->dirty += record->size;
-    gc->allocs += record->size;
-    ++gc->size;
+    pg = find_object(gc, ptr, &i);
+    if (pg == NULL)
+        return;
+
+    // remove from any object list
+    if (pg->flags[i] & GC_OBJ_REMEMBER)     vec_remove(&gc->remembered, ptr);
+    if (pg->flags[i] & GC_OBJ_ROOT)         vec_remove(&gc->roots, ptr);
+
+    free_object(gc, pg, i, 0);
+    if (pg->cls == GC_BIG_CLASS) {
+        if (pg->young)
+            vec_remove(&gc->nursery, pg);
+        release_page(gc, pg);
+    }
 }
 
 void
 gc_collect(gc_t *gc) {
+    // exit if nothing allocated
+    if (gc->size == 0)
+        return;
+
+    // finish any incremental collection
+    gc_finish_sweep(gc);
+    if (!(gc->flags & GC_MARKING)) {
+        gc_unmark(gc);
+        gc->flags |= GC_MARKING;
+    }
+
+    gc_finish_major(gc, 0);
+}
+
+void
+gc_collect_minor(gc_t *gc) {
+    // exit if nothing allocated
+    if (gc->size == 0)
+        return;
+
+    gc_finish_sweep(gc);
+    gc_mark_remembered(gc);
     gc_mark(gc);
-    gc_sweep(gc);
+    gc_drain_all(gc);
+    gc_sweep_nursery(gc);
+    ++gc->minors;
+}
+
+void
+gc_collect_step(gc_t *gc) {
+    if (gc->flags & GC_MARKING)
+        gc_mark_step(gc);
+    else if (gc->minors < GC_MINOR_PER_MAJOR)
+        gc_collect_minor(gc);
+    else if (gc->budget == 0)
+        gc_collect(gc);
+    else if (gc->size > 0)
+        gc_start_major(gc);
+}
+
+void
+gc_set_pause_budget(gc_t *gc,
+                    size_t budget) {
+    gc->budget = budget;
+}
+
+void
+gc_set_threads(gc_t *gc,
+               size_t count) {
+    if (gc->pool)
+        gc_pool_destroy(gc);
+    if (count > 1)
+        gc_pool_create(gc, count);
 }
 
 void
 gc_register_dtor(gc_t *gc,
                  void *ptr,
                  gc_dtor_t dtor) {
-    gc_record_t *r = gc_get_record(gc, ptr);
-    if (r)  r->dtor = dtor;
+    gc_page_t *pg;
+    size_t i;
+
+    pg = find_object(gc, ptr, &i);
+    if (pg) {
+        hook_add(gc, ptr)->dtor = dtor;
+        pg->flags[i] |= GC_OBJ_HOOK;
+    }
 }
 
 void
 gc_register_mrk(gc_t *gc,
                 void *ptr,
                 gc_mark_t mrk) {
-    gc_record_t *r = gc_get_record(gc, ptr);
-    if (r)  r->mrk = mrk;
+    gc_page_t *pg;
+    size_t i;
+
+    pg = find_object(gc, ptr, &i);
+    if (pg == NULL)
+        return;
+
+    if (mrk == (gc_mark_t) GC_atomic_mrk) {
+        pg->flags[i] = (pg->flags[i] & ~GC_OBJ_TAGGED) | GC_OBJ_ATOMIC;
+        mrk = NULL;
+    } else {
+        pg->flags[i] &= ~GC_OBJ_ATOMIC;
+    }
+
+    if (mrk || (pg->flags[i] & GC_OBJ_HOOK)) {
+        hook_add(gc, ptr)->mrk = mrk;
+        pg->flags[i] |= GC_OBJ_HOOK;
+    }
 }
 
 void
 gc_register_root(gc_t *gc,
                  void *ptr) {
-    gc_record_t *r = gc_get_record(gc, ptr);
-    if (r)  gc_record_root_set(r);
+    gc_page_t *pg;
+    size_t i;
+
+    pg = find_object(gc, ptr, &i);
+    if (pg && !(pg->flags[i] & GC_OBJ_ROOT)) {
+        if (pg->flags[i] & GC_OBJ_REMEMBER)
+            vec_remove(&gc->remembered, ptr);
+
+        pg->flags[i] = (pg->flags[i] & ~GC_OBJ_REMEMBER) | GC_OBJ_ROOT;
+        vec_push(&gc->roots, ptr);
+    }
+}
+
+void
+gc_register_tag_mrk(gc_t *gc,
+                    uint8_t tag,
+                    gc_mark_t mrk) {
+    gc->tag_mrks[tag] = mrk;
+}
+
+void
+gc_write_barrier(gc_t *gc,
+                 void *ptr) {
+    gc_page_t *pg;
+    size_t i;
+
+    pg = find_interior(gc, &ptr, &i);
+    if (pg && gc_bit_ref(pg->marks, i) && !(pg->flags[i] & (GC_OBJ_REMEMBER | GC_OBJ_ROOT))) {
+        pg->flags[i] |= GC_OBJ_REMEMBER;
+        vec_push(&gc->remembered, ptr);
+    }
 }
 
 size_t
@@ -449,28 +1387,29 @@ gc_get_allocated(gc_t *gc) {
 
 size_t
 gc_get_reachable(gc_t *gc) {
-    size_t total = 0;
-
-    gc_mark(gc);
-    for (size_t i = 0; i < gc->alloc; ++i) {
-        for (gc_record_t *r = gc->buckets[i]; r; r = gc_record_next(r)) {
-            if (gc_record_markp(r))
-                total += r->size;
-        }
-    }
-
-    gc_unmark(gc);
-    return total;
+    // marks are sticky, so only a major collection
+    // can distinguish reachable objects
+    gc_collect(gc);
+    return gc->allocs;
 }
 
 size_t
 gc_get_collectable(gc_t *gc) {
-    return (gc->alloc - gc_get_reachable(gc));
+    size_t allocs = gc->allocs;
+    return allocs - gc_get_reachable(gc);
 }
 
 // Signals to mark phase not to descend
 void
-GC_atomic_mrk(void (*func)(void*, void*), 
+GC_atomic_mrk(void (*func)(void*, void*),
+              void* gc,
+              void* ptr) {
+    return;
+}
+
+// Signals to mark phase to use the marker of the type tag
+void
+gc_tagged_mrk(void (*func)(void*, void*),
               void* gc,
               void* ptr) {
     return;
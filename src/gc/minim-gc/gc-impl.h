@@ -1,7 +1,6 @@
 #ifndef _MINIM_GC_IMPL_H_
 #define _MINIM_GC_IMPL_H_
 
-#include <limits.h>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -12,48 +11,65 @@
 
 /* GC Parameters */
 #define GC_MIN_AUTO_COLLECT_SIZE     (8 * 1024 * 1024)
-#define GC_TABLE_LOAD_FACTOR         0.75
 #define GC_MINOR_PER_MAJOR           15
-
-/* Heap heuristic */
-#if defined (_WIN32) || defined (_WIN64)
-#define GC_HEAP_HEURISTIC   0
-#else
-#define GC_HEAP_HEURISTIC   1
-#endif
+#define GC_PAUSE_BUDGET              16384
+#define GC_STEP_SIZE                 (1024 * 1024)
+#define GC_VEC_SIZE                  1024
+#define GC_HOOK_TABLE_SIZE           64
+
+/* Pages */
+#define GC_PAGE_SHIFT       15
+#define GC_PAGE_SIZE        (((uintptr_t) 1) << GC_PAGE_SHIFT)
+#define GC_MAX_SMALL_SIZE   4096
+#define GC_CLASS_COUNT      20
+#define GC_BIG_CLASS        0xFF
+
+/* Page map (two-level bitmap over 48-bit addresses) */
+#define GC_ADDR_BITS        48
+#define GC_MAP_LEAF_BITS    18
+#define GC_MAP_TOP_SIZE     (((size_t) 1) << (GC_ADDR_BITS - GC_PAGE_SHIFT - GC_MAP_LEAF_BITS))
+#define GC_MAP_LEAF_WORDS   ((((size_t) 1) << GC_MAP_LEAF_BITS) / 64)
 
 /************ gc_t interface ************/
 
+/* Marker of objects traced by their type tag */
+void gc_tagged_mrk(void (*)(void*, void*), void*, void*);
+
 gc_t *gc_create(void *stack);
 void gc_destroy(gc_t* gc);
 
 void gc_pause(gc_t *gc);
 void gc_resume(gc_t *gc);
 
-void gc_remove(gc_t *gc, void *ptr, int destroy);
-
-gc_record_t *gc_alloc_record(gc_t *gc, size_t size, gc_dtor_t dtor, gc_mark_t mrk);
-gc_record_t *gc_calloc_record(gc_t *gc, size_t nmem, size_t size, gc_dtor_t dtor, gc_mark_t mrk);
-gc_record_t *gc_realloc_record(gc_t *gc, gc_record_t *r, size_t size, gc_dtor_t dtor, gc_mark_t mrk);
-
-gc_record_t *gc_get_record(gc_t *gc, void *ptr);
-void gc_add_record(gc_t *gc, gc_record_t *record);
+void *gc_alloc(gc_t *gc, size_t size, gc_dtor_t dtor, gc_mark_t mrk);
+void *gc_realloc(gc_t *gc, void *ptr, size_t size, gc_dtor_t dtor, gc_mark_t mrk);
+void gc_free(gc_t *gc, void *ptr);
 
 void gc_collect(gc_t *gc);
+void gc_collect_minor(gc_t *gc);
+void gc_collect_step(gc_t *gc);
+void gc_set_pause_budget(gc_t *gc, size_t budget);
+void gc_set_threads(gc_t *gc, size_t count);
 
 void gc_register_dtor(gc_t *gc, void *ptr, gc_dtor_t dtor);
 void gc_register_mrk(gc_t *gc, void *ptr, gc_mark_t mrk);
 void gc_register_root(gc_t *gc, void *ptr);
+void gc_register_tag_mrk(gc_t *gc, uint8_t tag, gc_mark_t mrk);
+void gc_write_barrier(gc_t *gc, void *ptr);
 
 size_t gc_get_allocated(gc_t *gc);
 size_t gc_get_reachable(gc_t *gc);
 size_t gc_get_collectable(gc_t *gc);
 
-#define gc_collect_if_needed(gc)                        \
-{                                                       \
-    if (((gc)->flags & GC_COLLECT) &&                   \
-        ((gc)->dirty > GC_MIN_AUTO_COLLECT_SIZE))       \
-        gc_collect(gc);                                 \
+// Major collections are incremental: once started,
+// a step is taken every `GC_STEP_SIZE` bytes allocated
+#define gc_collect_if_needed(gc)                                \
+{                                                               \
+    if (((gc)->flags & GC_COLLECT) &&                           \
+        ((gc)->dirty > (((gc)->flags & GC_MARKING) ?            \
+                        GC_STEP_SIZE :                          \
+                        GC_MIN_AUTO_COLLECT_SIZE)))             \
+        gc_collect_step(gc);                                    \
 }
 
 #endif
@@ -1,14 +1,24 @@
 #ifndef _MINIM_GC_TYPES_H_
 #define _MINIM_GC_TYPES_H_
 
+#include <pthread.h>
+#include <stddef.h>
 #include <stdint.h>
 
-/* Block flag */
-#define GC_RECORD_MARK       0x1
-#define GC_RECORD_ROOT       0x2
+/* Object flags (see `gc_page_t`) */
+#define GC_OBJ_ROOT         0x1
+#define GC_OBJ_REMEMBER     0x2
+#define GC_OBJ_ATOMIC       0x4
+#define GC_OBJ_HOOK         0x8
+#define GC_OBJ_TAGGED       0x10
 
-/* GC flag */
+/* Number of type tags */
+#define GC_TAG_COUNT        256
+
+/* GC flags */
 #define GC_COLLECT          0x1
+#define GC_MARKING          0x2     // major collection in progress
+#define GC_SWEEPING         0x4     // some pages are not yet swept
 
 /* Destructor signature */
 typedef void (*gc_dtor_t)(void*, void*);
@@ -16,48 +26,115 @@ typedef void (*gc_dtor_t)(void*, void*);
 /* Marking signature */
 typedef void (*gc_mark_t)(void*,void*,void*);
 
-/* GC bucket type */
-typedef struct gc_record_t {
-    struct gc_record_t *next;
-    size_t size;
+/* Page of objects.
+   Small objects are allocated from pages that are segregated by size class.
+   Each page is `GC_PAGE_SIZE` bytes and aligned to `GC_PAGE_SIZE`, so the
+   page of an object is found by masking its address. A big object gets its
+   own (multi-page) block with the same header and a single slot.
+
+   +------------------+
+   |      header      |
+   |   mark bitmap    |
+   |   alloc bitmap   |
+   |   object flags   |
+   |      slots       |
+   +------------------+
+*/
+typedef struct gc_page_t {
+    struct gc_page_t *next, *prev;  // neighboring pages of the same size class
+    void *free;                 // free list of swept slots
+    char *bump;                 // next slot that has never been allocated
+    char *slots, *end;          // slot bounds
+    uint64_t *marks;            // mark bitmap
+    uint64_t *allocs;           // allocation bitmap
+    uint8_t *flags;             // flags of each slot
+    size_t size;                // slot size
+    size_t count;               // number of slots
+    size_t live;                // number of allocated slots
+    uint8_t cls;                // size class (or `GC_BIG_CLASS`)
+    uint8_t young;              // page is in the nursery
+    uint8_t unswept;            // page is not yet swept
+} gc_page_t;
+
+/* Size class */
+typedef struct gc_class_t {
+    gc_page_t *pages, *last;    // every page of this size
+    gc_page_t *cur;             // allocation cursor
+} gc_class_t;
+
+/* Growable array of pointers */
+typedef struct gc_vec_t {
+    void **data;
+    size_t size, alloc;
+} gc_vec_t;
+
+/* Destructor and marker of an object */
+typedef struct gc_hook_t {
+    struct gc_hook_t *next;
+    void *ptr;
     gc_dtor_t dtor;
     gc_mark_t mrk;
-} gc_record_t;
+} gc_hook_t;
+
+/* Thread marking or sweeping in parallel */
+typedef struct gc_worker_t {
+    struct gc_t *gc;
+    gc_vec_t stack;             // grey objects
+    gc_vec_t hooked;            // unmarked objects with hooks (freed afterwards)
+    size_t freed, freed_size;   // objects freed while sweeping
+    size_t id;
+    pthread_mutex_t lock;       // protects `stack` from thieves
+    pthread_t thread;
+} gc_worker_t;
+
+/* Threads for parallel collection. The collecting thread is
+   the first worker, so there are `count - 1` helper threads. */
+typedef struct gc_pool_t {
+    gc_worker_t *workers;
+    size_t count;
+    pthread_mutex_t lock;
+    pthread_cond_t start, done;
+    size_t gen;                 // incremented for each task
+    size_t pending;             // helper threads running the task
+    size_t active;              // workers that may still have grey objects
+    int task;
+    int exit;
+    gc_page_t **pages;          // pages to sweep
+    size_t npages, next;
+} gc_pool_t;
 
 /* Main GC type */
 typedef struct gc_t {
-    gc_record_t **buckets;
+    gc_class_t *classes;
+    gc_page_t *bigs;            // big objects
+    uint64_t **page_map;        // set of page addresses
+    gc_hook_t **hooks;
+    gc_mark_t *tag_mrks;        // marker of each type tag
+    gc_vec_t nursery;           // pages allocated into since the last collection
+    gc_vec_t remembered;        // old objects to rescan at the next minor collection
+    gc_vec_t roots;             // root objects
+    gc_vec_t grey;              // marked objects that are not yet scanned
+    gc_pool_t *pool;            // threads for parallel collection (if any)
     void *stack_bottom;
-    size_t *alloc_ptr;
-    size_t alloc, size;
+    size_t hooks_alloc, hooks_size;
+    size_t size;                // number of objects
     size_t allocs, dirty;
+    size_t minors;              // minor collections since the last major collection
+    size_t budget;              // objects scanned per step of a major collection
     uint8_t flags;
 } gc_t;
 
-/* Accessors */
-
-#define gc_record_ptr(r)            ((void *) (((uintptr_t) (r)) + sizeof(gc_record_t)))
-#define gc_record_next(r)           ((gc_record_t *) (((uintptr_t) (r)->next) & ~0x3))
-#define gc_record_flags(r)          (((uintptr_t) (r)->next) & 0x3)
-#define gc_record_alloc_size(r)     ((r)->size + sizeof(gc_record_t))
-
-#define gc_load(gc)     (((double) (gc)->size) / ((double) (gc)->alloc))
-#define gc_hash(p)      (((size_t) (p)) >> 3)
+/* Bitmaps */
 
-/* Predicates */
+#define gc_bit_ref(bm, i)       (((bm)[(i) / 64] >> ((i) % 64)) & 0x1)
+#define gc_bit_set(bm, i)       ((bm)[(i) / 64] |= (((uint64_t) 1) << ((i) % 64)))
+#define gc_bit_unset(bm, i)     ((bm)[(i) / 64] &= ~(((uint64_t) 1) << ((i) % 64)))
 
-#define gc_record_markp(r)      (gc_record_flags(r) & GC_RECORD_MARK)
-#define gc_record_rootp(r)      (gc_record_flags(r) & GC_RECORD_ROOT)
-
-/* Setters */
-
-#define gc_record_mark_set(r)       (r)->next = ((gc_record_t *) (((uintptr_t) (r)->next) | GC_RECORD_MARK));
-#define gc_record_mark_unset(r)     (r)->next = ((gc_record_t *) (((uintptr_t) (r)->next) & ~GC_RECORD_MARK));
-
-#define gc_record_root_set(r)       (r)->next = ((gc_record_t *) (((uintptr_t) (r)->next) | GC_RECORD_ROOT));
-#define gc_record_root_unset(r)     (r)->next = ((gc_record_t *) (((uintptr_t) (r)->next) & ~GC_RECORD_ROOT));
+/* Accessors */
 
-#define gc_record_next_set(r, n)    \
-    ((r)->next = (void *) (((uintptr_t) (n)) | ((uintptr_t) gc_record_flags(r))))
+#define gc_page_of(p)           ((gc_page_t *) (((uintptr_t) (p)) & ~(GC_PAGE_SIZE - 1)))
+#define gc_page_ref(pg, i)      ((void *) ((pg)->slots + (i) * (pg)->size))
+#define gc_page_index(pg, p)    ((size_t) (((char *) (p)) - (pg)->slots) / (pg)->size)
+#define gc_page_words(pg)       (((pg)->count + 63) / 64)
 
 #endif
@@ -7,7 +7,18 @@
 static gc_t *main_gc;
 
 void GC_init(void *stack) {
+    char *threads;
+    long count;
+
     main_gc = gc_create(stack);
+
+    // thread count may be overridden by the environment
+    threads = getenv("MINIM_GC_THREADS");
+    if (threads) {
+        count = strtol(threads, NULL, 10);
+        if (count > 1)
+            gc_set_threads(main_gc, (size_t) count);
+    }
 }
 
 void GC_finalize() {
@@ -25,41 +36,26 @@ void GC_resume() {
 void *GC_alloc_opt(size_t size,
                    void (*dtor)(void*),
                    void (*mrk)(void (void*, void*), void*, void*)) {
-    gc_record_t *r;
-
     // collect if needed
     gc_collect_if_needed(main_gc);
-    
-    // allocate
-    r = gc_alloc_record(main_gc, size, (gc_dtor_t) dtor, (gc_mark_t) mrk);
-    gc_add_record(main_gc, r);
-    return gc_record_ptr(r);
+    return gc_alloc(main_gc, size, (gc_dtor_t) dtor, (gc_mark_t) mrk);
 }
 
 void *GC_calloc_opt(size_t nmem,
                     size_t size,
                     void (*dtor)(void*),
                     void (*mrk)(void (void*, void*), void*, void*)) {
-    gc_record_t *r;
-
-    // collect if needed
-    gc_collect_if_needed(main_gc);
-    
-    // allocate
-    r = gc_calloc_record(main_gc, nmem, size, (gc_dtor_t) dtor, (gc_mark_t) mrk);
-    gc_add_record(main_gc, r);
-    return gc_record_ptr(r);
+    // objects are always zeroed
+    return GC_alloc_opt(nmem * size, dtor, mrk);
 }
 
 void *GC_realloc_opt(void *ptr,
                      size_t size,
                      void (*dtor)(void*),
                      void (*mrk)(void (void*, void*), void*, void*)) {
-    gc_record_t *r;
-
     // zero size
     if (size == 0) {
-        gc_remove(main_gc, ptr, 1);
+        gc_free(main_gc, ptr);
         return NULL;
     }
 
@@ -67,18 +63,8 @@ void *GC_realloc_opt(void *ptr,
     if (ptr == NULL)
         return GC_alloc_opt(size, dtor, mrk);
 
-    r = gc_get_record(main_gc, ptr);
-    if (r) {
-        gc_remove(main_gc, ptr, 0);
-        r = gc_realloc_record(main_gc, r, size, (gc_dtor_t) dtor, (gc_mark_t) mrk);
-        if (!r)
-            return NULL;
-        
-        gc_add_record(main_gc, r);
-        return gc_record_ptr(r);
-    } else {
-        return GC_alloc_opt(size, dtor, mrk);
-    }
+    gc_collect_if_needed(main_gc);
+    return gc_realloc(main_gc, ptr, size, (gc_dtor_t) dtor, (gc_mark_t) mrk);
 }
 
 void *GC_alloc(size_t size) {
@@ -105,14 +91,26 @@ void *GC_realloc_atomic(void *ptr, size_t size) {
     return GC_realloc_opt(ptr, size, NULL, GC_atomic_mrk);
 }
 
+void *GC_alloc_tagged(size_t size) {
+    return GC_alloc_opt(size, NULL, (void (*)(void (void*, void*), void*, void*)) gc_tagged_mrk);
+}
+
 void GC_free(void *ptr) {
-    gc_remove(main_gc, ptr, 1);
+    gc_free(main_gc, ptr);
 }
 
 void GC_collect() {
     gc_collect(main_gc);
 }
 
+void GC_set_pause_budget(size_t budget) {
+    gc_set_pause_budget(main_gc, budget);
+}
+
+void GC_set_threads(size_t count) {
+    gc_set_threads(main_gc, count);
+}
+
 void GC_register_dtor(void *ptr, void (*func)(void*, void*)) {
     gc_register_dtor(main_gc, ptr, func);
 }
@@ -125,6 +123,14 @@ void GC_register_root(void *ptr) {
     gc_register_root(main_gc, ptr);
 }
 
+void GC_register_tag_mrk(unsigned char tag, void (*func)(void (void*,void*),void*,void*)) {
+    gc_register_tag_mrk(main_gc, tag, (gc_mark_t) func);
+}
+
+void GC_write_barrier(void *ptr) {
+    gc_write_barrier(main_gc, ptr);
+}
+
 size_t GC_get_allocated() {
     return gc_get_allocated(main_gc);
 }
@@ -33,19 +33,43 @@ void *GC_alloc_opt(size_t size, void (*dtor)(void*), void (*mrk)(void (void*, vo
 void *GC_calloc_opt(size_t nmem, size_t size, void (*dtor)(void*), void (*mrk)(void (void*, void*), void*, void*));
 void *GC_realloc_opt(void *ptr, size_t size, void (*dtor)(void*), void (*mrk)(void (void*, void*), void*, void*));
 
+/* GC equivalent of malloc() except the first byte of the object is
+   a type tag and the object is marked by the marker of that tag */
+void *GC_alloc_tagged(size_t size);
+
 /* Manually free pointer */
 void GC_free(void *ptr);
 
 /* Manually run garbage collection */
 void GC_collect();
 
+/* Sets the maximum number of objects scanned in a single step of
+   an incremental major collection. Zero disables incremental
+   collection, so major collections stop the world. */
+void GC_set_pause_budget(size_t budget);
+
+/* Sets the number of threads that mark and sweep during a collection,
+   including the calling thread. The default is one (no helpers),
+   or the value of `MINIM_GC_THREADS` when set at `GC_init`. */
+void GC_set_threads(size_t count);
+
 /* Register destructor and marker functions for objects.  */
 void GC_register_dtor(void *ptr, void (*func)(void*, void*));
 void GC_register_mrk(void *ptr, void (*func)(void (void*,void*),void*,void*));
 
+/* Register a marker for every tagged object with type tag `tag`.
+   Tagged objects without a marker are marked conservatively. */
+void GC_register_tag_mrk(unsigned char tag, void (*func)(void (void*,void*),void*,void*));
+
 /* Register object as a root (never garbage collected) */
 void GC_register_root(void *ptr);
 
+/* Signals that a pointer was stored into the object at `ptr`,
+   which may point into the middle of the object.
+   May be skipped if the object has been referenced from the stack
+   or a root since it was allocated, e.g., when initializing it. */
+void GC_write_barrier(void *ptr);
+
 /* GC info */
 size_t GC_get_allocated();
 size_t GC_get_reachable();